@@ -0,0 +1,538 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+#include "latency_histogram.h"
+#include "synthesis_output_format.h"
+
+// Feeds a WAV file to a push stream in real time, as a microphone would, e.g. to test a voice loop without speaking.
+// Optional leading silence delays the speech in the file, e.g. to let a prompt play before it is interrupted.
+class PacedWavFileInput final
+{
+public:
+    explicit PacedWavFileInput(const std::string& fileName, std::chrono::milliseconds leadingSilence = std::chrono::milliseconds(0),
+                               std::chrono::milliseconds chunk = std::chrono::milliseconds(20))
+        : m_reader(fileName), m_leadingSilence(leadingSilence), m_chunk(chunk)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto format = AudioStreamFormat::GetWaveFormatPCM(m_reader.GetSamplesPerSecond(), static_cast<uint8_t>(m_reader.GetBitsPerSample()),
+                                                          static_cast<uint8_t>(m_reader.GetChannels()));
+        m_stream = AudioInputStream::CreatePushStream(format);
+    }
+
+    PacedWavFileInput(const PacedWavFileInput&) = delete;
+    PacedWavFileInput& operator=(const PacedWavFileInput&) = delete;
+
+    ~PacedWavFileInput()
+    {
+        m_stopping = true;
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> GetAudioConfig() const
+    {
+        return Microsoft::CognitiveServices::Speech::Audio::AudioConfig::FromStreamInput(m_stream);
+    }
+
+    // Starts writing the file, one chunk every chunk duration. The stream is closed at the end of the file.
+    void Start()
+    {
+        m_thread = std::thread([this]
+        {
+            auto bytesPerSecond = static_cast<size_t>(m_reader.GetSamplesPerSecond()) * m_reader.GetBlockAlign();
+            auto chunkSize = std::max<size_t>(bytesPerSecond * m_chunk.count() / 1000 / m_reader.GetBlockAlign(), 1) * m_reader.GetBlockAlign();
+            std::vector<uint8_t> chunk(chunkSize);
+
+            // Paced against the start time rather than chunk by chunk, so the delays of the writes do not add up.
+            auto start = std::chrono::steady_clock::now();
+            uint64_t written = 0;
+            auto silence = bytesPerSecond * m_leadingSilence.count() / 1000 / m_reader.GetBlockAlign() * m_reader.GetBlockAlign();
+            while (!m_stopping)
+            {
+                uint32_t size = 0;
+                if (written < silence)
+                {
+                    size = static_cast<uint32_t>(std::min<uint64_t>(chunkSize, silence - written));
+                    std::fill(chunk.begin(), chunk.end(), static_cast<uint8_t>(0));
+                }
+                else
+                {
+                    auto read = m_reader.Read(chunk.data(), static_cast<uint32_t>(chunkSize));
+                    if (read <= 0)
+                    {
+                        break;
+                    }
+                    size = static_cast<uint32_t>(read);
+                }
+                m_stream->Write(chunk.data(), size);
+                written += size;
+                std::this_thread::sleep_until(start + std::chrono::microseconds(written * 1000000 / bytesPerSecond));
+            }
+            m_stream->Close();
+        });
+    }
+
+private:
+    WavFileReader m_reader;
+    const std::chrono::milliseconds m_leadingSilence;
+    const std::chrono::milliseconds m_chunk;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_stream;
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+};
+
+// An utterance recognized by the voice loop.
+struct VoiceLoopUtterance
+{
+    std::string Text;
+    // Set if the utterance interrupted a prompt.
+    bool BargeIn = false;
+};
+
+// A full-duplex voice loop: recognition runs continuously, also while a prompt is spoken, and the first Recognizing event
+// of the user interrupts the prompt (barge-in).
+// The loop plays the synthesized audio itself, one frame at a time and in real time, through the playback callback (e.g.
+// to an audio device, or to a file), so an interruption silences the playback within about two frames: the frame being
+// played and the one queued after it. The synthesis in flight is stopped as well. Both latencies are measured from the
+// Recognizing event.
+// With a microphone and a speaker, use echo cancellation (e.g. AudioProcessingOptions with a speaker reference channel) so
+// the prompt does not interrupt itself.
+class BargeInVoiceLoop final
+{
+public:
+    // Called on the playback thread, with one frame of audio at a time, at the pace it is played.
+    using PlaybackCallback = std::function<void(const uint8_t* data, size_t size)>;
+
+    enum class PromptOutcome
+    {
+        Completed,
+        Interrupted,
+        Failed
+    };
+
+    struct Options
+    {
+        // Audio format of the prompts, a raw format so it can be played frame by frame, see RawSynthesisBytesPerSecond().
+        Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat OutputFormat =
+            Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm;
+        std::chrono::milliseconds FrameDuration{ 20 };
+        // Partial results shorter than this do not interrupt, e.g. to ignore short noises.
+        size_t MinInterruptLength = 1;
+    };
+
+    struct Stats
+    {
+        uint64_t Prompts = 0;
+        uint64_t Completed = 0;
+        uint64_t Interrupted = 0;
+        uint64_t Failed = 0;
+    };
+
+    // 'audioInput' is the input of the recognizer, e.g. the default microphone, or a PacedWavFileInput for tests.
+    // The output format of 'config' is set to the one of the options.
+    BargeInVoiceLoop(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+                     std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> audioInput, PlaybackCallback playback, Options options)
+        : m_options(options), m_bytesPerSecond(RawSynthesisBytesPerSecond(options.OutputFormat)), m_playback(std::move(playback))
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (!m_playback || m_options.FrameDuration.count() <= 0)
+        {
+            throw std::invalid_argument("A playback callback and FrameDuration are required");
+        }
+        if (m_bytesPerSecond == 0)
+        {
+            throw std::invalid_argument("The output format must be a raw format without header, so the prompts can be paced");
+        }
+        m_frameSize = std::max<size_t>(static_cast<size_t>(m_bytesPerSecond * m_options.FrameDuration.count() / 1000) & ~static_cast<size_t>(1), 2);
+
+        config->SetSpeechSynthesisOutputFormat(m_options.OutputFormat);
+        m_synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+        m_synthesizer->Synthesizing += [this](const SpeechSynthesisEventArgs& e)
+        {
+            auto audio = e.Result->GetAudioData();
+            if (audio && !audio->empty())
+            {
+                Enqueue(*audio);
+            }
+        };
+        m_synthesizer->SynthesisCompleted += [this](const SpeechSynthesisEventArgs& e)
+        {
+            UNUSED(e);
+            SynthesisDone();
+        };
+        m_synthesizer->SynthesisCanceled += [this](const SpeechSynthesisEventArgs& e)
+        {
+            UNUSED(e);
+            SynthesisDone();
+        };
+
+        m_recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+        m_recognizer->Recognizing += [this](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Text.size() >= m_options.MinInterruptLength)
+            {
+                Interrupt();
+            }
+        };
+        m_recognizer->Recognized += [this](const SpeechRecognitionEventArgs& e)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+            {
+                m_utterances.push_back(VoiceLoopUtterance{ e.Result->Text, m_bargeIn });
+                m_changed.notify_all();
+            }
+            m_bargeIn = false;
+        };
+        m_recognizer->Canceled += [this](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (e.Reason == CancellationReason::Error)
+            {
+                m_error = e.ErrorDetails;
+            }
+            m_inputEnded = true;
+            m_changed.notify_all();
+        };
+        m_recognizer->SessionStopped += [this](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_inputEnded = true;
+            m_changed.notify_all();
+        };
+    }
+
+    BargeInVoiceLoop(const BargeInVoiceLoop&) = delete;
+    BargeInVoiceLoop& operator=(const BargeInVoiceLoop&) = delete;
+
+    ~BargeInVoiceLoop()
+    {
+        Stop();
+    }
+
+    // Starts the recognition and the playback.
+    void Start()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_started = true;
+        }
+        m_playbackThread = std::thread(&BargeInVoiceLoop::PlaybackLoop, this);
+        m_recognizer->StartContinuousRecognitionAsync().get();
+    }
+
+    // Stops the recognition and the playback. A prompt being spoken returns Interrupted.
+    void Stop()
+    {
+        if (!m_playbackThread.joinable())
+        {
+            return;
+        }
+        m_recognizer->StopContinuousRecognitionAsync().get();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        m_playbackThread.join();
+    }
+
+    // Speaks a prompt, and returns when it has been played to the end, or when the user interrupted it.
+    // Must be called after Start(), not from the loop's callbacks or SDK events, and one prompt at a time.
+    PromptOutcome Speak(const std::string& text, bool ssml = false)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_started || m_speaking)
+            {
+                throw std::logic_error("The loop is not started, or a prompt is being spoken already");
+            }
+            m_speaking = true;
+            m_interrupted = false;
+            m_synthesisDone = false;
+            m_stats.Prompts++;
+        }
+
+        auto outcome = PromptOutcome::Completed;
+        auto future = ssml ? m_synthesizer->SpeakSsmlAsync(text) : m_synthesizer->SpeakTextAsync(text);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] { return m_interrupted || m_synthesisDone || m_stopping; });
+        if (!m_interrupted && !m_stopping)
+        {
+            lock.unlock();
+            auto result = future.get();
+            lock.lock();
+            if (result->Reason == ResultReason::Canceled)
+            {
+                outcome = PromptOutcome::Failed;
+                ClearQueue();
+            }
+            else
+            {
+                // Waits for the end of the playback of the last frame.
+                while (!m_interrupted && !m_stopping && (!m_queue.empty() || Clock::now() < m_playedUntil))
+                {
+                    if (m_queue.empty())
+                    {
+                        m_changed.wait_until(lock, m_playedUntil);
+                    }
+                    else
+                    {
+                        m_changed.wait(lock);
+                    }
+                }
+            }
+        }
+        else if (!m_synthesisDone)
+        {
+            // Stops the synthesis in flight, its remaining audio is dropped anyway. The flag is read under the lock,
+            // as Interrupt() may still set it while stopping.
+            auto interrupted = m_interrupted;
+            auto interruptAt = m_interruptAt;
+            lock.unlock();
+            m_synthesizer->StopSpeakingAsync().get();
+            future.get();
+            if (interrupted)
+            {
+                m_interruptToSynthesisStop.Record(Microseconds(Clock::now() - interruptAt));
+            }
+            lock.lock();
+        }
+        else
+        {
+            lock.unlock();
+            future.get();
+            lock.lock();
+        }
+
+        if (m_interrupted || m_stopping)
+        {
+            outcome = PromptOutcome::Interrupted;
+            ClearQueue();
+            // Waits for the playback to be silent, i.e. for the interruption to be measured.
+            m_changed.wait(lock, [this] { return !m_silencePending || m_stopping; });
+        }
+        m_speaking = false;
+        switch (outcome)
+        {
+        case PromptOutcome::Completed:
+            m_stats.Completed++;
+            break;
+        case PromptOutcome::Interrupted:
+            m_stats.Interrupted++;
+            break;
+        case PromptOutcome::Failed:
+            m_stats.Failed++;
+            break;
+        }
+        return outcome;
+    }
+
+    // Waits for the next recognized utterance. Returns false on timeout, or once the input has ended and all the
+    // utterances have been returned.
+    bool NextUtterance(VoiceLoopUtterance& utterance, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait_for(lock, timeout, [this] { return !m_utterances.empty() || m_inputEnded; });
+        if (m_utterances.empty())
+        {
+            return false;
+        }
+        utterance = std::move(m_utterances.front());
+        m_utterances.pop_front();
+        return true;
+    }
+
+    bool InputEnded()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_inputEnded && m_utterances.empty();
+    }
+
+    // The recognition error, if the recognition was canceled with an error.
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    // Time from the interrupting Recognizing event to the end of the playback, in microseconds.
+    const LatencyHistogram& InterruptToSilence() const
+    {
+        return m_interruptToSilence;
+    }
+
+    // Time from the interrupting Recognizing event to the synthesis in flight being stopped, in microseconds.
+    const LatencyHistogram& InterruptToSynthesisStop() const
+    {
+        return m_interruptToSynthesisStop;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static uint64_t Microseconds(Clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+
+    void Interrupt()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_speaking || m_interrupted)
+        {
+            return;
+        }
+        m_interrupted = true;
+        m_interruptAt = Clock::now();
+        m_silencePending = true;
+        m_bargeIn = true;
+        ClearQueue();
+        m_changed.notify_all();
+    }
+
+    void Enqueue(std::vector<uint8_t> audio)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Audio still coming after an interruption, until the synthesis is stopped, is dropped.
+        if (m_speaking && !m_interrupted)
+        {
+            m_queue.push_back(std::move(audio));
+            m_changed.notify_all();
+        }
+    }
+
+    void SynthesisDone()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_speaking)
+        {
+            m_synthesisDone = true;
+            m_changed.notify_all();
+        }
+    }
+
+    // Must be called with the loop locked.
+    void ClearQueue()
+    {
+        m_queue.clear();
+        m_queueOffset = 0;
+    }
+
+    void PlaybackLoop()
+    {
+        std::vector<uint8_t> frame(m_frameSize);
+        auto frameDuration = std::chrono::duration_cast<Clock::duration>(m_options.FrameDuration);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            if (m_silencePending)
+            {
+                // The frames given to the playback before the interruption still play to their end.
+                m_interruptToSilence.Record(Microseconds(std::max(Clock::now(), m_playedUntil) - m_interruptAt));
+                m_silencePending = false;
+                m_changed.notify_all();
+                continue;
+            }
+            if (m_queue.empty())
+            {
+                m_changed.wait(lock);
+                continue;
+            }
+
+            // Keeps one frame queued after the one playing, as an audio device would.
+            if (Clock::now() < m_playedUntil - frameDuration)
+            {
+                m_changed.wait_until(lock, m_playedUntil - frameDuration);
+                continue;
+            }
+
+            size_t size = 0;
+            while (size < frame.size() && !m_queue.empty())
+            {
+                auto& chunk = m_queue.front();
+                auto count = std::min(frame.size() - size, chunk.size() - m_queueOffset);
+                std::copy(chunk.begin() + m_queueOffset, chunk.begin() + m_queueOffset + count, frame.begin() + size);
+                size += count;
+                m_queueOffset += count;
+                if (m_queueOffset == chunk.size())
+                {
+                    m_queue.pop_front();
+                    m_queueOffset = 0;
+                }
+            }
+
+            lock.unlock();
+            m_playback(frame.data(), size);
+            lock.lock();
+
+            auto duration = std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds(size * 1000000 / m_bytesPerSecond));
+            m_playedUntil = std::max(m_playedUntil, Clock::now()) + duration;
+            m_changed.notify_all();
+        }
+    }
+
+    const Options m_options;
+    const uint32_t m_bytesPerSecond;
+    PlaybackCallback m_playback;
+    size_t m_frameSize = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // Audio of the prompt not played yet, and the bytes of the front chunk played already.
+    std::deque<std::vector<uint8_t>> m_queue;
+    size_t m_queueOffset = 0;
+    // When the frames given to the playback so far will have been played.
+    Clock::time_point m_playedUntil;
+    bool m_started = false;
+    bool m_speaking = false;
+    bool m_synthesisDone = false;
+    bool m_interrupted = false;
+    bool m_silencePending = false;
+    bool m_bargeIn = false;
+    Clock::time_point m_interruptAt;
+    std::deque<VoiceLoopUtterance> m_utterances;
+    bool m_inputEnded = false;
+    bool m_stopping = false;
+    std::string m_error;
+    Stats m_stats;
+    LatencyHistogram m_interruptToSilence;
+    LatencyHistogram m_interruptToSynthesisStop;
+
+    std::thread m_playbackThread;
+    // Declared last, so they are destroyed first, while the state their event handlers use is still alive.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> m_synthesizer;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> m_recognizer;
+};
@@ -0,0 +1,362 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// The transcription of one file of a batch.
+struct BatchTranscriptionResult
+{
+    size_t Index = 0;                       // position of the file in the batch, in the order it was added.
+    std::string Path;
+    bool Succeeded = false;
+    std::string Text;                       // all recognized phrases, separated by a space.
+    std::string ErrorDetails;               // set if the recognition was canceled with an error.
+    double AudioSeconds = 0;                // audio duration used for admission, see BatchTranscriber::Options.
+    std::chrono::milliseconds ProcessingTime{ 0 };
+};
+
+// Transcribes a batch of WAV files by running up to a bounded number of continuous recognition sessions concurrently.
+// Files are started in the order they are added. A file is admitted when a session is free and, if an audio budget
+// is set, when its audio fits into the audio seconds that are still in flight. A file longer than the budget is
+// admitted alone, so the batch always makes progress.
+// Every file gets a future that is ready as soon as the file is done. Results are also passed to a callback, either in
+// the order the files were added or in the order they complete.
+class BatchTranscriber final
+{
+public:
+    struct Options
+    {
+        // Maximum number of recognizers running at the same time.
+        size_t MaxConcurrentSessions = 4;
+        // Maximum audio seconds in flight across all sessions, 0 for no limit.
+        double MaxAudioSecondsInFlight = 0;
+        // Whether the callback receives the results in the order the files were added.
+        bool OrderedResults = true;
+    };
+
+    struct Stats
+    {
+        size_t Completed = 0;
+        size_t Failed = 0;
+        double AudioSeconds = 0;
+        std::chrono::milliseconds WallTime{ 0 };
+
+        // Audio seconds transcribed per second of wall time.
+        double Throughput() const
+        {
+            return WallTime.count() > 0 ? AudioSeconds * 1000.0 / WallTime.count() : 0.0;
+        }
+    };
+
+    using ResultCallback = std::function<void(const BatchTranscriptionResult& result)>;
+    using Clock = std::chrono::steady_clock;
+
+    BatchTranscriber(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, Options options, ResultCallback onResult = nullptr)
+        : m_config(std::move(config)), m_options(options), m_onResult(std::move(onResult)), m_start(Clock::now())
+    {
+        if (!m_config)
+        {
+            throw std::invalid_argument("Speech config is null");
+        }
+        if (m_options.MaxConcurrentSessions == 0)
+        {
+            throw std::invalid_argument("MaxConcurrentSessions must be at least 1");
+        }
+
+        for (size_t i = 0; i < m_options.MaxConcurrentSessions; i++)
+        {
+            m_workers.emplace_back(&BatchTranscriber::WorkerLoop, this);
+        }
+    }
+
+    BatchTranscriber(const BatchTranscriber&) = delete;
+    BatchTranscriber& operator=(const BatchTranscriber&) = delete;
+
+    ~BatchTranscriber()
+    {
+        Wait();
+    }
+
+    // Reads a manifest with one audio file path per line. Empty lines and lines starting with '#' are skipped.
+    static std::vector<std::string> LoadManifest(const std::string& manifestFileName)
+    {
+        std::ifstream manifest(manifestFileName);
+        if (!manifest.good())
+        {
+            throw std::invalid_argument("Failed to open the manifest file.");
+        }
+
+        std::vector<std::string> paths;
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty() && line[0] != '#')
+            {
+                paths.push_back(line);
+            }
+        }
+        return paths;
+    }
+
+    // Gets the audio duration of a WAV file from its header, or 0 if the file cannot be read.
+    static double EstimateAudioSeconds(const std::string& path)
+    {
+        try
+        {
+            return WavFileReader(path).GetDurationSeconds();
+        }
+        catch (const std::exception&)
+        {
+            return 0;
+        }
+    }
+
+    // Queues a file for transcription. If 'audioSeconds' is 0, it is read from the file header.
+    std::future<BatchTranscriptionResult> Add(const std::string& path, double audioSeconds = 0)
+    {
+        auto item = std::make_shared<Item>();
+        item->Result.Path = path;
+        item->Result.AudioSeconds = audioSeconds > 0 ? audioSeconds : EstimateAudioSeconds(path);
+        auto future = item->Promise.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed)
+            {
+                throw std::logic_error("Cannot add files after Wait()");
+            }
+            item->Result.Index = m_added++;
+            m_queue.push_back(item);
+        }
+        m_admission.notify_all();
+        return future;
+    }
+
+    // Waits until all queued files are transcribed. No files can be added afterwards.
+    void Wait()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_admission.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto stats = m_stats;
+        stats.WallTime = std::chrono::duration_cast<std::chrono::milliseconds>((m_finished ? m_end : Clock::now()) - m_start);
+        return stats;
+    }
+
+private:
+    struct Item
+    {
+        BatchTranscriptionResult Result;
+        std::promise<BatchTranscriptionResult> Promise;
+    };
+
+    void WorkerLoop()
+    {
+        while (true)
+        {
+            std::shared_ptr<Item> item;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_admission.wait(lock, [this] { return (m_closed && m_queue.empty()) || CanAdmit(); });
+                if (m_queue.empty())
+                {
+                    m_finished = ++m_exitedWorkers == m_options.MaxConcurrentSessions;
+                    m_end = Clock::now();
+                    return;
+                }
+                item = m_queue.front();
+                m_queue.pop_front();
+                m_audioSecondsInFlight += item->Result.AudioSeconds;
+                m_sessionsInFlight++;
+            }
+
+            auto start = Clock::now();
+            Transcribe(item->Result);
+            item->Result.ProcessingTime = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_audioSecondsInFlight -= item->Result.AudioSeconds;
+                m_sessionsInFlight--;
+                if (item->Result.Succeeded)
+                {
+                    m_stats.Completed++;
+                    m_stats.AudioSeconds += item->Result.AudioSeconds;
+                }
+                else
+                {
+                    m_stats.Failed++;
+                }
+            }
+            m_admission.notify_all();
+
+            item->Promise.set_value(item->Result);
+            Emit(item);
+        }
+    }
+
+    // Called with m_mutex held.
+    bool CanAdmit() const
+    {
+        if (m_queue.empty())
+        {
+            return false;
+        }
+        if (m_options.MaxAudioSecondsInFlight <= 0 || m_sessionsInFlight == 0)
+        {
+            return true;
+        }
+        return m_audioSecondsInFlight + m_queue.front()->Result.AudioSeconds <= m_options.MaxAudioSecondsInFlight;
+    }
+
+    void Transcribe(BatchTranscriptionResult& result)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        try
+        {
+            // The session ends with SessionStopped, or with Canceled followed by SessionStopped, so only the first one counts.
+            std::promise<void> recognitionEnd;
+            std::atomic<bool> ended{ false };
+            auto notifyEnd = [&recognitionEnd, &ended]()
+            {
+                if (!ended.exchange(true))
+                {
+                    recognitionEnd.set_value();
+                }
+            };
+
+            std::string text;
+            std::string errorDetails;
+
+            // Created after the state its handlers capture, so it is destroyed (and stops raising events) first.
+            auto audioInput = AudioConfig::FromWavFileInput(result.Path);
+            auto recognizer = SpeechRecognizer::FromConfig(m_config, audioInput);
+
+            recognizer->Recognized.Connect([&text](const SpeechRecognitionEventArgs& e)
+            {
+                if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+                {
+                    if (!text.empty())
+                    {
+                        text += " ";
+                    }
+                    text += e.Result->Text;
+                }
+            });
+            recognizer->Canceled.Connect([&errorDetails, &notifyEnd](const SpeechRecognitionCanceledEventArgs& e)
+            {
+                if (e.Reason == CancellationReason::Error)
+                {
+                    errorDetails = "ErrorCode=" + std::to_string((int)e.ErrorCode) + " " + e.ErrorDetails;
+                }
+                notifyEnd();
+            });
+            recognizer->SessionStopped.Connect([&notifyEnd](const SessionEventArgs& e)
+            {
+                UNUSED(e);
+                notifyEnd();
+            });
+
+            recognizer->StartContinuousRecognitionAsync().get();
+            recognitionEnd.get_future().get();
+            recognizer->StopContinuousRecognitionAsync().get();
+
+            result.Text = std::move(text);
+            result.ErrorDetails = std::move(errorDetails);
+            result.Succeeded = result.ErrorDetails.empty();
+        }
+        catch (const std::exception& e)
+        {
+            result.ErrorDetails = e.what();
+            result.Succeeded = false;
+        }
+    }
+
+    void Emit(const std::shared_ptr<Item>& item)
+    {
+        // One file at a time: in the ordered mode, a result and the held back results it releases are delivered together.
+        std::lock_guard<std::mutex> lock(m_emitMutex);
+        if (!m_options.OrderedResults)
+        {
+            Deliver(*item);
+            return;
+        }
+
+        m_pending[item->Result.Index] = item;
+        for (auto next = m_pending.find(m_nextToEmit); next != m_pending.end(); next = m_pending.find(m_nextToEmit))
+        {
+            Deliver(*next->second);
+            m_pending.erase(next);
+            m_nextToEmit++;
+        }
+    }
+
+    void Deliver(const Item& item)
+    {
+        if (m_onResult)
+        {
+            m_onResult(item.Result);
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Options m_options;
+    ResultCallback m_onResult;
+
+    std::mutex m_mutex;
+    std::condition_variable m_admission;
+    std::deque<std::shared_ptr<Item>> m_queue;
+    size_t m_added = 0;
+    size_t m_sessionsInFlight = 0;
+    double m_audioSecondsInFlight = 0;
+    bool m_closed = false;
+    size_t m_exitedWorkers = 0;
+    bool m_finished = false;
+    Stats m_stats;
+    Clock::time_point m_start;
+    Clock::time_point m_end;
+
+    std::mutex m_emitMutex;
+    std::map<size_t, std::shared_ptr<Item>> m_pending;
+    size_t m_nextToEmit = 0;
+
+    std::vector<std::thread> m_workers;
+};
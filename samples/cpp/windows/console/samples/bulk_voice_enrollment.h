@@ -0,0 +1,659 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "wav_file_reader.h"
+#include "latency_histogram.h"
+#include "worker_pool.h"
+
+// The state of a customer's voice profile, as recorded in the journal.
+struct VoiceEnrollmentState
+{
+    std::string ProfileId;                  // empty until the profile is created.
+    size_t AcceptedFiles = 0;               // enrollment files the service accepted so far.
+    bool Enrolled = false;
+    bool Failed = false;                    // failed with a permanent error, or ran out of audio.
+    std::string ErrorDetails;
+};
+
+// An append-only journal of enrollment progress, one tab separated line per step:
+//   created <customer> <profile id>, accepted <customer> <files>, enrolled <customer> <profile id>, failed <customer> <error>.
+// Each line is flushed when written, so after a crash the journal has every step but possibly a torn last line, which is
+// ignored. The state of a customer is the fold of its lines.
+class VoiceEnrollmentJournal final
+{
+public:
+    explicit VoiceEnrollmentJournal(const std::string& fileName)
+    {
+        std::string contents;
+        {
+            std::ifstream journal(fileName, std::ios_base::binary);
+            if (journal.good())
+            {
+                std::ostringstream buffer;
+                buffer << journal.rdbuf();
+                contents = buffer.str();
+            }
+        }
+
+        size_t start = 0;
+        for (auto end = contents.find('\n'); end != std::string::npos; end = contents.find('\n', start))
+        {
+            Apply(contents.substr(start, end - start));
+            start = end + 1;
+        }
+
+        m_file.open(fileName, std::ios_base::binary | std::ios_base::app);
+        if (!m_file.good())
+        {
+            throw std::runtime_error("Failed to open the journal file: " + fileName);
+        }
+        if (start < contents.size())
+        {
+            // Ends the torn line, so the next line is not appended to it.
+            m_file << '\n';
+            m_file.flush();
+        }
+    }
+
+    VoiceEnrollmentJournal(const VoiceEnrollmentJournal&) = delete;
+    VoiceEnrollmentJournal& operator=(const VoiceEnrollmentJournal&) = delete;
+
+    // The recorded state of a customer, a default state if the journal has none.
+    VoiceEnrollmentState Get(const std::string& customerId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto state = m_states.find(customerId);
+        return state == m_states.end() ? VoiceEnrollmentState() : state->second;
+    }
+
+    void Created(const std::string& customerId, const std::string& profileId)
+    {
+        Append("created", customerId, profileId);
+    }
+
+    void Accepted(const std::string& customerId, size_t files)
+    {
+        Append("accepted", customerId, std::to_string(files));
+    }
+
+    void Enrolled(const std::string& customerId, const std::string& profileId)
+    {
+        Append("enrolled", customerId, profileId);
+    }
+
+    void Failed(const std::string& customerId, const std::string& error)
+    {
+        Append("failed", customerId, error);
+    }
+
+private:
+    // Tabs and line breaks would break the line format.
+    static std::string Sanitize(std::string text)
+    {
+        std::replace_if(text.begin(), text.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+        return text;
+    }
+
+    void Append(const std::string& kind, const std::string& customerId, const std::string& detail)
+    {
+        auto line = kind + "\t" + customerId + "\t" + Sanitize(detail);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_file << line << '\n';
+        m_file.flush();
+        if (!m_file.good())
+        {
+            throw std::runtime_error("Failed to write the journal");
+        }
+        Apply(line);
+    }
+
+    // Must be called with the journal locked, or from the constructor.
+    void Apply(const std::string& line)
+    {
+        auto first = line.find('\t');
+        auto second = first == std::string::npos ? std::string::npos : line.find('\t', first + 1);
+        if (second == std::string::npos)
+        {
+            return;
+        }
+        auto kind = line.substr(0, first);
+        auto& state = m_states[line.substr(first + 1, second - first - 1)];
+        auto detail = line.substr(second + 1);
+        if (kind == "created")
+        {
+            state = VoiceEnrollmentState();
+            state.ProfileId = detail;
+        }
+        else if (kind == "accepted")
+        {
+            state.AcceptedFiles = static_cast<size_t>(std::strtoull(detail.c_str(), nullptr, 10));
+        }
+        else if (kind == "enrolled")
+        {
+            state.ProfileId = detail;
+            state.Enrolled = true;
+            state.Failed = false;
+        }
+        else if (kind == "failed")
+        {
+            state.Failed = true;
+            state.ErrorDetails = detail;
+        }
+    }
+
+    std::mutex m_mutex;
+    std::map<std::string, VoiceEnrollmentState> m_states;
+    std::ofstream m_file;
+};
+
+// The enrollment audio of a customer.
+struct VoiceEnrollmentJob
+{
+    std::string CustomerId;
+    // WAV files, 16 kHz, 16 bits per sample, mono, enrolled one after the other until the profile is enrolled.
+    std::vector<std::string> AudioFiles;
+};
+
+// The outcome of a job.
+struct VoiceEnrollmentResult
+{
+    std::string CustomerId;
+    std::string ProfileId;
+    bool Enrolled = false;
+    bool Skipped = false;                   // done in a previous run, according to the journal.
+    std::string ErrorDetails;
+    size_t Attempts = 0;                    // enrollment requests, retries included.
+    size_t CreateAttempts = 0;              // profile creation requests, retries included.
+    std::chrono::milliseconds ProcessingTime{ 0 };
+};
+
+// Enrolls the voice profiles of many customers, with a bounded number of enrollments running at the same time.
+// The audio of each file is streamed from disk through a pull stream as the service consumes it, nothing is read ahead.
+// Enrollments failing with a transient error (connection, timeout, throttling, service errors) are retried with exponential
+// backoff and jitter, other errors fail the customer. A profile creation is only retried when throttled or when the service
+// is unavailable: after a timeout or a lost connection, the profile may have been created, and a retry would leave an orphan.
+// Every step is recorded in a journal, so a restarted run skips the customers already enrolled, and resumes the others with
+// the profile already created and the files not accepted yet, instead of creating duplicate profiles.
+class BulkVoiceEnroller final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using ResultCallback = std::function<void(const VoiceEnrollmentResult& result)>;
+
+    struct Options
+    {
+        size_t MaxConcurrentEnrollments = 8;
+        // Attempts per request, the first one included.
+        size_t MaxAttempts = 5;
+        std::chrono::milliseconds InitialBackoff{ 500 };
+        std::chrono::milliseconds MaxBackoff{ 30000 };
+        // Whether customers that failed in a previous run are tried again.
+        bool RetryFailed = false;
+        Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileType ProfileType =
+            Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileType::TextIndependentIdentification;
+        std::string Locale = "en-us";
+    };
+
+    struct Stats
+    {
+        size_t Enrolled = 0;
+        size_t Skipped = 0;
+        size_t Failed = 0;
+        size_t Retries = 0;             // of enrollment requests.
+        size_t CreateRetries = 0;       // of profile creation requests.
+        std::chrono::milliseconds WallTime{ 0 };
+    };
+
+    BulkVoiceEnroller(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, VoiceEnrollmentJournal& journal, Options options)
+        : m_config(std::move(config)), m_journal(journal), m_options(options)
+    {
+        if (!m_config)
+        {
+            throw std::invalid_argument("Speech config is null");
+        }
+        if (m_options.MaxConcurrentEnrollments == 0 || m_options.MaxAttempts == 0)
+        {
+            throw std::invalid_argument("MaxConcurrentEnrollments and MaxAttempts must be at least 1");
+        }
+    }
+
+    BulkVoiceEnroller(const BulkVoiceEnroller&) = delete;
+    BulkVoiceEnroller& operator=(const BulkVoiceEnroller&) = delete;
+
+    // Reads a manifest with one customer per line: the customer id, a tab, and the paths of the enrollment WAV files
+    // separated by ';'. Empty lines and lines starting with '#' are skipped.
+    static std::vector<VoiceEnrollmentJob> LoadManifest(const std::string& manifestFileName)
+    {
+        std::ifstream manifest(manifestFileName);
+        if (!manifest.good())
+        {
+            throw std::invalid_argument("Failed to open the manifest file.");
+        }
+
+        std::vector<VoiceEnrollmentJob> jobs;
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            auto tab = line.find('\t');
+            if (tab == std::string::npos || tab == 0)
+            {
+                throw std::invalid_argument("Invalid manifest line: " + line);
+            }
+
+            VoiceEnrollmentJob job;
+            job.CustomerId = line.substr(0, tab);
+            std::istringstream files(line.substr(tab + 1));
+            std::string file;
+            while (std::getline(files, file, ';'))
+            {
+                if (!file.empty())
+                {
+                    job.AudioFiles.push_back(file);
+                }
+            }
+            jobs.push_back(std::move(job));
+        }
+        return jobs;
+    }
+
+    // Enrolls the jobs and returns when all are done or the run is canceled. The callback is called as the jobs complete,
+    // one at a time. A journal that cannot be written, or a callback that throws, cancels the run: the enrollments in flight
+    // complete, the error is kept for GetError(), and an exception of the callback is rethrown once they are done.
+    void Run(const std::vector<VoiceEnrollmentJob>& jobs, ResultCallback onResult = nullptr)
+    {
+        for (const auto& job : jobs)
+        {
+            if (job.CustomerId.empty() || job.CustomerId.find_first_of("\t\r\n") != std::string::npos)
+            {
+                throw std::invalid_argument("Customer ids must not be empty, nor contain tabs or line breaks");
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats = Stats();
+            m_canceled = false;
+            m_error.clear();
+        }
+
+        auto start = Clock::now();
+        // Records the wall time also when a callback throws.
+        auto finish = [this, start]
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.WallTime = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        };
+        try
+        {
+            WorkerPool::ForEach(jobs.size(), m_options.MaxConcurrentEnrollments, [this, &jobs, &onResult]
+            {
+                using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+                // A client per thread, and a random source for the jitter of its backoffs.
+                std::shared_ptr<VoiceProfileClient> client = VoiceProfileClient::FromConfig(m_config);
+                std::mt19937 random(std::random_device{}());
+                return [this, &jobs, &onResult, client, random](size_t index) mutable
+                {
+                    if (!IsCanceled())
+                    {
+                        Process(*client, jobs[index], random, onResult);
+                    }
+                };
+            });
+        }
+        catch (...)
+        {
+            finish();
+            throw;
+        }
+        finish();
+    }
+
+    // Stops the run: the enrollments in flight complete, backoffs are cut short, and no new customer is started. The
+    // journal has the progress, the next run resumes from there.
+    void Cancel()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_canceled = true;
+        }
+        m_cancel.notify_all();
+    }
+
+    // The error that canceled the last run, e.g. a failed write to the journal, empty if none.
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    // Time to enroll a customer, retries included, in milliseconds.
+    const LatencyHistogram& EnrollmentTime() const
+    {
+        return m_enrollmentTime;
+    }
+
+private:
+    // Enrolls a customer, counts the result and passes it to the callback.
+    void Process(Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient& client, const VoiceEnrollmentJob& job,
+                 std::mt19937& random, const ResultCallback& onResult)
+    {
+        VoiceEnrollmentResult result;
+        try
+        {
+            result = Enroll(client, job, random);
+        }
+        catch (const std::exception& e)
+        {
+            // Enroll() handles the errors of the service, what it throws is a failed write to the journal. The run is
+            // canceled, as the progress of the next customers could not be resumed.
+            result.CustomerId = job.CustomerId;
+            result.ErrorDetails = e.what();
+            Fail(e.what());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (result.Skipped)
+            {
+                m_stats.Skipped++;
+            }
+            else if (result.Enrolled)
+            {
+                m_stats.Enrolled++;
+            }
+            else
+            {
+                m_stats.Failed++;
+            }
+        }
+        if (!result.Skipped)
+        {
+            m_enrollmentTime.Record(static_cast<uint64_t>(result.ProcessingTime.count()));
+        }
+        if (onResult)
+        {
+            try
+            {
+                std::lock_guard<std::mutex> lock(m_callbackMutex);
+                onResult(result);
+            }
+            catch (const std::exception& e)
+            {
+                Fail(e.what());
+                throw;
+            }
+        }
+    }
+
+    // Cancels the run because of an error, the first one is kept.
+    void Fail(const std::string& error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_error.empty())
+            {
+                m_error = error;
+            }
+        }
+        Cancel();
+    }
+
+    // Streams a WAV file to the service as it is pulled.
+    class WavFilePullCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        explicit WavFilePullCallback(const std::string& fileName) : m_reader(fileName) {}
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader.Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+    private:
+        WavFileReader m_reader;
+    };
+
+    enum class Outcome
+    {
+        Done,
+        Transient,
+        Permanent
+    };
+
+    static bool IsTransient(Microsoft::CognitiveServices::Speech::CancellationErrorCode code)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        return code == CancellationErrorCode::ConnectionFailure || code == CancellationErrorCode::ServiceTimeout ||
+            code == CancellationErrorCode::ServiceError || code == CancellationErrorCode::ServiceUnavailable ||
+            code == CancellationErrorCode::TooManyRequests;
+    }
+
+    bool IsCanceled()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_canceled;
+    }
+
+    // Whether a failed profile creation, which throws, was certainly not processed by the service, and can be retried.
+    static bool IsRetriableCreateError(const std::string& error)
+    {
+        for (auto text : { "429", "TooManyRequests", "Too many requests", "503", "ServiceUnavailable", "Service Unavailable" })
+        {
+            if (error.find(text) != std::string::npos)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Runs 'attempt' until it is done, fails permanently, or runs out of attempts, counting the attempts and the retries.
+    // Returns false if it did not succeed.
+    bool WithRetries(VoiceEnrollmentResult& result, size_t& attempts, size_t& retries, std::mt19937& random, const std::function<Outcome()>& attempt)
+    {
+        auto backoff = m_options.InitialBackoff;
+        for (size_t i = 0; i < m_options.MaxAttempts; i++)
+        {
+            if (i > 0)
+            {
+                // Full jitter: a random wait up to the backoff, so throttled workers do not retry in lockstep.
+                std::uniform_int_distribution<int64_t> jitter(0, backoff.count());
+                std::unique_lock<std::mutex> lock(m_mutex);
+                retries++;
+                if (m_cancel.wait_for(lock, std::chrono::milliseconds(jitter(random)), [this] { return m_canceled; }))
+                {
+                    result.ErrorDetails = "Canceled. " + result.ErrorDetails;
+                    return false;
+                }
+                backoff = std::min(backoff * 2, m_options.MaxBackoff);
+            }
+            attempts++;
+            switch (attempt())
+            {
+            case Outcome::Done:
+                return true;
+            case Outcome::Permanent:
+                return false;
+            case Outcome::Transient:
+                break;
+            }
+        }
+        return false;
+    }
+
+    VoiceEnrollmentResult Enroll(Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient& client, const VoiceEnrollmentJob& job,
+                                 std::mt19937& random)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        auto start = Clock::now();
+        VoiceEnrollmentResult result;
+        result.CustomerId = job.CustomerId;
+        auto finish = [&result, start]
+        {
+            result.ProcessingTime = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+            return result;
+        };
+
+        auto state = m_journal.Get(job.CustomerId);
+        result.ProfileId = state.ProfileId;
+        if (state.Enrolled || (state.Failed && !m_options.RetryFailed))
+        {
+            result.Enrolled = state.Enrolled;
+            result.Skipped = true;
+            result.ErrorDetails = state.ErrorDetails;
+            return finish();
+        }
+
+        // Reuses the profile of a previous run, an enrollment adds to the audio already accepted.
+        std::shared_ptr<VoiceProfile> profile;
+        if (!state.ProfileId.empty())
+        {
+            profile = VoiceProfile::FromId(state.ProfileId, m_options.ProfileType);
+        }
+        else
+        {
+            auto created = WithRetries(result, result.CreateAttempts, m_stats.CreateRetries, random, [&]()
+            {
+                try
+                {
+                    profile = client.CreateProfileAsync(m_options.ProfileType, m_options.Locale).get();
+                    return Outcome::Done;
+                }
+                catch (const std::exception& e)
+                {
+                    result.ErrorDetails = e.what();
+                    return IsRetriableCreateError(result.ErrorDetails) ? Outcome::Transient : Outcome::Permanent;
+                }
+            });
+            if (!created)
+            {
+                // Not journaled, as e.g. an authentication error or an invalid locale is not specific to the customer:
+                // the next run creates the profile again.
+                return finish();
+            }
+            result.ProfileId = profile->GetId();
+            m_journal.Created(job.CustomerId, result.ProfileId);
+        }
+
+        for (auto file = state.AcceptedFiles; file < job.AudioFiles.size() && !result.Enrolled; file++)
+        {
+            if (IsCanceled())
+            {
+                result.ErrorDetails = "Canceled";
+                return finish();
+            }
+            bool permanent = false;
+            auto accepted = WithRetries(result, result.Attempts, m_stats.Retries, random, [&]()
+            {
+                try
+                {
+                    // A new stream for each attempt, from the start of the file.
+                    auto stream = AudioInputStream::CreatePullStream(std::make_shared<WavFilePullCallback>(job.AudioFiles[file]));
+                    auto enrollment = client.EnrollProfileAsync(profile, AudioConfig::FromStreamInput(stream)).get();
+                    if (enrollment->Reason == ResultReason::EnrolledVoiceProfile)
+                    {
+                        result.Enrolled = true;
+                        return Outcome::Done;
+                    }
+                    if (enrollment->Reason == ResultReason::EnrollingVoiceProfile)
+                    {
+                        return Outcome::Done;
+                    }
+                    auto cancellation = VoiceProfileEnrollmentCancellationDetails::FromResult(enrollment);
+                    result.ErrorDetails = "ErrorCode=" + std::to_string((int)cancellation->ErrorCode) + " " + cancellation->ErrorDetails;
+                    permanent = !IsTransient(cancellation->ErrorCode);
+                    return permanent ? Outcome::Permanent : Outcome::Transient;
+                }
+                catch (const std::exception& e)
+                {
+                    // E.g. a missing or invalid audio file, retrying does not help.
+                    result.ErrorDetails = e.what();
+                    permanent = true;
+                    return Outcome::Permanent;
+                }
+            });
+
+            if (!accepted)
+            {
+                // A transient error that outlasted the retries is left to the next run.
+                if (permanent)
+                {
+                    m_journal.Failed(job.CustomerId, result.ErrorDetails);
+                }
+                return finish();
+            }
+            if (!result.Enrolled)
+            {
+                m_journal.Accepted(job.CustomerId, file + 1);
+            }
+        }
+
+        if (result.Enrolled)
+        {
+            result.ErrorDetails.clear();
+            m_journal.Enrolled(job.CustomerId, result.ProfileId);
+        }
+        else
+        {
+            result.ErrorDetails = "Not enough enrollment audio";
+            m_journal.Failed(job.CustomerId, result.ErrorDetails);
+        }
+        return finish();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    VoiceEnrollmentJournal& m_journal;
+    const Options m_options;
+
+    std::mutex m_mutex;
+    // Notified on Cancel(), to cut the backoffs short.
+    std::condition_variable m_cancel;
+    bool m_canceled = false;
+    std::string m_error;
+    Stats m_stats;
+    LatencyHistogram m_enrollmentTime;
+
+    // Held while the result callback runs, so it can print or collect the results without locking.
+    std::mutex m_callbackMutex;
+};
@@ -0,0 +1,765 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The intent matched in a text by CompiledPatternMatcher, no IntentId if none matched.
+struct PatternMatch
+{
+    std::string IntentId;
+    // Keyed by the entity name as written in the pattern, e.g. "floorName" or "floorName:1", as GetEntities() is.
+    std::map<std::string, std::string> Entities;
+};
+
+// Matches the intents of a PatternMatchingModel in text, locally, e.g. over transcripts already recognized, at high rates.
+// The patterns are compiled once: optional and required groups are expanded, and the resulting phrases are merged in a trie
+// of words. The phrases of all the list entities are compiled into an Aho-Corasick automaton, which finds every list value
+// in a text in a single pass. Matching then walks the trie along the words of the text, entities included.
+// A pattern must match the whole text, case and punctuation are ignored. Supported:
+//   "[a | b]"        optional group, one of the alternatives or nothing,
+//   "(a | b)"        required group, one of the alternatives,
+//   "{name}"         entity, "{name:id}" for several entities of the same name in a pattern,
+//   EntityType::List in Strict or Basic mode, one of its phrases, in Fuzzy mode any words, as EntityType::Any,
+//   EntityType::Any, one or more words, also entities not declared in the model,
+//   EntityType::PrebuiltInteger, digits or number words ("twenty one"), returned as digits.
+// When several patterns match, the one with the most literal words wins, then the intent added first.
+// The matcher is immutable once compiled, Match() and MatchBatch() may be called from any number of threads.
+class CompiledPatternMatcher final
+{
+public:
+    // Compiling a pattern with more phrases than this after the expansion of its groups fails.
+    static constexpr size_t MaxPhrasesPerPattern = 4096;
+
+    explicit CompiledPatternMatcher(const Microsoft::CognitiveServices::Speech::Intent::PatternMatchingModel& model)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Intent;
+
+        for (const auto& entity : model.Entities)
+        {
+            auto& definition = m_definitions[Lower(entity.Id)];
+            definition.Kind = entity.Type == EntityType::PrebuiltInteger ? EntityKind::Integer
+                : entity.Type == EntityType::List && entity.Mode != EntityMatchMode::Fuzzy ? EntityKind::List
+                : EntityKind::Any;
+            if (definition.Kind == EntityKind::List)
+            {
+                definition.List = static_cast<uint32_t>(m_lists++);
+                for (const auto& phrase : entity.Phrases)
+                {
+                    AddListPhrase(definition.List, phrase);
+                }
+            }
+        }
+        BuildFailureLinks();
+
+        m_nodes.emplace_back();
+        for (size_t intent = 0; intent < model.Intents.size(); intent++)
+        {
+            m_intents.push_back(model.Intents[intent].Id);
+            for (const auto& pattern : model.Intents[intent].Phrases)
+            {
+                size_t position = 0;
+                auto tokens = TokenizePattern(pattern);
+                auto phrases = ParseSequence(tokens, position, pattern);
+                if (position != tokens.size())
+                {
+                    throw std::invalid_argument("Unbalanced group in pattern: " + pattern);
+                }
+                for (const auto& phrase : phrases)
+                {
+                    AddPhrase(phrase, static_cast<int32_t>(intent));
+                }
+            }
+        }
+    }
+
+    CompiledPatternMatcher(const CompiledPatternMatcher&) = delete;
+    CompiledPatternMatcher& operator=(const CompiledPatternMatcher&) = delete;
+
+    PatternMatch Match(const std::string& text) const
+    {
+        Utterance utterance;
+        Tokenize(text, utterance);
+        FindEntities(utterance);
+
+        PatternMatch match;
+        auto best = Best(utterance, 0, 0);
+        if (best.Score < 0)
+        {
+            return match;
+        }
+        match.IntentId = m_intents[best.Intent];
+
+        // Follows the best choices back down the trie, collecting the entities.
+        uint32_t node = 0;
+        uint32_t position = 0;
+        while (position < utterance.Words.size())
+        {
+            const auto& step = utterance.Memo.at(Key(node, position));
+            if (step.Ref >= 0)
+            {
+                const auto& ref = m_refs[step.Ref];
+                match.Entities[ref.Name] = ref.Kind == EntityKind::Integer
+                    ? std::to_string(ParseInteger(utterance, position, step.End))
+                    : Join(utterance.Original, position, step.End);
+            }
+            node = step.Next;
+            position = step.End;
+        }
+        return match;
+    }
+
+    // Matches the texts on 'threads' threads, the hardware concurrency if 0. The results are in the order of the texts.
+    std::vector<PatternMatch> MatchBatch(const std::vector<std::string>& texts, size_t threads = 0) const
+    {
+        std::vector<PatternMatch> results(texts.size());
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        threads = std::max<size_t>(std::min(threads, texts.size()), 1);
+
+        // Contiguous ranges, so each thread writes its own part of the results.
+        auto run = [this, &texts, &results, threads](size_t index)
+        {
+            auto begin = texts.size() * index / threads;
+            auto end = texts.size() * (index + 1) / threads;
+            for (auto i = begin; i < end; i++)
+            {
+                // A text that cannot be matched must not end the worker thread, it matches no intent.
+                try
+                {
+                    results[i] = Match(texts[i]);
+                }
+                catch (const std::exception&)
+                {
+                    results[i] = PatternMatch();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < threads; i++)
+        {
+            workers.emplace_back(run, i);
+        }
+        run(0);
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return results;
+    }
+
+    // Number of trie nodes, i.e. the size of the compiled patterns.
+    size_t NodeCount() const
+    {
+        return m_nodes.size();
+    }
+
+private:
+    static constexpr uint32_t UnknownWord = UINT32_MAX;
+    static constexpr size_t MaxIntegerDigits = 18;
+
+    enum class EntityKind
+    {
+        Any,
+        List,
+        Integer
+    };
+
+    struct Definition
+    {
+        EntityKind Kind = EntityKind::Any;
+        uint32_t List = 0;
+    };
+
+    // An entity as referenced in a pattern, e.g. "{floorName:1}".
+    struct Ref
+    {
+        std::string Name;
+        EntityKind Kind;
+        uint32_t List;
+    };
+
+    // An element of an expanded phrase: a word id, or an entity reference if IsEntity.
+    struct Element
+    {
+        bool IsEntity;
+        uint32_t Id;
+    };
+    using Phrase = std::vector<Element>;
+
+    struct Node
+    {
+        // Sorted by word id.
+        std::vector<std::pair<uint32_t, uint32_t>> Words;
+        std::vector<std::pair<uint32_t, uint32_t>> Entities;
+        // The first intent with a phrase ending here, -1 if none.
+        int32_t Intent = -1;
+    };
+
+    // A state of the Aho-Corasick automaton over the words of the list phrases.
+    struct ListState
+    {
+        uint32_t Failure = 0;
+        // The next state with outputs along the failure links, 0 if none.
+        uint32_t Output = 0;
+        // List index and length in words of the phrases ending here.
+        std::vector<std::pair<uint32_t, uint32_t>> Phrases;
+    };
+
+    struct Step
+    {
+        int32_t Score = -1;
+        int32_t Intent = -1;
+        uint32_t Next = 0;
+        uint32_t End = 0;
+        int32_t Ref = -1;
+    };
+
+    struct Utterance
+    {
+        std::vector<uint32_t> Words;
+        std::vector<std::string> Original;
+        // List values starting at each word: list index and end position.
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> Lists;
+        // End positions of the integers starting at each word, the longest last.
+        std::vector<uint32_t> IntegerEnd;
+        std::unordered_map<uint64_t, Step> Memo;
+    };
+
+    static std::string Lower(const std::string& text)
+    {
+        std::string lower(text);
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c); });
+        return lower;
+    }
+
+    // Letters, digits, apostrophes and non-ASCII characters (UTF-8 bytes) are part of words, the rest separates them.
+    static bool IsWordChar(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '\'' || (static_cast<unsigned char>(c) & 0x80) != 0;
+    }
+
+    static std::vector<std::string> SplitWords(const std::string& text)
+    {
+        std::vector<std::string> words;
+        std::string word;
+        for (auto c : text)
+        {
+            if (IsWordChar(c))
+            {
+                word += c;
+            }
+            else if (!word.empty())
+            {
+                words.push_back(std::move(word));
+                word.clear();
+            }
+        }
+        if (!word.empty())
+        {
+            words.push_back(std::move(word));
+        }
+        return words;
+    }
+
+    static std::string Join(const std::vector<std::string>& words, size_t begin, size_t end)
+    {
+        std::string joined;
+        for (auto i = begin; i < end; i++)
+        {
+            joined += (i == begin ? "" : " ") + words[i];
+        }
+        return joined;
+    }
+
+    static uint64_t Key(uint32_t node, uint32_t position)
+    {
+        return (static_cast<uint64_t>(node) << 32) | position;
+    }
+
+    uint32_t WordId(const std::string& word)
+    {
+        auto inserted = m_vocabulary.emplace(Lower(word), static_cast<uint32_t>(m_vocabulary.size()));
+        return inserted.first->second;
+    }
+
+    uint32_t FindWord(const std::string& lower) const
+    {
+        auto word = m_vocabulary.find(lower);
+        return word == m_vocabulary.end() ? UnknownWord : word->second;
+    }
+
+    void AddListPhrase(uint32_t list, const std::string& phrase)
+    {
+        auto words = SplitWords(phrase);
+        if (words.empty())
+        {
+            return;
+        }
+        if (m_listStates.empty())
+        {
+            m_listStates.emplace_back();
+        }
+        uint32_t state = 0;
+        for (const auto& word : words)
+        {
+            auto inserted = m_listGoto.emplace(Key(state, WordId(word)), static_cast<uint32_t>(m_listStates.size()));
+            if (inserted.second)
+            {
+                m_listStates.emplace_back();
+            }
+            state = inserted.first->second;
+        }
+        m_listStates[state].Phrases.emplace_back(list, static_cast<uint32_t>(words.size()));
+    }
+
+    // Breadth-first, so the failure link of a state is computed before the states below it.
+    void BuildFailureLinks()
+    {
+        if (m_listStates.empty())
+        {
+            return;
+        }
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> children(m_listStates.size());
+        for (const auto& edge : m_listGoto)
+        {
+            children[static_cast<uint32_t>(edge.first >> 32)].emplace_back(static_cast<uint32_t>(edge.first), edge.second);
+        }
+
+        std::deque<uint32_t> queue;
+        queue.push_back(0);
+        while (!queue.empty())
+        {
+            auto state = queue.front();
+            queue.pop_front();
+            for (const auto& child : children[state])
+            {
+                if (state != 0)
+                {
+                    auto failure = m_listStates[state].Failure;
+                    while (true)
+                    {
+                        auto next = m_listGoto.find(Key(failure, child.first));
+                        if (next != m_listGoto.end())
+                        {
+                            failure = next->second;
+                            break;
+                        }
+                        if (failure == 0)
+                        {
+                            break;
+                        }
+                        failure = m_listStates[failure].Failure;
+                    }
+                    m_listStates[child.second].Failure = failure;
+                    m_listStates[child.second].Output = m_listStates[failure].Phrases.empty() ? m_listStates[failure].Output : failure;
+                }
+                queue.push_back(child.second);
+            }
+        }
+    }
+
+    // Splits a pattern into words, entity references and the group characters "[]()|".
+    static std::vector<std::string> TokenizePattern(const std::string& pattern)
+    {
+        std::vector<std::string> tokens;
+        std::string word;
+        auto flush = [&tokens, &word]
+        {
+            if (!word.empty())
+            {
+                tokens.push_back(std::move(word));
+                word.clear();
+            }
+        };
+        for (size_t i = 0; i < pattern.size(); i++)
+        {
+            auto c = pattern[i];
+            if (c == '{')
+            {
+                flush();
+                auto end = pattern.find('}', i);
+                if (end == std::string::npos)
+                {
+                    throw std::invalid_argument("Unterminated entity in pattern: " + pattern);
+                }
+                tokens.push_back(pattern.substr(i, end - i + 1));
+                i = end;
+            }
+            else if (c == '[' || c == ']' || c == '(' || c == ')' || c == '|')
+            {
+                flush();
+                tokens.push_back(std::string(1, c));
+            }
+            else if (IsWordChar(c))
+            {
+                word += c;
+            }
+            else
+            {
+                flush();
+            }
+        }
+        flush();
+        return tokens;
+    }
+
+    // Expands a sequence up to the end of the pattern, or up to the '|' or closing bracket of its group.
+    std::vector<Phrase> ParseSequence(const std::vector<std::string>& tokens, size_t& position, const std::string& pattern)
+    {
+        std::vector<Phrase> phrases(1);
+        while (position < tokens.size())
+        {
+            const auto& token = tokens[position];
+            if (token == "|" || token == "]" || token == ")")
+            {
+                break;
+            }
+            position++;
+
+            std::vector<Phrase> alternatives;
+            if (token == "[" || token == "(")
+            {
+                auto close = token == "[" ? "]" : ")";
+                while (true)
+                {
+                    auto alternative = ParseSequence(tokens, position, pattern);
+                    alternatives.insert(alternatives.end(), alternative.begin(), alternative.end());
+                    if (position < tokens.size() && tokens[position] == "|")
+                    {
+                        position++;
+                        continue;
+                    }
+                    if (position >= tokens.size() || tokens[position] != close)
+                    {
+                        throw std::invalid_argument("Unbalanced group in pattern: " + pattern);
+                    }
+                    position++;
+                    break;
+                }
+                if (token == "[")
+                {
+                    alternatives.emplace_back();
+                }
+            }
+            else if (token[0] == '{')
+            {
+                alternatives.push_back(Phrase{ Element{ true, RefId(token.substr(1, token.size() - 2)) } });
+            }
+            else
+            {
+                alternatives.push_back(Phrase{ Element{ false, WordId(token) } });
+            }
+
+            std::vector<Phrase> expanded;
+            for (const auto& phrase : phrases)
+            {
+                for (const auto& alternative : alternatives)
+                {
+                    expanded.push_back(phrase);
+                    expanded.back().insert(expanded.back().end(), alternative.begin(), alternative.end());
+                }
+            }
+            if (expanded.size() > MaxPhrasesPerPattern)
+            {
+                throw std::invalid_argument("Pattern expands to too many phrases: " + pattern);
+            }
+            phrases = std::move(expanded);
+        }
+        return phrases;
+    }
+
+    uint32_t RefId(const std::string& name)
+    {
+        for (size_t i = 0; i < m_refs.size(); i++)
+        {
+            if (m_refs[i].Name == name)
+            {
+                return static_cast<uint32_t>(i);
+            }
+        }
+
+        // "{floorName:1}" is an instance of the "floorName" entity.
+        Ref ref{ name, EntityKind::Any, 0 };
+        auto definition = m_definitions.find(Lower(name.substr(0, name.find(':'))));
+        if (definition != m_definitions.end())
+        {
+            ref.Kind = definition->second.Kind;
+            ref.List = definition->second.List;
+        }
+        m_refs.push_back(ref);
+        return static_cast<uint32_t>(m_refs.size() - 1);
+    }
+
+    void AddPhrase(const Phrase& phrase, int32_t intent)
+    {
+        if (phrase.empty())
+        {
+            return;
+        }
+        uint32_t node = 0;
+        for (const auto& element : phrase)
+        {
+            auto& edges = element.IsEntity ? m_nodes[node].Entities : m_nodes[node].Words;
+            auto edge = std::lower_bound(edges.begin(), edges.end(), std::make_pair(element.Id, 0u));
+            if (edge == edges.end() || edge->first != element.Id)
+            {
+                auto child = static_cast<uint32_t>(m_nodes.size());
+                edges.insert(edge, std::make_pair(element.Id, child));
+                m_nodes.emplace_back();
+                node = child;
+            }
+            else
+            {
+                node = edge->second;
+            }
+        }
+        if (m_nodes[node].Intent < 0)
+        {
+            m_nodes[node].Intent = intent;
+        }
+    }
+
+    void Tokenize(const std::string& text, Utterance& utterance) const
+    {
+        utterance.Original = SplitWords(text);
+        utterance.Words.reserve(utterance.Original.size());
+        for (const auto& word : utterance.Original)
+        {
+            utterance.Words.push_back(FindWord(Lower(word)));
+        }
+    }
+
+    void FindEntities(Utterance& utterance) const
+    {
+        auto count = utterance.Words.size();
+        utterance.Lists.resize(count);
+        uint32_t state = 0;
+        for (size_t i = 0; i < count && !m_listStates.empty(); i++)
+        {
+            auto word = utterance.Words[i];
+            while (true)
+            {
+                auto next = word == UnknownWord ? m_listGoto.end() : m_listGoto.find(Key(state, word));
+                if (next != m_listGoto.end())
+                {
+                    state = next->second;
+                    break;
+                }
+                if (state == 0)
+                {
+                    break;
+                }
+                state = m_listStates[state].Failure;
+            }
+            // The phrases ending here: the ones of the state, and of its suffixes along the output links.
+            auto output = m_listStates[state].Phrases.empty() ? m_listStates[state].Output : state;
+            for (; output != 0; output = m_listStates[output].Output)
+            {
+                for (const auto& phrase : m_listStates[output].Phrases)
+                {
+                    auto end = static_cast<uint32_t>(i + 1);
+                    utterance.Lists[end - phrase.second].emplace_back(phrase.first, end);
+                }
+            }
+        }
+
+        // A run of number words is an integer, as is each of its prefixes, up to the first word that takes the value beyond
+        // the range of int64_t: the value only grows along the run. Digits beyond the range of int64_t are not an integer.
+        utterance.IntegerEnd.assign(count, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto& word = utterance.Original[i];
+            if (!word.empty() && word.size() <= MaxIntegerDigits && std::all_of(word.begin(), word.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            {
+                utterance.IntegerEnd[i] = static_cast<uint32_t>(i + 1);
+                continue;
+            }
+            int64_t total = 0;
+            int64_t group = 0;
+            for (auto end = i; end < count; end++)
+            {
+                auto value = NumberWord(Lower(utterance.Original[end]));
+                if (value < 0 || !AddNumberWord(value, total, group))
+                {
+                    break;
+                }
+                utterance.IntegerEnd[i] = static_cast<uint32_t>(end + 1);
+            }
+        }
+    }
+
+    // The value of a number word, -1 if it is not one. Multipliers are negative below -1.
+    static int64_t NumberWord(const std::string& word)
+    {
+        static const std::map<std::string, int64_t> words = {
+            { "zero", 0 }, { "one", 1 }, { "two", 2 }, { "three", 3 }, { "four", 4 }, { "five", 5 }, { "six", 6 }, { "seven", 7 },
+            { "eight", 8 }, { "nine", 9 }, { "ten", 10 }, { "eleven", 11 }, { "twelve", 12 }, { "thirteen", 13 }, { "fourteen", 14 },
+            { "fifteen", 15 }, { "sixteen", 16 }, { "seventeen", 17 }, { "eighteen", 18 }, { "nineteen", 19 }, { "twenty", 20 },
+            { "thirty", 30 }, { "forty", 40 }, { "fifty", 50 }, { "sixty", 60 }, { "seventy", 70 }, { "eighty", 80 }, { "ninety", 90 },
+            { "hundred", 100 }, { "thousand", 1000 }, { "million", 1000000 }
+        };
+        auto value = words.find(word);
+        return value == words.end() ? -1 : value->second;
+    }
+
+    static int64_t ParseInteger(const Utterance& utterance, uint32_t begin, uint32_t end)
+    {
+        if (end == begin + 1 && !utterance.Original[begin].empty() && utterance.Original[begin][0] >= '0' && utterance.Original[begin][0] <= '9')
+        {
+            return std::stoll(utterance.Original[begin]);
+        }
+        int64_t total = 0;
+        int64_t group = 0;
+        for (auto i = begin; i < end; i++)
+        {
+            AddNumberWord(NumberWord(Lower(utterance.Original[i])), total, group);
+        }
+        return total + group;
+    }
+
+    // Adds the number word of 'value' to a value being read, the sum of 'total' and the current 'group' below a thousand.
+    // Returns false, leaving both unchanged, if the value would exceed the range of int64_t.
+    static bool AddNumberWord(int64_t value, int64_t& total, int64_t& group)
+    {
+        const auto max = std::numeric_limits<int64_t>::max();
+        auto nextTotal = total;
+        auto nextGroup = group;
+        if (value == 100)
+        {
+            if (nextGroup > max / 100)
+            {
+                return false;
+            }
+            nextGroup = std::max<int64_t>(nextGroup, 1) * 100;
+        }
+        else if (value >= 1000)
+        {
+            auto multiplier = std::max<int64_t>(nextGroup, 1);
+            if (multiplier > max / value || nextTotal > max - multiplier * value)
+            {
+                return false;
+            }
+            nextTotal += multiplier * value;
+            nextGroup = 0;
+        }
+        else
+        {
+            if (nextGroup > max - value)
+            {
+                return false;
+            }
+            nextGroup += value;
+        }
+        if (nextTotal > max - nextGroup)
+        {
+            return false;
+        }
+        total = nextTotal;
+        group = nextGroup;
+        return true;
+    }
+
+    // The best match of the words from 'position' on, starting at 'node'. Memoized, so each state is solved once.
+    Step Best(Utterance& utterance, uint32_t node, uint32_t position) const
+    {
+        auto key = Key(node, position);
+        auto memo = utterance.Memo.find(key);
+        if (memo != utterance.Memo.end())
+        {
+            return memo->second;
+        }
+
+        auto count = static_cast<uint32_t>(utterance.Words.size());
+        const auto& current = m_nodes[node];
+        Step best;
+        auto consider = [&best](const Step& candidate, int32_t literals, uint32_t next, uint32_t end, int32_t ref)
+        {
+            if (candidate.Score < 0)
+            {
+                return;
+            }
+            auto score = candidate.Score + literals;
+            if (score > best.Score || (score == best.Score && candidate.Intent < best.Intent))
+            {
+                best = Step{ score, candidate.Intent, next, end, ref };
+            }
+        };
+
+        if (position == count)
+        {
+            if (current.Intent >= 0)
+            {
+                best = Step{ 0, current.Intent, node, position, -1 };
+            }
+            utterance.Memo[key] = best;
+            return best;
+        }
+
+        auto word = utterance.Words[position];
+        auto edge = std::lower_bound(current.Words.begin(), current.Words.end(), std::make_pair(word, 0u));
+        if (word != UnknownWord && edge != current.Words.end() && edge->first == word)
+        {
+            consider(Best(utterance, edge->second, position + 1), 1, edge->second, position + 1, -1);
+        }
+
+        for (const auto& entity : current.Entities)
+        {
+            const auto& ref = m_refs[entity.first];
+            auto id = static_cast<int32_t>(entity.first);
+            switch (ref.Kind)
+            {
+            case EntityKind::List:
+                for (const auto& value : utterance.Lists[position])
+                {
+                    if (value.first == ref.List)
+                    {
+                        consider(Best(utterance, entity.second, value.second), 0, entity.second, value.second, id);
+                    }
+                }
+                break;
+            case EntityKind::Integer:
+                for (auto end = position + 1; end <= utterance.IntegerEnd[position]; end++)
+                {
+                    consider(Best(utterance, entity.second, end), 0, entity.second, end, id);
+                }
+                break;
+            case EntityKind::Any:
+                for (auto end = position + 1; end <= count; end++)
+                {
+                    consider(Best(utterance, entity.second, end), 0, entity.second, end, id);
+                }
+                break;
+            }
+        }
+
+        utterance.Memo[key] = best;
+        return best;
+    }
+
+    std::unordered_map<std::string, uint32_t> m_vocabulary;
+    std::map<std::string, Definition> m_definitions;
+    std::vector<Ref> m_refs;
+    std::vector<std::string> m_intents;
+    std::vector<Node> m_nodes;
+    size_t m_lists = 0;
+
+    // The Aho-Corasick automaton of the list phrases, its transitions keyed by state and word id.
+    std::vector<ListState> m_listStates;
+    std::unordered_map<uint64_t, uint32_t> m_listGoto;
+};
@@ -0,0 +1,199 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+// An utterance of a participant, with its offset and duration in ticks.
+struct TimelineUtterance
+{
+    std::string Speaker;
+    std::string Text;
+    uint64_t Offset = 0;
+    uint64_t Duration = 0;
+    // Set on an utterance that arrived after later ones were emitted, i.e. later than the reorder window.
+    bool Late = false;
+};
+
+// Running statistics of a participant, over the utterances emitted so far.
+struct ParticipantStats
+{
+    uint64_t Utterances = 0;
+    uint64_t TalkTime = 0;      // in ticks.
+    // Time spoken at the same time as other participants, in ticks, summed over the other participants.
+    uint64_t OverlapTime = 0;
+    uint64_t FirstOffset = 0;
+    uint64_t LastEnd = 0;
+};
+
+// Merges the results of a conversation, which may arrive out of order (e.g. when several participants speak at once),
+// into one time-ordered transcript.
+// The results are buffered in a reorder window, and emitted in offset order once a result arriving at least
+// ReorderWindow later in the audio has been added, or when more than MaxPending are buffered, so the latency is bounded.
+// Running statistics of each participant are updated with each emitted utterance.
+class ConversationTimelineMerger final
+{
+public:
+    struct Options
+    {
+        // In ticks, 2 seconds by default.
+        uint64_t ReorderWindow = 20000000;
+        size_t MaxPending = 64;
+    };
+
+    // Called from Add() and Flush(), one utterance at a time, in offset order (except for late utterances).
+    // It must not call back into the merger.
+    using UtteranceCallback = std::function<void(const TimelineUtterance& utterance)>;
+
+    ConversationTimelineMerger(Options options, UtteranceCallback onUtterance)
+        : m_options(options), m_onUtterance(std::move(onUtterance))
+    {
+    }
+
+    ConversationTimelineMerger(const ConversationTimelineMerger&) = delete;
+    ConversationTimelineMerger& operator=(const ConversationTimelineMerger&) = delete;
+
+    // Adds a Transcribed result. Results other than RecognizedSpeech are ignored.
+    void Add(const Microsoft::CognitiveServices::Speech::Transcription::ConversationTranscriptionResult& result)
+    {
+        if (result.Reason != Microsoft::CognitiveServices::Speech::ResultReason::RecognizedSpeech)
+        {
+            return;
+        }
+        TimelineUtterance utterance;
+        utterance.Speaker = result.UserId;
+        utterance.Text = result.Text;
+        utterance.Offset = result.Offset();
+        utterance.Duration = result.Duration();
+        Add(std::move(utterance));
+    }
+
+    void Add(TimelineUtterance utterance)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_newestOffset = std::max(m_newestOffset, utterance.Offset);
+        if (m_emittedAny && utterance.Offset < m_lastEmittedOffset)
+        {
+            // Too late to be put in order, emitted right away rather than dropped.
+            utterance.Late = true;
+            m_late++;
+            Emit(utterance);
+            return;
+        }
+
+        m_pending.push(Pending{ std::move(utterance), m_sequence++ });
+        while (!m_pending.empty() &&
+               (m_pending.size() > m_options.MaxPending || m_pending.top().Utterance.Offset + m_options.ReorderWindow <= m_newestOffset))
+        {
+            EmitNext();
+        }
+    }
+
+    // Emits all the buffered utterances, e.g. at the end of the conversation.
+    void Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_pending.empty())
+        {
+            EmitNext();
+        }
+    }
+
+    std::map<std::string, ParticipantStats> GetParticipantStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_participants;
+    }
+
+    // Utterances that arrived out of the reorder window.
+    uint64_t GetLateCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_late;
+    }
+
+private:
+    struct Pending
+    {
+        TimelineUtterance Utterance;
+        uint64_t Sequence;  // keeps the arrival order of utterances at the same offset.
+    };
+
+    struct Later
+    {
+        bool operator()(const Pending& a, const Pending& b) const
+        {
+            return a.Utterance.Offset != b.Utterance.Offset ? a.Utterance.Offset > b.Utterance.Offset : a.Sequence > b.Sequence;
+        }
+    };
+
+    struct Interval
+    {
+        std::string Speaker;
+        uint64_t End;
+    };
+
+    void EmitNext()
+    {
+        auto utterance = m_pending.top().Utterance;
+        m_pending.pop();
+        m_lastEmittedOffset = utterance.Offset;
+        m_emittedAny = true;
+        Emit(utterance);
+    }
+
+    void Emit(const TimelineUtterance& utterance)
+    {
+        auto end = utterance.Offset + utterance.Duration;
+        auto& stats = m_participants[utterance.Speaker];
+        if (stats.Utterances == 0)
+        {
+            stats.FirstOffset = utterance.Offset;
+        }
+        stats.Utterances++;
+        stats.TalkTime += utterance.Duration;
+        stats.LastEnd = std::max(stats.LastEnd, end);
+
+        // The utterances still going on are the only ones it can overlap, since the others started earlier.
+        m_speaking.erase(std::remove_if(m_speaking.begin(), m_speaking.end(),
+                                        [&utterance](const Interval& interval) { return interval.End <= utterance.Offset; }),
+                         m_speaking.end());
+        if (!utterance.Late)
+        {
+            for (const auto& interval : m_speaking)
+            {
+                if (interval.Speaker != utterance.Speaker)
+                {
+                    auto overlap = std::min(interval.End, end) - utterance.Offset;
+                    stats.OverlapTime += overlap;
+                    m_participants[interval.Speaker].OverlapTime += overlap;
+                }
+            }
+            m_speaking.push_back(Interval{ utterance.Speaker, end });
+        }
+
+        m_onUtterance(utterance);
+    }
+
+    const Options m_options;
+    UtteranceCallback m_onUtterance;
+
+    std::mutex m_mutex;
+    std::priority_queue<Pending, std::vector<Pending>, Later> m_pending;
+    uint64_t m_sequence = 0;
+    uint64_t m_newestOffset = 0;
+    uint64_t m_lastEmittedOffset = 0;
+    bool m_emittedAny = false;
+    uint64_t m_late = 0;
+    std::vector<Interval> m_speaking;
+    std::map<std::string, ParticipantStats> m_participants;
+};
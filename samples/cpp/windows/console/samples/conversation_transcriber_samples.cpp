@@ -8,6 +8,7 @@
 #include <speechapi_cxx.h>
 #include <fstream>
 #include "wav_file_reader.h"
+#include "conversation_timeline.h"
 #include <chrono>
 
 using namespace std;
@@ -114,13 +115,23 @@ void ConversationWithPullAudioStream()
     // a promise for synchronization of recognition end.
     promise<void> recognitionEnd;
 
+    // Puts the transcribed results, which arrive as they come, in a time-ordered transcript.
+    // An utterance is printed once the transcription is 2 seconds of audio past it, or at the end.
+    ConversationTimelineMerger::Options timelineOptions;
+    timelineOptions.ReorderWindow = 20000000;
+    ConversationTimelineMerger timeline(timelineOptions, [](const TimelineUtterance& utterance)
+    {
+        cout << "TIMELINE: [" << utterance.Offset / 10000 << "ms] " << utterance.Speaker << ": " << utterance.Text
+             << (utterance.Late ? " (late)" : "") << std::endl;
+    });
+
     // Subscribes to events.
     recognizer->Transcribing.Connect([](const ConversationTranscriptionEventArgs& e)
     {
         cout << "TRANSCRIBING: Text=" << e.Result->Text << std::endl;
     });
 
-    recognizer->Transcribed.Connect([](const ConversationTranscriptionEventArgs& e)
+    recognizer->Transcribed.Connect([&timeline](const ConversationTranscriptionEventArgs& e)
     {
         if (e.Result->Reason == ResultReason::RecognizedSpeech)
         {
@@ -128,6 +139,7 @@ void ConversationWithPullAudioStream()
                 << "  Offset=" << e.Result->Offset() << std::endl
                 << "  Duration=" << e.Result->Duration() << std::endl
                 << "  UserId=" << e.Result->UserId << std::endl;
+            timeline.Add(*e.Result);
         }
         else if (e.Result->Reason == ResultReason::NoMatch)
         {
@@ -168,6 +180,14 @@ void ConversationWithPullAudioStream()
 
     // Stops transcribing. This is optional.
     recognizer->StopTranscribingAsync().wait();
+
+    // Prints the rest of the transcript, and the talk time of each participant.
+    timeline.Flush();
+    for (const auto& participant : timeline.GetParticipantStats())
+    {
+        cout << "PARTICIPANT: " << participant.first << " Utterances=" << participant.second.Utterances
+             << " TalkTime=" << participant.second.TalkTime / 10000 << "ms OverlapTime=" << participant.second.OverlapTime / 10000 << "ms" << std::endl;
+    }
 }
 
 // Transcribing conversation using a push audio stream
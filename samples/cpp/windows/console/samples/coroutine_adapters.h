@@ -0,0 +1,415 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+// Coroutine adapters for the future-returning async methods of the Speech SDK.
+// They need C++20 (e.g. /std:c++20 or --std=c++20), the samples are built as C++14 by default.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define SAMPLES_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef SAMPLES_HAS_COROUTINES
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A lazily started coroutine that produces a T. It starts when it is awaited, and resumes its awaiter when done.
+template<typename T = void>
+class Task;
+
+namespace CoroutineDetails
+{
+    // Transfers to the awaiter of a finished task, without growing the stack.
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept { return handle.promise().Continuation; }
+        void await_resume() noexcept {}
+    };
+
+    template<typename T>
+    struct PromiseBase
+    {
+        std::coroutine_handle<> Continuation = std::noop_coroutine();
+        std::exception_ptr Exception;
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { Exception = std::current_exception(); }
+    };
+}
+
+template<typename T>
+class Task final
+{
+public:
+    struct promise_type : CoroutineDetails::PromiseBase<T>
+    {
+        std::optional<T> Value;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T value) { Value = std::move(value); }
+    };
+
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        m_handle.promise().Continuation = awaiter;
+        return m_handle;
+    }
+
+    T await_resume()
+    {
+        if (m_handle.promise().Exception)
+        {
+            std::rethrow_exception(m_handle.promise().Exception);
+        }
+        return std::move(*m_handle.promise().Value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template<>
+class Task<void> final
+{
+public:
+    struct promise_type : CoroutineDetails::PromiseBase<void>
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() {}
+    };
+
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        m_handle.promise().Continuation = awaiter;
+        return m_handle;
+    }
+
+    void await_resume()
+    {
+        if (m_handle.promise().Exception)
+        {
+            std::rethrow_exception(m_handle.promise().Exception);
+        }
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Runs coroutines on a fixed number of worker threads, one per core by default.
+// The SDK's std::future results cannot notify on completion, so a single watcher thread polls the futures that
+// coroutines are waiting for, and resumes the coroutines on the workers once they are ready. Thousands of sessions
+// waiting for the service therefore hold no thread.
+class CoroutineExecutor final
+{
+public:
+    explicit CoroutineExecutor(size_t workerCount = std::thread::hardware_concurrency(),
+                               std::chrono::milliseconds pollInterval = std::chrono::milliseconds(2))
+        : m_pollInterval(pollInterval)
+    {
+        for (size_t i = 0; i < (workerCount > 0 ? workerCount : 1); i++)
+        {
+            m_workers.emplace_back(&CoroutineExecutor::WorkerLoop, this);
+        }
+        m_watcher = std::thread(&CoroutineExecutor::WatchLoop, this);
+    }
+
+    CoroutineExecutor(const CoroutineExecutor&) = delete;
+    CoroutineExecutor& operator=(const CoroutineExecutor&) = delete;
+
+    // All spawned tasks must have finished before the executor is destroyed.
+    ~CoroutineExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+        m_watched.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_watcher.join();
+    }
+
+    // Resumes 'handle' on a worker thread.
+    void Post(std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_readyQueue.push_back(handle);
+        }
+        m_ready.notify_one();
+    }
+
+    // Awaitable that continues the coroutine on a worker thread.
+    auto Schedule()
+    {
+        struct ScheduleAwaiter
+        {
+            CoroutineExecutor& Executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { Executor.Post(handle); }
+            void await_resume() const noexcept {}
+        };
+        return ScheduleAwaiter{ *this };
+    }
+
+    // Awaitable for a future returned by the SDK, e.g. co_await executor.Await(recognizer->RecognizeOnceAsync()).
+    // The coroutine continues on a worker thread once the future is ready, and gets its value or exception.
+    template<typename T>
+    auto Await(std::future<T> future)
+    {
+        struct FutureAwaiter
+        {
+            CoroutineExecutor& Executor;
+            std::future<T> Future;
+
+            bool await_ready() const
+            {
+                return Future.wait_for(std::chrono::seconds(0)) != std::future_status::timeout;
+            }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                Executor.Watch([this]() { return await_ready(); }, handle);
+            }
+            T await_resume()
+            {
+                return Future.get();
+            }
+        };
+        return FutureAwaiter{ *this, std::move(future) };
+    }
+
+    // Starts 'task' on a worker thread. The returned future is ready when the task is done, and holds its exception.
+    std::future<void> Spawn(Task<void> task)
+    {
+        std::promise<void> done;
+        auto future = done.get_future();
+        RunDetached(*this, std::move(task), std::move(done));
+        return future;
+    }
+
+private:
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    static DetachedTask RunDetached(CoroutineExecutor& executor, Task<void> task, std::promise<void> done)
+    {
+        co_await executor.Schedule();
+        try
+        {
+            co_await task;
+            done.set_value();
+        }
+        catch (...)
+        {
+            done.set_exception(std::current_exception());
+        }
+    }
+
+    struct WatchedFuture
+    {
+        std::function<bool()> IsReady;
+        std::coroutine_handle<> Handle;
+    };
+
+    void Watch(std::function<bool()> isReady, std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_watchList.push_back({ std::move(isReady), handle });
+        }
+        m_watched.notify_one();
+    }
+
+    void WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_ready.wait(lock, [this] { return m_stopping || !m_readyQueue.empty(); });
+            if (m_readyQueue.empty())
+            {
+                return;
+            }
+            auto handle = m_readyQueue.front();
+            m_readyQueue.pop_front();
+
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        }
+    }
+
+    void WatchLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            if (m_watchList.empty())
+            {
+                m_watched.wait(lock, [this] { return m_stopping || !m_watchList.empty(); });
+                continue;
+            }
+
+            std::vector<WatchedFuture> watching;
+            watching.swap(m_watchList);
+            lock.unlock();
+
+            std::vector<WatchedFuture> pending;
+            for (auto& watched : watching)
+            {
+                if (watched.IsReady())
+                {
+                    Post(watched.Handle);
+                }
+                else
+                {
+                    pending.push_back(std::move(watched));
+                }
+            }
+
+            lock.lock();
+            m_watchList.insert(m_watchList.end(), std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.end()));
+            if (!pending.empty())
+            {
+                m_watched.wait_for(lock, m_pollInterval, [this] { return m_stopping; });
+            }
+        }
+    }
+
+    const std::chrono::milliseconds m_pollInterval;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_watched;
+    std::deque<std::coroutine_handle<>> m_readyQueue;
+    std::vector<WatchedFuture> m_watchList;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+    std::thread m_watcher;
+};
+
+// A one-shot event that a coroutine can await, set from an SDK event handler.
+// It replaces the promise used by the samples to wait for the end of a session, and can be set more than once,
+// e.g. from both the Canceled and the SessionStopped events.
+class AsyncSignal final
+{
+public:
+    explicit AsyncSignal(CoroutineExecutor& executor) : m_executor(executor) {}
+
+    AsyncSignal(const AsyncSignal&) = delete;
+    AsyncSignal& operator=(const AsyncSignal&) = delete;
+
+    void Set()
+    {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_set)
+            {
+                return;
+            }
+            m_set = true;
+            waiter = std::exchange(m_waiter, nullptr);
+        }
+        if (waiter)
+        {
+            m_executor.Post(waiter);
+        }
+    }
+
+    // Only one coroutine can await the signal.
+    auto operator co_await()
+    {
+        struct SignalAwaiter
+        {
+            AsyncSignal& Signal;
+            bool await_ready() const
+            {
+                std::lock_guard<std::mutex> lock(Signal.m_mutex);
+                return Signal.m_set;
+            }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> lock(Signal.m_mutex);
+                if (Signal.m_set)
+                {
+                    return false;
+                }
+                Signal.m_waiter = handle;
+                return true;
+            }
+            void await_resume() const noexcept {}
+        };
+        return SignalAwaiter{ *this };
+    }
+
+private:
+    CoroutineExecutor& m_executor;
+    std::mutex m_mutex;
+    bool m_set = false;
+    std::coroutine_handle<> m_waiter;
+};
+
+#endif // SAMPLES_HAS_COROUTINES
@@ -0,0 +1,426 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "latency_histogram.h"
+#include "worker_pool.h"
+
+// A labelled utterance of an evaluation corpus, either a text or an audio file.
+struct IntentCorpusItem
+{
+    std::string Text;
+    // A WAV file with one utterance, used instead of the text if set.
+    std::string AudioPath;
+    // Empty if no intent should match.
+    std::string ExpectedIntent;
+    // The entities that should be returned, others returned are ignored.
+    std::map<std::string, std::string> ExpectedEntities;
+};
+
+// The evaluation of one item of the corpus.
+struct IntentEvaluationResult
+{
+    size_t Index = 0;                       // position of the item in the corpus.
+    std::string RecognizedText;
+    std::string IntentId;                   // empty if no intent matched.
+    std::map<std::string, std::string> Entities;
+    bool IntentCorrect = false;
+    bool EntitiesCorrect = false;
+    bool Failed = false;                    // canceled with an error, not counted in the accuracy.
+    std::string ErrorDetails;
+    std::chrono::microseconds Latency{ 0 };
+};
+
+// Runs a labelled corpus through intent recognizers concurrently, e.g. to regression-test a change of the intent model.
+// Texts are recognized with RecognizeOnceAsync(text), on one recognizer per worker. Audio files are recognized with
+// RecognizeOnceAsync(), on a recognizer per file, as its audio input is the file.
+// Collects a confusion matrix of the expected and returned intents, the intent and entity accuracy, and the latency of each
+// recognition, from the call to the result.
+class IntentEvaluator final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // Creates a recognizer with the intent model to evaluate, e.g. with ApplyLanguageModels() or AddIntent().
+    // May be called from several workers at the same time.
+    using RecognizerFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Intent::IntentRecognizer>(
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> audioInput)>;
+    using ResultCallback = std::function<void(const IntentCorpusItem& item, const IntentEvaluationResult& result)>;
+    // Expected intent, then returned intent, to count.
+    using ConfusionMatrix = std::map<std::string, std::map<std::string, size_t>>;
+
+    // The label of "no intent" in the confusion matrix.
+    static const char* NoIntent()
+    {
+        return "(none)";
+    }
+
+    struct Options
+    {
+        // Maximum number of recognitions running at the same time.
+        size_t MaxConcurrentRecognitions = 8;
+    };
+
+    struct Stats
+    {
+        size_t Items = 0;
+        size_t IntentCorrect = 0;
+        size_t WithEntities = 0;            // items with expected entities.
+        size_t EntitiesCorrect = 0;
+        size_t Failed = 0;
+        std::chrono::milliseconds WallTime{ 0 };
+
+        double IntentAccuracy() const
+        {
+            return Items > Failed ? static_cast<double>(IntentCorrect) / (Items - Failed) : 0.0;
+        }
+
+        double EntityAccuracy() const
+        {
+            return WithEntities > 0 ? static_cast<double>(EntitiesCorrect) / WithEntities : 0.0;
+        }
+
+        // Items evaluated per second of wall time.
+        double Throughput() const
+        {
+            return WallTime.count() > 0 ? Items * 1000.0 / WallTime.count() : 0.0;
+        }
+    };
+
+    IntentEvaluator(RecognizerFactory factory, Options options) : m_factory(std::move(factory)), m_options(options)
+    {
+        if (!m_factory)
+        {
+            throw std::invalid_argument("Recognizer factory is null");
+        }
+        if (m_options.MaxConcurrentRecognitions == 0)
+        {
+            throw std::invalid_argument("MaxConcurrentRecognitions must be at least 1");
+        }
+    }
+
+    IntentEvaluator(const IntentEvaluator&) = delete;
+    IntentEvaluator& operator=(const IntentEvaluator&) = delete;
+
+    // Reads a corpus with one tab separated item per line: the expected intent ("-" for none), the text or '@' and the
+    // path of a WAV file, and optionally the expected entities as name=value pairs separated by ';'.
+    // Empty lines and lines starting with '#' are skipped.
+    static std::vector<IntentCorpusItem> LoadCorpus(const std::string& corpusFileName)
+    {
+        std::ifstream corpus(corpusFileName);
+        if (!corpus.good())
+        {
+            throw std::invalid_argument("Failed to open the corpus file.");
+        }
+
+        std::vector<IntentCorpusItem> items;
+        std::string line;
+        while (std::getline(corpus, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            auto columns = Split(line, '\t');
+            if (columns.size() < 2)
+            {
+                throw std::invalid_argument("Invalid corpus line: " + line);
+            }
+            IntentCorpusItem item;
+            item.ExpectedIntent = columns[0] == "-" ? std::string() : columns[0];
+            if (!columns[1].empty() && columns[1][0] == '@')
+            {
+                item.AudioPath = columns[1].substr(1);
+            }
+            else
+            {
+                item.Text = columns[1];
+            }
+            if (columns.size() > 2 && !columns[2].empty())
+            {
+                for (const auto& entity : Split(columns[2], ';'))
+                {
+                    auto equals = entity.find('=');
+                    if (equals == std::string::npos)
+                    {
+                        throw std::invalid_argument("Invalid entity in corpus line: " + line);
+                    }
+                    item.ExpectedEntities[entity.substr(0, equals)] = entity.substr(equals + 1);
+                }
+            }
+            items.push_back(std::move(item));
+        }
+        return items;
+    }
+
+    // Evaluates the corpus and returns when all items are done, with the results in the order of the corpus.
+    // The callback is called as the items complete, one at a time. If it throws, no new item is started, and the
+    // exception is rethrown once the items in flight are done.
+    std::vector<IntentEvaluationResult> Run(const std::vector<IntentCorpusItem>& corpus, ResultCallback onResult = nullptr)
+    {
+        std::vector<IntentEvaluationResult> results(corpus.size());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats = Stats();
+            m_confusion.clear();
+        }
+        m_latency.Reset();
+
+        auto start = Clock::now();
+        WorkerPool::ForEach(corpus.size(), m_options.MaxConcurrentRecognitions, [this, &corpus, &results, &onResult]
+        {
+            // The recognizer of the texts, reused for all the texts of this thread.
+            std::shared_ptr<Microsoft::CognitiveServices::Speech::Intent::IntentRecognizer> textRecognizer;
+            return [this, &corpus, &results, &onResult, textRecognizer](size_t index) mutable
+            {
+                auto& result = results[index];
+                result.Index = index;
+                Evaluate(corpus[index], result, textRecognizer);
+                Count(corpus[index], result);
+                if (onResult)
+                {
+                    std::lock_guard<std::mutex> lock(m_callbackMutex);
+                    onResult(corpus[index], result);
+                }
+            };
+        });
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.WallTime = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        return results;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    // The failed items are not counted.
+    ConfusionMatrix GetConfusionMatrix()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_confusion;
+    }
+
+    // Latency of each recognition, in microseconds.
+    const LatencyHistogram& Latency() const
+    {
+        return m_latency;
+    }
+
+    // Writes the accuracy, the precision and recall of each intent, the confusion matrix and the latency of the last run.
+    void PrintReport(std::ostream& out)
+    {
+        auto stats = GetStats();
+        auto confusion = GetConfusionMatrix();
+
+        auto flags = out.flags();
+        auto precision = out.precision();
+        out << std::fixed << std::setprecision(1)
+            << "Evaluated " << stats.Items << " items (" << stats.Failed << " failed) in " << stats.WallTime.count() << " ms, "
+            << stats.Throughput() << " items per second.\n"
+            << "Intent accuracy: " << stats.IntentAccuracy() * 100 << "%, entity accuracy: " << stats.EntityAccuracy() * 100
+            << "% (" << stats.WithEntities << " items with entities).\n";
+
+        std::set<std::string> labels;
+        for (const auto& row : confusion)
+        {
+            labels.insert(row.first);
+            for (const auto& cell : row.second)
+            {
+                labels.insert(cell.first);
+            }
+        }
+        size_t width = 8;
+        for (const auto& label : labels)
+        {
+            width = std::max(width, label.size() + 2);
+        }
+
+        for (const auto& label : labels)
+        {
+            size_t truePositives = Cell(confusion, label, label);
+            size_t expected = 0;
+            size_t returned = 0;
+            for (const auto& other : labels)
+            {
+                expected += Cell(confusion, label, other);
+                returned += Cell(confusion, other, label);
+            }
+            out << "  " << std::left << std::setw(static_cast<int>(width)) << label << std::right
+                << " precision=" << (returned > 0 ? 100.0 * truePositives / returned : 0.0) << "%"
+                << " recall=" << (expected > 0 ? 100.0 * truePositives / expected : 0.0) << "%\n";
+        }
+
+        // Rows are the expected intents, columns the returned ones.
+        out << "Confusion matrix (expected x returned):\n" << std::setw(static_cast<int>(width)) << "";
+        for (const auto& label : labels)
+        {
+            out << std::setw(static_cast<int>(width)) << label;
+        }
+        out << "\n";
+        for (const auto& row : labels)
+        {
+            out << std::setw(static_cast<int>(width)) << row;
+            for (const auto& column : labels)
+            {
+                out << std::setw(static_cast<int>(width)) << Cell(confusion, row, column);
+            }
+            out << "\n";
+        }
+        out.flags(flags);
+        out.precision(precision);
+        m_latency.Print(out, "Recognition latency", 1000.0, "ms");
+    }
+
+private:
+    static std::vector<std::string> Split(const std::string& text, char separator)
+    {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (true)
+        {
+            auto end = text.find(separator, start);
+            parts.push_back(text.substr(start, end == std::string::npos ? std::string::npos : end - start));
+            if (end == std::string::npos)
+            {
+                return parts;
+            }
+            start = end + 1;
+        }
+    }
+
+    static std::string Lower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](char c) { return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c); });
+        return text;
+    }
+
+    static size_t Cell(const ConfusionMatrix& confusion, const std::string& expected, const std::string& returned)
+    {
+        auto row = confusion.find(expected);
+        if (row == confusion.end())
+        {
+            return 0;
+        }
+        auto cell = row->second.find(returned);
+        return cell == row->second.end() ? 0 : cell->second;
+    }
+
+    void Evaluate(const IntentCorpusItem& item, IntentEvaluationResult& result,
+                  std::shared_ptr<Microsoft::CognitiveServices::Speech::Intent::IntentRecognizer>& textRecognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        try
+        {
+            std::shared_ptr<Intent::IntentRecognizer> recognizer;
+            if (item.AudioPath.empty())
+            {
+                if (textRecognizer == nullptr)
+                {
+                    // Texts need no audio input, an empty stream keeps the recognizer off the microphone.
+                    textRecognizer = m_factory(AudioConfig::FromStreamInput(AudioInputStream::CreatePushStream()));
+                }
+                recognizer = textRecognizer;
+            }
+            else
+            {
+                recognizer = m_factory(AudioConfig::FromWavFileInput(item.AudioPath));
+            }
+            if (recognizer == nullptr)
+            {
+                throw std::runtime_error("Recognizer factory returned null");
+            }
+
+            auto start = Clock::now();
+            auto recognition = item.AudioPath.empty() ? recognizer->RecognizeOnceAsync(item.Text).get() : recognizer->RecognizeOnceAsync().get();
+            result.Latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+
+            result.RecognizedText = recognition->Text;
+            if (recognition->Reason == ResultReason::RecognizedIntent)
+            {
+                result.IntentId = recognition->IntentId;
+                result.Entities = recognition->GetEntities();
+            }
+            else if (recognition->Reason == ResultReason::Canceled)
+            {
+                auto cancellation = CancellationDetails::FromResult(recognition);
+                result.Failed = true;
+                result.ErrorDetails = "ErrorCode=" + std::to_string((int)cancellation->ErrorCode) + " " + cancellation->ErrorDetails;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            result.Failed = true;
+            result.ErrorDetails = e.what();
+        }
+
+        result.IntentCorrect = !result.Failed && result.IntentId == item.ExpectedIntent;
+        result.EntitiesCorrect = !result.Failed;
+        for (const auto& expected : item.ExpectedEntities)
+        {
+            auto entity = result.Entities.find(expected.first);
+            if (entity == result.Entities.end() || Lower(entity->second) != Lower(expected.second))
+            {
+                result.EntitiesCorrect = false;
+            }
+        }
+    }
+
+    void Count(const IntentCorpusItem& item, const IntentEvaluationResult& result)
+    {
+        if (!result.Failed)
+        {
+            m_latency.Record(static_cast<uint64_t>(result.Latency.count()));
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.Items++;
+        if (result.Failed)
+        {
+            m_stats.Failed++;
+            return;
+        }
+        m_stats.IntentCorrect += result.IntentCorrect ? 1 : 0;
+        if (!item.ExpectedEntities.empty())
+        {
+            m_stats.WithEntities++;
+            m_stats.EntitiesCorrect += result.EntitiesCorrect ? 1 : 0;
+        }
+        m_confusion[item.ExpectedIntent.empty() ? NoIntent() : item.ExpectedIntent][result.IntentId.empty() ? NoIntent() : result.IntentId]++;
+    }
+
+    RecognizerFactory m_factory;
+    const Options m_options;
+
+    std::mutex m_mutex;
+    Stats m_stats;
+    ConfusionMatrix m_confusion;
+    LatencyHistogram m_latency;
+
+    // Held while the result callback runs, so it can tally or print the results without locking.
+    std::mutex m_callbackMutex;
+};
@@ -5,6 +5,14 @@
 
 #include "stdafx.h"
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include "speculative_turn_engine.h"
+#include "compiled_pattern_matcher.h"
+#include "intent_evaluator.h"
+#include "barge_in_voice_loop.h"
+
 // <toplevel>
 #include <speechapi_cxx.h>
 
@@ -339,3 +347,230 @@ void IntentRecognitionWithPatternMatchingAndMicrophone()
     }
     // </IntentRecognitionWithPatternMatchingAndMicrophone>
 }
+
+// Turn latency of a voice dialog, with and without speculative synthesis, replaying a recorded utterance.
+void IntentTurnLatencyBenchmarkWithFile()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Matches the intents locally, with a pattern matching model on the text of the partial and final results.
+    auto matcher = IntentRecognizer::FromConfig(config);
+    auto model = PatternMatchingModel::FromModelId("WeatherModel");
+    model->Intents.push_back({ {"what's the weather [like] [in {city}]", "what is the weather [like] [in {city}]"}, "Weather" });
+    model->Intents.push_back({ {"what's the weather [like] tomorrow", "what is the weather [like] tomorrow"}, "Forecast" });
+    model->Entities.push_back({ "city", Intent::EntityType::List, Intent::EntityMatchMode::Fuzzy, {"Seattle", "London", "Tokyo"} });
+    matcher->ApplyLanguageModels({ model });
+
+    // The responses must only depend on the intent, the same response for a partial and a final result commits the
+    // speculation.
+    auto respond = [](const TurnIntent& intent) -> std::string
+    {
+        auto city = intent.Entities.find("city");
+        auto where = city == intent.Entities.end() ? std::string() : " in " + city->second;
+        if (intent.IntentId == "Weather")
+        {
+            return "It is sunny" + where + ", with a high of 25 degrees.";
+        }
+        if (intent.IntentId == "Forecast")
+        {
+            return "Tomorrow" + where + " will be cloudy, with a chance of rain in the afternoon.";
+        }
+        return "Sorry, I can only tell you about the weather.";
+    };
+
+    // Synthesizers are connected ahead of the turns, so the connection setup is not in the turn latency.
+    SpeechSynthesizerPool::Options poolOptions;
+    SpeechSynthesizerPool pool([] { return SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion"); }, poolOptions);
+    SpeculativeTurnEngine::Options options;
+    pool.Prewarm(options.Voice, options.OutputFormat);
+
+    const int runs = 5;
+    for (auto speculate : { false, true })
+    {
+        options.Speculate = speculate;
+        LatencyHistogram turnLatency;
+        for (int run = 0; run < runs; run++)
+        {
+            // Replays the recording in real time, as spoken into a microphone. The utterance is timed from the start of the
+            // replay, so the latency is measured from the end of the speech to the first audio of the response.
+            PacedWavFileInput input("whatstheweatherlike.wav", std::chrono::milliseconds(500));
+            // Read by the turn callback on the engine's threads.
+            std::atomic<std::chrono::steady_clock::time_point> inputStart{ std::chrono::steady_clock::time_point() };
+            uint64_t audioBytes = 0;
+
+            SpeculativeTurnEngine engine(config, input.GetAudioConfig(), pool, SpeculativeTurnEngine::MatcherFromIntentRecognizer(matcher),
+                respond,
+                [&audioBytes](size_t turn, const uint8_t* data, size_t size)
+                {
+                    UNUSED(turn);
+                    UNUSED(data);
+                    // Play the audio on your audio device instead.
+                    audioBytes += size;
+                },
+                [&inputStart, &turnLatency](const TurnResult& result)
+                {
+                    std::cout << "TURN " << result.Turn << ": Text=" << result.Intent.Text << ", Intent Id=" << result.Intent.IntentId
+                        << (result.Speculative ? " (speculative)" : "") << std::endl;
+                    if (result.Failed)
+                    {
+                        std::cout << "  Response failed: " << result.ErrorDetails << std::endl;
+                    }
+                    else if (!result.Response.empty())
+                    {
+                        // The unit of the offset and duration is tick (1 tick = 100 nanoseconds).
+                        auto speechEnd = inputStart.load() + std::chrono::microseconds((result.Offset + result.Duration) / 10);
+                        turnLatency.Record(static_cast<uint64_t>(
+                            std::chrono::duration_cast<std::chrono::microseconds>(result.FirstAudioAt - speechEnd).count()));
+                    }
+                },
+                options);
+
+            engine.Start();
+            inputStart.store(std::chrono::steady_clock::now());
+            input.Start();
+            engine.WaitUntilEnded();
+            engine.Stop();
+
+            auto error = engine.GetError();
+            if (!error.empty())
+            {
+                std::cout << "CANCELED: ErrorDetails=" << error << std::endl;
+                std::cout << "CANCELED: Did you update the subscription info?" << std::endl;
+                return;
+            }
+            auto stats = engine.GetStats();
+            std::cout << "  " << audioBytes << " bytes of response audio, " << stats.SpeculationsStarted << " speculations, "
+                << stats.SpeculationsCommitted << " committed, " << stats.SpeculationsDiscarded << " discarded." << std::endl;
+        }
+
+        std::cout << (speculate ? "Pipelined, with speculative synthesis:" : "Sequential:") << std::endl;
+        turnLatency.Print(std::cout, "End of speech to first audio", 1000.0, "ms");
+    }
+}
+
+// Intent matching of transcribed text with a compiled pattern matching model, throughput benchmark.
+void IntentPatternMatchingThroughputBenchmark()
+{
+    // The model of IntentRecognitionWithPatternMatchingAndMicrophone.
+    auto model = PatternMatchingModel::FromModelId("YourPatternMatchingModelId");
+    model->Intents.push_back({ {"[Go | Take me] to [floor|level] {floorName}", "Go to parking [{parkingLevel}]",
+        "Go to floor {floorName:1} [and then go to floor {floorName:2}]", "{floorName}"}, "ChangeFloors" });
+    model->Intents.push_back({ {"{action} the doors", "{action} doors", "{action} the door", "{action} door"}, "DoorControl" });
+    model->Entities.push_back({ "floorName" , Intent::EntityType::List, Intent::EntityMatchMode::Strict, {"ground floor", "lobby", "1st", "first", "one", "1", "2nd", "second", "two", "2"}});
+    model->Entities.push_back({ "parkingLevel" , Intent::EntityType::PrebuiltInteger});
+
+    // Compiles the model once, matching needs no recognizer and no service.
+    CompiledPatternMatcher matcher(*model);
+
+    // Transcripts, e.g. the recognized text of recorded calls. Replace with your own.
+    const std::vector<std::string> transcripts = {
+        "Take me to floor two.", "Go to parking 3.", "Open the doors.", "Go to floor 1st and then go to floor lobby.",
+        "Lobby.", "Close the door, please.", "What time is it?", "Go to level second."
+    };
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < 1000000; i++)
+    {
+        texts.push_back(transcripts[i % transcripts.size()]);
+    }
+
+    for (size_t threads : { size_t(1), size_t(0) })
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto results = matcher.MatchBatch(texts, threads);
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::map<std::string, size_t> counts;
+        for (const auto& result : results)
+        {
+            counts[result.IntentId.empty() ? "(none)" : result.IntentId]++;
+        }
+        std::cout << (threads == 0 ? "All cores" : "1 thread") << ": " << static_cast<uint64_t>(texts.size() / seconds) << " texts per second." << std::endl;
+        for (const auto& count : counts)
+        {
+            std::cout << "  " << count.first << ": " << count.second << std::endl;
+        }
+    }
+
+    for (const auto& transcript : transcripts)
+    {
+        auto result = matcher.Match(transcript);
+        std::cout << "MATCHED: Text=" << transcript << std::endl;
+        std::cout << "  Intent Id: " << (result.IntentId.empty() ? "(none)" : result.IntentId) << std::endl;
+        for (const auto& entity : result.Entities)
+        {
+            std::cout << "  " << entity.first << ": = " << entity.second << std::endl;
+        }
+    }
+}
+
+// Batch evaluation of an intent model over a labelled corpus of texts and audio files.
+void IntentBatchEvaluationWithCorpus()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The model to evaluate, applied to each recognizer the evaluator creates.
+    auto model = PatternMatchingModel::FromModelId("WeatherModel");
+    model->Intents.push_back({ {"what's the weather [like] [in {city}]", "what is the weather [like] [in {city}]"}, "Weather" });
+    model->Intents.push_back({ {"what's the weather [like] tomorrow", "will it rain tomorrow"}, "Forecast" });
+    model->Entities.push_back({ "city", Intent::EntityType::List, Intent::EntityMatchMode::Strict, {"Seattle", "London", "Tokyo"} });
+    std::vector<std::shared_ptr<LanguageUnderstandingModel>> modelCollection;
+    modelCollection.push_back(model);
+
+    // Reads the corpus from intent_corpus.tsv, one item per line, e.g.
+    //   Weather<TAB>What's the weather like in London?<TAB>city=London
+    //   -<TAB>@whatstheweatherlike.wav
+    // Uses a small built-in corpus if the file does not exist.
+    std::vector<IntentCorpusItem> corpus;
+    if (std::ifstream("intent_corpus.tsv").good())
+    {
+        try
+        {
+            corpus = IntentEvaluator::LoadCorpus("intent_corpus.tsv");
+        }
+        catch (const std::invalid_argument& e)
+        {
+            std::cout << "Invalid corpus: " << e.what() << std::endl;
+            return;
+        }
+    }
+    else
+    {
+        corpus.push_back({ "What's the weather like in London?", "", "Weather", { { "city", "London" } } });
+        corpus.push_back({ "What is the weather in Tokyo?", "", "Weather", { { "city", "Tokyo" } } });
+        corpus.push_back({ "What's the weather like tomorrow?", "", "Forecast", {} });
+        corpus.push_back({ "Will it rain tomorrow?", "", "Forecast", {} });
+        corpus.push_back({ "Is it going to be sunny?", "", "Weather", {} });
+        corpus.push_back({ "Play some music.", "", "", {} });
+        corpus.push_back({ "", "whatstheweatherlike.wav", "Weather", {} });
+    }
+
+    IntentEvaluator::Options options;
+    options.MaxConcurrentRecognitions = 8;
+    IntentEvaluator evaluator([config, modelCollection](std::shared_ptr<AudioConfig> audioInput)
+    {
+        auto recognizer = IntentRecognizer::FromConfig(config, audioInput);
+        recognizer->ApplyLanguageModels(modelCollection);
+        return recognizer;
+    }, options);
+
+    // Prints the items the model gets wrong, e.g. to compare two versions of the model.
+    evaluator.Run(corpus, [](const IntentCorpusItem& item, const IntentEvaluationResult& result)
+    {
+        if (result.Failed)
+        {
+            std::cout << "CANCELED: [" << result.Index << "] " << result.ErrorDetails << std::endl;
+        }
+        else if (!result.IntentCorrect || !result.EntitiesCorrect)
+        {
+            std::cout << "MISMATCH: [" << result.Index << "] Text=" << result.RecognizedText << ", expected "
+                << (item.ExpectedIntent.empty() ? IntentEvaluator::NoIntent() : item.ExpectedIntent) << ", got "
+                << (result.IntentId.empty() ? IntentEvaluator::NoIntent() : result.IntentId) << std::endl;
+        }
+    });
+
+    evaluator.PrintReport(std::cout);
+}
@@ -0,0 +1,182 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+// Lock-free latency histogram with log-linear buckets (in the style of HdrHistogram).
+// Each power of two is split into 32 linear sub-buckets, so every recorded value is kept with a relative
+// error of about 3%, from 0 up to the full uint64_t range. Record() may be called from any number of
+// threads concurrently, e.g. from Speech SDK event handlers, without taking a lock.
+class LatencyHistogram final
+{
+public:
+    LatencyHistogram()
+    {
+        Reset();
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    // Records a value, e.g. a latency in microseconds.
+    void Record(uint64_t value)
+    {
+        m_counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+
+        auto min = m_min.load(std::memory_order_relaxed);
+        while (value < min && !m_min.compare_exchange_weak(min, value, std::memory_order_relaxed))
+        {
+        }
+        auto max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t Count() const
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Min() const
+    {
+        return Count() == 0 ? 0 : m_min.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Max() const
+    {
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    double Mean() const
+    {
+        auto count = Count();
+        return count == 0 ? 0.0 : static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count;
+    }
+
+    // Gets the value at the given percentile (0 to 100), e.g. 99.9 for p999.
+    // The result is the midpoint of the bucket that holds the percentile, clamped to the recorded min and max.
+    uint64_t Percentile(double percentile) const
+    {
+        uint64_t total = 0;
+        for (const auto& count : m_counts)
+        {
+            total += count.load(std::memory_order_relaxed);
+        }
+        if (total == 0)
+        {
+            return 0;
+        }
+
+        auto rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+        if (rank < 1)
+        {
+            rank = 1;
+        }
+
+        uint64_t seen = 0;
+        for (size_t index = 0; index < BucketCount; index++)
+        {
+            seen += m_counts[index].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                auto value = BucketMidpoint(index);
+                if (value < Min())
+                {
+                    return Min();
+                }
+                return value > Max() ? Max() : value;
+            }
+        }
+        return Max();
+    }
+
+    void Reset()
+    {
+        for (auto& count : m_counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_min.store(UINT64_MAX, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    // Writes one line with count, mean, p50, p95, p99, p999 and max, dividing all values by 'scale'
+    // (e.g. 1000 to print microseconds as milliseconds).
+    void Print(std::ostream& out, const std::string& name, double scale = 1.0, const std::string& unit = "") const
+    {
+        // The format of the stream is restored, the caller's next numbers are not affected.
+        auto flags = out.flags();
+        auto precision = out.precision();
+        out << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+            << " count=" << Count()
+            << " mean=" << Mean() / scale << unit
+            << " p50=" << Percentile(50) / scale << unit
+            << " p95=" << Percentile(95) / scale << unit
+            << " p99=" << Percentile(99) / scale << unit
+            << " p999=" << Percentile(99.9) / scale << unit
+            << " max=" << Max() / scale << unit << "\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    static constexpr unsigned SubBucketBits = 5;
+    static constexpr uint64_t SubBucketCount = 1ULL << SubBucketBits;
+    // Values below 2 * SubBucketCount get a bucket each, each further power of two gets SubBucketCount buckets.
+    static constexpr size_t BucketCount = static_cast<size_t>(2 * SubBucketCount + (64 - SubBucketBits - 1) * SubBucketCount);
+
+    static unsigned MostSignificantBit(uint64_t value)
+    {
+        unsigned bit = 0;
+        for (unsigned step = 32; step > 0; step /= 2)
+        {
+            if (value >> step)
+            {
+                value >>= step;
+                bit += step;
+            }
+        }
+        return bit;
+    }
+
+    static size_t BucketIndex(uint64_t value)
+    {
+        if (value < 2 * SubBucketCount)
+        {
+            return static_cast<size_t>(value);
+        }
+        auto shift = MostSignificantBit(value) - SubBucketBits;
+        auto top = value >> shift; // in [SubBucketCount, 2 * SubBucketCount)
+        return static_cast<size_t>(2 * SubBucketCount + (shift - 1) * SubBucketCount + (top - SubBucketCount));
+    }
+
+    static uint64_t BucketMidpoint(size_t index)
+    {
+        if (index < 2 * SubBucketCount)
+        {
+            return index;
+        }
+        auto shift = (index - 2 * SubBucketCount) / SubBucketCount + 1;
+        auto top = (index - 2 * SubBucketCount) % SubBucketCount + SubBucketCount;
+        return (top << shift) + ((1ULL << shift) >> 1);
+    }
+
+    std::array<std::atomic<uint64_t>, BucketCount> m_counts;
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+};
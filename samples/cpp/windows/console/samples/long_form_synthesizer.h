@@ -0,0 +1,484 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "segmented_audio_buffer.h"
+#include "synthesis_output_format.h"
+
+// A piece of a long text or SSML document, synthesized on its own.
+struct SynthesisSegment
+{
+    std::string Content;
+    // Added to the text offsets of the segment's word boundaries, to get offsets in the whole document.
+    int64_t TextShift = 0;
+};
+
+// A word boundary of a long-form synthesis, with offsets in the whole document and the whole audio.
+struct LongFormWordBoundary
+{
+    uint64_t AudioOffset = 0;   // in ticks.
+    uint64_t Duration = 0;      // in ticks.
+    uint32_t TextOffset = 0;
+    uint32_t WordLength = 0;
+    std::string Text;
+    size_t Segment = 0;
+};
+
+// Splits a document at sentence boundaries, and merges consecutive sentences up to a maximum length.
+class SynthesisSegmenter final
+{
+public:
+    // Splits after '.', '!' or '?' followed by whitespace, and at line breaks. A longer sentence is kept whole.
+    static std::vector<SynthesisSegment> SplitText(const std::string& text, size_t maxLength)
+    {
+        std::vector<std::pair<size_t, size_t>> sentences;
+        size_t start = 0;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            auto c = text[i];
+            auto next = i + 1 < text.size() ? text[i + 1] : ' ';
+            if (c == '\n' || ((c == '.' || c == '!' || c == '?') && IsSpace(next)))
+            {
+                sentences.emplace_back(start, i + 1);
+                start = i + 1;
+            }
+        }
+        sentences.emplace_back(start, text.size());
+
+        std::vector<SynthesisSegment> segments;
+        size_t begin = std::string::npos, end = 0;
+        for (const auto& sentence : sentences)
+        {
+            // Leading and trailing whitespace of the sentence is not part of any segment.
+            auto first = sentence.first, last = sentence.second;
+            while (first < last && IsSpace(text[first])) first++;
+            while (last > first && IsSpace(text[last - 1])) last--;
+            if (first == last)
+            {
+                continue;
+            }
+            if (begin != std::string::npos && last - begin > maxLength)
+            {
+                segments.push_back(SynthesisSegment{ text.substr(begin, end - begin), static_cast<int64_t>(begin) });
+                begin = std::string::npos;
+            }
+            if (begin == std::string::npos)
+            {
+                begin = first;
+            }
+            end = last;
+        }
+        if (begin != std::string::npos)
+        {
+            segments.push_back(SynthesisSegment{ text.substr(begin, end - begin), static_cast<int64_t>(begin) });
+        }
+        return segments;
+    }
+
+    // Splits the content of the <voice> element (or of <speak> without one) after its top-level <p> and <s> elements,
+    // and wraps each segment in the same <speak> and <voice> tags. SSML with several <voice> elements is not split.
+    static std::vector<SynthesisSegment> SplitSsml(const std::string& ssml, size_t maxLength)
+    {
+        std::vector<SynthesisSegment> whole{ SynthesisSegment{ ssml, 0 } };
+
+        auto voice = ssml.find("<voice");
+        auto open = voice != std::string::npos ? voice : ssml.find("<speak");
+        auto bodyBegin = open != std::string::npos ? ssml.find('>', open) : std::string::npos;
+        auto bodyEnd = ssml.rfind(voice != std::string::npos ? "</voice>" : "</speak>");
+        if (bodyBegin == std::string::npos || bodyEnd == std::string::npos || bodyEnd <= bodyBegin ||
+            (voice != std::string::npos && ssml.find("<voice", voice + 1) != std::string::npos))
+        {
+            return whole;
+        }
+        bodyBegin++;
+        auto prefix = ssml.substr(0, bodyBegin);
+        auto suffix = ssml.substr(bodyEnd);
+
+        // The split points are after the closing tags of <p> and <s> elements at the top level of the body.
+        std::vector<size_t> splits;
+        int depth = 0;
+        for (auto position = ssml.find('<', bodyBegin); position != std::string::npos && position < bodyEnd; position = ssml.find('<', position + 1))
+        {
+            auto close = ssml.find('>', position);
+            if (close == std::string::npos || close >= bodyEnd)
+            {
+                return whole;
+            }
+            if (ssml[position + 1] == '/')
+            {
+                depth--;
+                auto name = ssml.substr(position + 2, close - position - 2);
+                if (depth == 0 && (name == "p" || name == "s"))
+                {
+                    splits.push_back(close + 1);
+                }
+            }
+            else if (ssml[close - 1] != '/' && ssml[position + 1] != '!' && ssml[position + 1] != '?')
+            {
+                depth++;
+            }
+            position = close;
+        }
+        if (depth != 0)
+        {
+            return whole;
+        }
+        splits.push_back(bodyEnd);
+
+        std::vector<SynthesisSegment> segments;
+        size_t begin = bodyBegin, end = bodyBegin;
+        for (auto split : splits)
+        {
+            if (end > begin && split - begin > maxLength)
+            {
+                segments.push_back(Wrap(ssml, prefix, suffix, begin, end));
+                begin = end;
+            }
+            end = split;
+        }
+        if (end > begin)
+        {
+            segments.push_back(Wrap(ssml, prefix, suffix, begin, end));
+        }
+        return segments.empty() ? whole : segments;
+    }
+
+private:
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static SynthesisSegment Wrap(const std::string& ssml, const std::string& prefix, const std::string& suffix, size_t begin, size_t end)
+    {
+        return SynthesisSegment{ prefix + ssml.substr(begin, end - begin) + suffix, static_cast<int64_t>(begin) - static_cast<int64_t>(prefix.size()) };
+    }
+};
+
+// Synthesizes long documents (e.g. a book chapter) faster than real time: the document is split at sentence or SSML
+// boundaries, and the segments are synthesized concurrently, each on one of a set of synthesizers, earliest first.
+// The audio is reassembled in order and passed to the audio callback as it comes: the first segment is streamed as soon
+// as it is synthesized, while the next ones keep rendering, so playback can start before the end of the synthesis.
+// Word boundaries are passed in order too, with their audio and text offsets rebased on the whole document.
+// The output format must be a raw format without header (PCM, mu-law or A-law), so the audio of the segments can be concatenated.
+class LongFormSynthesizer final
+{
+public:
+    struct Options
+    {
+        size_t Concurrency = 4;
+        size_t MaxSegmentLength = 400;
+        // A raw PCM, mu-law or A-law format, see RawSynthesisBytesPerSecond().
+        Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat OutputFormat = Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm;
+    };
+
+    struct Result
+    {
+        size_t Segments = 0;
+        size_t FailedSegments = 0;
+        uint64_t AudioSize = 0;
+        // Of the first failed segment. Its audio is missing from the output, from where it failed, the other segments are not affected.
+        std::string ErrorDetails;
+        std::chrono::milliseconds TimeToFirstAudio{ 0 };
+        std::chrono::milliseconds Duration{ 0 };
+    };
+
+    // Called on the thread of SpeakText() or SpeakSsml(), in order.
+    using AudioCallback = std::function<void(const uint8_t* data, size_t size)>;
+    using WordBoundaryCallback = std::function<void(const LongFormWordBoundary& boundary)>;
+
+    // Sets the output format of 'config', and creates the synthesizers, which are reused by all syntheses.
+    LongFormSynthesizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, Options options)
+        : m_options(options), m_bytesPerSecond(RawSynthesisBytesPerSecond(options.OutputFormat))
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (!config || m_options.Concurrency == 0)
+        {
+            throw std::invalid_argument("Invalid config or concurrency");
+        }
+        if (m_bytesPerSecond == 0)
+        {
+            throw std::invalid_argument("The output format must be a raw format without header, so the audio of the segments can be concatenated");
+        }
+        config->SetSpeechSynthesisOutputFormat(m_options.OutputFormat);
+
+        for (size_t i = 0; i < m_options.Concurrency; i++)
+        {
+            auto slot = std::make_shared<Slot>();
+            slot->Synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+            // The audio is taken from the events rather than from the result, so it can be streamed before the segment is done.
+            auto raw = slot.get();
+            slot->Synthesizer->Synthesizing += [this, raw](const SpeechSynthesisEventArgs& e)
+            {
+                auto audio = e.Result->GetAudioData();
+                if (audio && !audio->empty())
+                {
+                    OnAudio(raw, audio->data(), audio->size());
+                }
+            };
+            slot->Synthesizer->WordBoundary += [this, raw](const SpeechSynthesisWordBoundaryEventArgs& e)
+            {
+                LongFormWordBoundary boundary;
+                boundary.AudioOffset = e.AudioOffset;
+                boundary.Duration = e.Duration;
+                boundary.TextOffset = e.TextOffset;
+                boundary.WordLength = e.WordLength;
+                boundary.Text = e.Text;
+                OnWordBoundary(raw, std::move(boundary));
+            };
+            m_slots.push_back(slot);
+        }
+    }
+
+    LongFormSynthesizer(const LongFormSynthesizer&) = delete;
+    LongFormSynthesizer& operator=(const LongFormSynthesizer&) = delete;
+
+    Result SpeakText(const std::string& text, AudioCallback onAudio, WordBoundaryCallback onWordBoundary = nullptr)
+    {
+        return Speak(SynthesisSegmenter::SplitText(text, m_options.MaxSegmentLength), false, std::move(onAudio), std::move(onWordBoundary));
+    }
+
+    Result SpeakSsml(const std::string& ssml, AudioCallback onAudio, WordBoundaryCallback onWordBoundary = nullptr)
+    {
+        return Speak(SynthesisSegmenter::SplitSsml(ssml, m_options.MaxSegmentLength), true, std::move(onAudio), std::move(onWordBoundary));
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Joins the workers of a synthesis, also when a callback throws: the segments not taken yet are dropped first.
+    struct Workers
+    {
+        explicit Workers(LongFormSynthesizer* owner) : Owner(owner) {}
+
+        Workers(const Workers&) = delete;
+        Workers& operator=(const Workers&) = delete;
+
+        ~Workers()
+        {
+            Join();
+        }
+
+        void Join()
+        {
+            {
+                std::lock_guard<std::mutex> lock(Owner->m_mutex);
+                Owner->m_nextSegment = Owner->m_segments.size();
+            }
+            for (auto& thread : Threads)
+            {
+                if (thread.joinable())
+                {
+                    thread.join();
+                }
+            }
+        }
+
+        LongFormSynthesizer* Owner;
+        std::vector<std::thread> Threads;
+    };
+
+    struct SegmentState
+    {
+        SynthesisSegment Segment;
+        SegmentedAudioBuffer Audio;
+        std::vector<LongFormWordBoundary> Boundaries;
+        bool Done = false;
+        bool Failed = false;
+        std::string ErrorDetails;
+    };
+
+    struct Slot
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> Synthesizer;
+        SegmentState* Current = nullptr;
+    };
+
+    void OnAudio(Slot* slot, const uint8_t* data, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (slot->Current == nullptr)
+            {
+                return;
+            }
+            slot->Current->Audio.Append(data, size);
+        }
+        m_changed.notify_all();
+    }
+
+    void OnWordBoundary(Slot* slot, LongFormWordBoundary boundary)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (slot->Current == nullptr)
+            {
+                return;
+            }
+            slot->Current->Boundaries.push_back(std::move(boundary));
+        }
+        m_changed.notify_all();
+    }
+
+    // Synthesizes the segments one after the other, taking the earliest one not taken yet.
+    void Work(Slot* slot, bool ssml)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        while (true)
+        {
+            SegmentState* segment;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_nextSegment == m_segments.size())
+                {
+                    return;
+                }
+                segment = m_segments[m_nextSegment++].get();
+                slot->Current = segment;
+            }
+
+            std::shared_ptr<SpeechSynthesisResult> result;
+            std::string error;
+            try
+            {
+                result = ssml ? slot->Synthesizer->SpeakSsmlAsync(segment->Segment.Content).get() : slot->Synthesizer->SpeakTextAsync(segment->Segment.Content).get();
+            }
+            catch (const std::exception& e)
+            {
+                error = e.what();
+            }
+            if (result && result->Reason == ResultReason::Canceled)
+            {
+                auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+                error = cancellation ? cancellation->ErrorDetails : "Canceled";
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                slot->Current = nullptr;
+                segment->Done = true;
+                segment->Failed = !result || result->Reason != ResultReason::SynthesizingAudioCompleted;
+                segment->ErrorDetails = error;
+            }
+            m_changed.notify_all();
+        }
+    }
+
+    Result Speak(std::vector<SynthesisSegment> segments, bool ssml, AudioCallback onAudio, WordBoundaryCallback onWordBoundary)
+    {
+        // Only one synthesis at a time uses the synthesizers.
+        std::lock_guard<std::mutex> speakLock(m_speakMutex);
+        Result result;
+        auto start = Clock::now();
+        result.Segments = segments.size();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_segments.clear();
+            for (auto& segment : segments)
+            {
+                auto state = std::make_unique<SegmentState>();
+                state->Segment = std::move(segment);
+                m_segments.push_back(std::move(state));
+            }
+            m_nextSegment = 0;
+        }
+
+        Workers workers(this);
+        for (size_t i = 0; i < std::min(m_slots.size(), m_segments.size()); i++)
+        {
+            workers.Threads.emplace_back(&LongFormSynthesizer::Work, this, m_slots[i].get(), ssml);
+        }
+
+        // Passes the audio and the word boundaries of the segments in order, each as soon as the previous one is done.
+        std::vector<uint8_t> audio;
+        std::vector<LongFormWordBoundary> boundaries;
+        uint64_t audioBase = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (size_t index = 0; index < m_segments.size(); index++)
+        {
+            auto& segment = *m_segments[index];
+            size_t audioForwarded = 0, boundariesForwarded = 0;
+            while (true)
+            {
+                m_changed.wait(lock, [&] { return segment.Done || segment.Audio.Size() > audioForwarded || segment.Boundaries.size() > boundariesForwarded; });
+                auto done = segment.Done;
+
+                audio.resize(segment.Audio.Size() - audioForwarded);
+                segment.Audio.CopyTo(audioForwarded, audio.data(), audio.size());
+                audioForwarded += audio.size();
+                boundaries.assign(segment.Boundaries.begin() + boundariesForwarded, segment.Boundaries.end());
+                boundariesForwarded += boundaries.size();
+                if (done && segment.Failed)
+                {
+                    result.FailedSegments++;
+                    if (result.ErrorDetails.empty())
+                    {
+                        result.ErrorDetails = segment.ErrorDetails;
+                    }
+                }
+
+                lock.unlock();
+                for (auto& boundary : boundaries)
+                {
+                    boundary.AudioOffset += audioBase * 10000000 / m_bytesPerSecond;
+                    boundary.TextOffset = static_cast<uint32_t>(boundary.TextOffset + segment.Segment.TextShift);
+                    boundary.Segment = index;
+                    if (onWordBoundary)
+                    {
+                        onWordBoundary(boundary);
+                    }
+                }
+                if (!audio.empty())
+                {
+                    if (result.AudioSize == 0)
+                    {
+                        result.TimeToFirstAudio = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+                    }
+                    result.AudioSize += audio.size();
+                    onAudio(audio.data(), audio.size());
+                }
+                lock.lock();
+
+                if (done)
+                {
+                    audioBase += audioForwarded;
+                    // The audio was passed on, it is not needed anymore.
+                    segment.Audio.Clear();
+                    break;
+                }
+            }
+        }
+        lock.unlock();
+
+        workers.Join();
+        result.Duration = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        return result;
+    }
+
+    const Options m_options;
+    const uint32_t m_bytesPerSecond;
+    std::vector<std::shared_ptr<Slot>> m_slots;
+
+    std::mutex m_speakMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<std::unique_ptr<SegmentState>> m_segments;
+    size_t m_nextSegment = 0;
+};
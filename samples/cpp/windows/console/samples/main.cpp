@@ -21,11 +21,25 @@ extern void SpeechRecognitionFromMicrophoneWithMASEnabledAndPresetGeometrySpecif
 extern void SpeechContinuousRecognitionFromMultiChannelFileWithMASEnabledAndCustomGeometrySpecified();
 extern void SpeechRecognitionFromPullStreamWithSelectMASEnhancementsEnabled();
 extern void SpeechContinuousRecognitionFromPushStreamWithMASEnabledAndBeamformingAnglesSpecified();
+extern void SpeechContinuousRecognitionWithLatencyInstrumentation();
+extern void SpeechBatchTranscriptionWithFiles();
+extern void SpeechBatchSchedulingSimulation();
+extern void SpeechRecognitionWithPrewarmedRecognizerPool();
+extern void SpeechContinuousRecognitionWithCoroutines();
+extern void SpeechContinuousRecognitionWithResultSink();
+extern void SpeechContinuousRecognitionWithTranscriptRecords();
+extern void SpeechContinuousRecognitionWithSessionDriver();
+extern void SpeechContinuousRecognitionWithRotatingSessions();
+extern void SpeechContinuousRecognitionWithReconnectingPushStream();
+extern void SpeechRecognitionWithMultiChannelSplit();
 
 extern void IntentRecognitionWithMicrophone();
 extern void IntentRecognitionWithPatternMatchingAndMicrophone();
 extern void IntentRecognitionWithLanguage();
 extern void IntentContinuousRecognitionWithFile();
+extern void IntentTurnLatencyBenchmarkWithFile();
+extern void IntentPatternMatchingThroughputBenchmark();
+extern void IntentBatchEvaluationWithCorpus();
 
 extern void TranslationWithMicrophone();
 extern void TranslationContinuousRecognition();
@@ -46,6 +60,13 @@ extern void SpeechSynthesisUsingCustomVoice();
 extern void SpeechSynthesisGetAvailableVoices();
 extern void SpeechSynthesisVisemeEvent();
 extern void SpeechSynthesisBookmarkEvent();
+extern void SpeechSynthesisLatencyInstrumentation();
+extern void SpeechSynthesisWithAudioCache();
+extern void SpeechSynthesisLongFormParallel();
+extern void SpeechSynthesisPoolLoadBenchmark();
+extern void SpeechSynthesisEventTimeline();
+extern void SpeechSynthesisGetAvailableVoicesCached();
+extern void SpeechSynthesisWithBargeIn();
 
 extern void ConversationWithPullAudioStream();
 extern void ConversationWithPushAudioStream();
@@ -55,6 +76,7 @@ extern void SpeakerVerificationWithMicrophone();
 extern void SpeakerVerificationWithPushStream();
 extern void SpeakerIdentificationWithPullStream();
 extern void SpeakerIdentificationWithMicrophone();
+extern void SpeakerBulkEnrollmentWithJournal();
 
 // Language Id related tests
 extern void SpeechRecognitionAndLanguageIdWithMicrophone();
@@ -97,6 +119,17 @@ void SpeechSamples()
                 "    Microsoft Audio Stack enabled.\n";
         cout << "d.) Speech recognition from push stream with Microsoft Audio Stack enabled and\n"
                 "    beam-forming angles specified.\n";
+        cout << "e.) Speech continuous recognition with latency instrumentation.\n";
+        cout << "f.) Speech batch transcription of files with bounded concurrency.\n";
+        cout << "g.) Speech batch scheduling simulation of mixed-length files.\n";
+        cout << "h.) Speech recognition with prewarmed recognizer pools per language.\n";
+        cout << "i.) Speech continuous recognition of many files with C++20 coroutines.\n";
+        cout << "j.) Speech continuous recognition with results written by asynchronous sinks.\n";
+        cout << "k.) Speech continuous recognition with results stored as binary transcript records.\n";
+        cout << "l.) Speech continuous recognition of many sessions with a reusable session driver.\n";
+        cout << "m.) Speech continuous recognition of a long running feed with rotating sessions.\n";
+        cout << "n.) Speech continuous recognition from a push stream, reconnecting with audio replay after errors.\n";
+        cout << "o.) Speech recognition of a stereo call recording, one speaker per channel.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -148,6 +181,50 @@ void SpeechSamples()
         case 'd':
             SpeechContinuousRecognitionFromPushStreamWithMASEnabledAndBeamformingAnglesSpecified();
             break;
+        case 'E':
+        case 'e':
+            SpeechContinuousRecognitionWithLatencyInstrumentation();
+            break;
+        case 'F':
+        case 'f':
+            SpeechBatchTranscriptionWithFiles();
+            break;
+        case 'G':
+        case 'g':
+            SpeechBatchSchedulingSimulation();
+            break;
+        case 'H':
+        case 'h':
+            SpeechRecognitionWithPrewarmedRecognizerPool();
+            break;
+        case 'I':
+        case 'i':
+            SpeechContinuousRecognitionWithCoroutines();
+            break;
+        case 'J':
+        case 'j':
+            SpeechContinuousRecognitionWithResultSink();
+            break;
+        case 'K':
+        case 'k':
+            SpeechContinuousRecognitionWithTranscriptRecords();
+            break;
+        case 'L':
+        case 'l':
+            SpeechContinuousRecognitionWithSessionDriver();
+            break;
+        case 'M':
+        case 'm':
+            SpeechContinuousRecognitionWithRotatingSessions();
+            break;
+        case 'N':
+        case 'n':
+            SpeechContinuousRecognitionWithReconnectingPushStream();
+            break;
+        case 'O':
+        case 'o':
+            SpeechRecognitionWithMultiChannelSplit();
+            break;
         case '0':
             break;
         }
@@ -192,6 +269,9 @@ void IntentSamples()
         cout << "2.) Intent recognition in the specified language.\n";
         cout << "3.) Intent continuous recognition with file input.\n";
         cout << "4.) Intent recognition from default microphone and pattern matching.\n";
+        cout << "5.) Turn latency with speculative synthesis, replaying a file.\n";
+        cout << "6.) Compiled pattern matching throughput over text.\n";
+        cout << "7.) Intent model evaluation over a labelled corpus.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -212,6 +292,15 @@ void IntentSamples()
         case '4':
             IntentRecognitionWithPatternMatchingAndMicrophone();
             break;
+        case '5':
+            IntentTurnLatencyBenchmarkWithFile();
+            break;
+        case '6':
+            IntentPatternMatchingThroughputBenchmark();
+            break;
+        case '7':
+            IntentBatchEvaluationWithCorpus();
+            break;
         case '0':
             break;
         }
@@ -276,6 +365,13 @@ void SpeechSynthesisSamples()
         cout << "E.) Speech synthesis get available voices\n";
         cout << "F.) Speech synthesis viseme event.\n";
         cout << "G.) Speech synthesis bookmark event.\n";
+        cout << "H.) Speech synthesis latency instrumentation.\n";
+        cout << "I.) Speech synthesis with a memory and disk audio cache.\n";
+        cout << "J.) Speech synthesis of a long text with sentences synthesized in parallel.\n";
+        cout << "K.) Load benchmark of the time to first byte with prewarmed synthesizers.\n";
+        cout << "L.) Speech synthesis with a word boundary, viseme and bookmark timeline.\n";
+        cout << "M.) Get available voices from a cached voice catalogue.\n";
+        cout << "N.) Full-duplex voice loop with barge-in, using file-backed audio.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -339,6 +435,34 @@ void SpeechSynthesisSamples()
         case 'g':
             SpeechSynthesisBookmarkEvent();
             break;
+        case 'H':
+        case 'h':
+            SpeechSynthesisLatencyInstrumentation();
+            break;
+        case 'I':
+        case 'i':
+            SpeechSynthesisWithAudioCache();
+            break;
+        case 'J':
+        case 'j':
+            SpeechSynthesisLongFormParallel();
+            break;
+        case 'K':
+        case 'k':
+            SpeechSynthesisPoolLoadBenchmark();
+            break;
+        case 'L':
+        case 'l':
+            SpeechSynthesisEventTimeline();
+            break;
+        case 'M':
+        case 'm':
+            SpeechSynthesisGetAvailableVoicesCached();
+            break;
+        case 'N':
+        case 'n':
+            SpeechSynthesisWithBargeIn();
+            break;
         case '0':
             break;
         }
@@ -387,6 +511,7 @@ void SpeakerRecognitionSamples()
         cout << "2.) Speaker verification with push audio stream input.\n";
         cout << "3.) Speaker identification with pull audio stream input.\n";
         cout << "4.) Speaker identification with microphone input.\n";
+        cout << "5.) Bulk voice profile enrollment with a journal.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -411,6 +536,10 @@ void SpeakerRecognitionSamples()
             SpeakerIdentificationWithMicrophone();
             break;
 
+        case '5':
+            SpeakerBulkEnrollmentWithJournal();
+            break;
+
         case '0':
             break;
         }
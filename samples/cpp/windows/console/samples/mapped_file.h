@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A file mapped read-only into memory, for the lifetime of the object. Empty files cannot be mapped.
+class MappedFile final
+{
+public:
+    explicit MappedFile(const std::string& fileName)
+    {
+        Map(fileName);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Unmap();
+    }
+
+    const uint8_t* Data() const
+    {
+        return m_view;
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+#ifdef _WIN32
+    void Map(const std::string& fileName)
+    {
+        m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        {
+            Unmap();
+            throw std::runtime_error("Failed to open " + fileName + ".");
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_view = m_mapping != nullptr ? static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (m_view == nullptr)
+        {
+            Unmap();
+            throw std::runtime_error("Failed to map " + fileName + ".");
+        }
+    }
+
+    void Unmap()
+    {
+        if (m_view != nullptr)
+        {
+            UnmapViewOfFile(m_view);
+            m_view = nullptr;
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    void Map(const std::string& fileName)
+    {
+        m_file = open(fileName.c_str(), O_RDONLY);
+        struct stat status;
+        if (m_file < 0 || fstat(m_file, &status) != 0 || status.st_size == 0)
+        {
+            Unmap();
+            throw std::runtime_error("Failed to open " + fileName + ".");
+        }
+        m_size = static_cast<size_t>(status.st_size);
+        auto view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+        if (view == MAP_FAILED)
+        {
+            Unmap();
+            throw std::runtime_error("Failed to map " + fileName + ".");
+        }
+        m_view = static_cast<const uint8_t*>(view);
+    }
+
+    void Unmap()
+    {
+        if (m_view != nullptr)
+        {
+            munmap(const_cast<uint8_t*>(m_view), m_size);
+            m_view = nullptr;
+        }
+        if (m_file >= 0)
+        {
+            close(m_file);
+            m_file = -1;
+        }
+    }
+
+    int m_file = -1;
+#endif
+    const uint8_t* m_view = nullptr;
+    size_t m_size = 0;
+};
@@ -0,0 +1,174 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+#include "recognition_session_driver.h"
+
+// A result of one channel of a multi-channel recording.
+struct ChannelRecognitionResult
+{
+    size_t Channel = 0;
+    std::string Speaker;
+    std::string Text;
+    uint64_t Offset = 0;        // in ticks since the start of the recording.
+    uint64_t Duration = 0;      // in ticks.
+};
+
+// Splits interleaved PCM frames into one buffer per channel. The buffers are resized, their capacity is reused.
+inline void DeinterleaveChannels(const uint8_t* frames, size_t size, size_t channels, size_t bytesPerSample, std::vector<std::vector<uint8_t>>& output)
+{
+    auto frameSize = channels * bytesPerSample;
+    auto frameCount = size / frameSize;
+    output.resize(channels);
+    for (size_t channel = 0; channel < channels; channel++)
+    {
+        auto& samples = output[channel];
+        samples.resize(frameCount * bytesPerSample);
+        auto source = frames + channel * bytesPerSample;
+        auto target = samples.data();
+        for (size_t frame = 0; frame < frameCount; frame++, source += frameSize, target += bytesPerSample)
+        {
+            std::copy(source, source + bytesPerSample, target);
+        }
+    }
+}
+
+// Recognizes each channel of a multi-channel WAV file (e.g. agent and customer of a stereo call recording) as its own
+// speaker: the file is read once, its frames are split into one mono push stream per channel, and the channels are
+// recognized concurrently. The results are merged into one timeline, ordered by offset, labelled with the speaker.
+class MultiChannelRecognizer final
+{
+public:
+    // Called as the results come, from the SDK's threads, one result at a time, in offset order per channel only.
+    using ResultCallback = std::function<void(const ChannelRecognitionResult& result)>;
+
+    // 'speakers' labels the channels in order, the channels without a label are labelled "Channel <n>".
+    MultiChannelRecognizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, std::vector<std::string> speakers = {},
+                           ResultCallback onResult = nullptr)
+        : m_config(std::move(config)), m_speakers(std::move(speakers)), m_onResult(std::move(onResult))
+    {
+    }
+
+    MultiChannelRecognizer(const MultiChannelRecognizer&) = delete;
+    MultiChannelRecognizer& operator=(const MultiChannelRecognizer&) = delete;
+
+    // Recognizes the file, and returns the results of all channels ordered by offset.
+    // The outcome of the session of each channel is returned in 'outcomes', if given.
+    std::vector<ChannelRecognitionResult> Recognize(const std::string& fileName, std::vector<RecognitionSessionResult>* outcomes = nullptr)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        WavFileReader reader(fileName);
+        size_t channels = reader.GetChannels();
+        size_t bytesPerSample = reader.GetBitsPerSample() / 8;
+        if (channels == 0 || bytesPerSample == 0 || reader.GetBitsPerSample() % 8 != 0)
+        {
+            throw std::invalid_argument("Unsupported audio format.");
+        }
+
+        auto format = AudioStreamFormat::GetWaveFormatPCM(reader.GetSamplesPerSecond(), static_cast<uint8_t>(reader.GetBitsPerSample()), 1);
+        std::mutex mutex;
+        std::vector<std::vector<ChannelRecognitionResult>> results(channels);
+        std::vector<std::shared_ptr<PushAudioInputStream>> streams;
+        std::vector<std::unique_ptr<SpeechRecognitionSessionDriver>> drivers;
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            auto speaker = channel < m_speakers.size() ? m_speakers[channel] : "Channel " + std::to_string(channel);
+            auto stream = AudioInputStream::CreatePushStream(format);
+            auto driver = std::make_unique<SpeechRecognitionSessionDriver>([this, channel, speaker, &mutex, &results](const SpeechRecognitionEventArgs& e)
+            {
+                if (e.Result->Reason != ResultReason::RecognizedSpeech)
+                {
+                    return;
+                }
+                ChannelRecognitionResult result;
+                result.Channel = channel;
+                result.Speaker = speaker;
+                result.Text = e.Result->Text;
+                result.Offset = e.Result->Offset();
+                result.Duration = e.Result->Duration();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                results[channel].push_back(result);
+                if (m_onResult)
+                {
+                    m_onResult(result);
+                }
+            });
+            driver->Attach(SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(stream)));
+            streams.push_back(stream);
+            drivers.push_back(std::move(driver));
+        }
+
+        // Each session runs on its own thread, until the end of its stream.
+        std::vector<RecognitionSessionResult> sessions(channels);
+        std::vector<std::thread> threads;
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            threads.emplace_back([&drivers, &sessions, channel] { sessions[channel] = drivers[channel]->Run(); });
+        }
+
+        // Reads the file once, 100ms of frames at a time, and splits them to the streams.
+        auto frameSize = channels * bytesPerSample;
+        std::vector<uint8_t> frames(frameSize * std::max<size_t>(reader.GetSamplesPerSecond() / 10, 1));
+        std::vector<std::vector<uint8_t>> samples;
+        int readBytes = 0;
+        while ((readBytes = reader.Read(frames.data(), static_cast<uint32_t>(frames.size()))) > 0)
+        {
+            DeinterleaveChannels(frames.data(), static_cast<size_t>(readBytes), channels, bytesPerSample, samples);
+            for (size_t channel = 0; channel < channels; channel++)
+            {
+                if (!samples[channel].empty())
+                {
+                    streams[channel]->Write(samples[channel].data(), static_cast<uint32_t>(samples[channel].size()));
+                }
+            }
+        }
+        for (auto& stream : streams)
+        {
+            stream->Close();
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        for (auto& driver : drivers)
+        {
+            driver->Detach();
+        }
+        if (outcomes)
+        {
+            *outcomes = sessions;
+        }
+
+        // Each channel's results are in offset order already, so merging keeps the channel order for equal offsets.
+        std::vector<ChannelRecognitionResult> timeline;
+        for (auto& channelResults : results)
+        {
+            auto middle = timeline.size();
+            timeline.insert(timeline.end(), channelResults.begin(), channelResults.end());
+            std::inplace_merge(timeline.begin(), timeline.begin() + middle, timeline.end(),
+                               [](const ChannelRecognitionResult& a, const ChannelRecognitionResult& b) { return a.Offset < b.Offset; });
+        }
+        return timeline;
+    }
+
+private:
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    std::vector<std::string> m_speakers;
+    ResultCallback m_onResult;
+};
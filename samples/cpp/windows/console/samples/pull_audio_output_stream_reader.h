@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Drains a pull audio output stream on a dedicated thread while synthesis is still running,
+// and forwards every chunk to a sink (file, socket, player, ...).
+// It also measures the time from the start of each synthesis request to its first audio byte.
+class PullAudioOutputStreamReader final
+{
+public:
+    using Sink = std::function<void(const uint8_t* data, uint32_t size)>;
+    using Clock = std::chrono::steady_clock;
+
+    PullAudioOutputStreamReader(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioOutputStream> stream, Sink sink, uint32_t chunkSize = 3200)
+        : m_stream(std::move(stream)), m_sink(std::move(sink)), m_chunkSize(chunkSize)
+    {
+        if (!m_stream)
+        {
+            throw std::invalid_argument("Stream is null");
+        }
+        m_thread = std::thread(&PullAudioOutputStreamReader::ReadLoop, this);
+    }
+
+    PullAudioOutputStreamReader(const PullAudioOutputStreamReader&) = delete;
+    PullAudioOutputStreamReader& operator=(const PullAudioOutputStreamReader&) = delete;
+
+    ~PullAudioOutputStreamReader()
+    {
+        Join();
+    }
+
+    // Marks the start of a synthesis request. Call it right before SpeakTextAsync(), after the previous request has completed.
+    void MarkRequestStart()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requestStart = Clock::now();
+        m_requestPending = true;
+        m_requestOffset = m_writtenSize;
+    }
+
+    // Marks the end of a synthesis request, with the size of the audio it wrote to the stream, i.e. GetAudioLength() of its result.
+    // The stream may still hold audio of a completed request, only bytes past the audio of all completed requests
+    // count as the first byte of the next one.
+    void MarkRequestEnd(uint64_t audioSize)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writtenSize += audioSize;
+    }
+
+    // Waits until the first audio byte of the current request was read, or the timeout expires.
+    // Returns true and sets 'timeToFirstByte' if the first byte was read.
+    bool WaitForFirstByte(std::chrono::milliseconds timeout, std::chrono::microseconds& timeToFirstByte)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_firstByteCondition.wait_for(lock, timeout, [this] { return !m_requestPending || m_finished; }) || m_requestPending)
+        {
+            return false;
+        }
+        timeToFirstByte = m_timesToFirstByte.back();
+        return true;
+    }
+
+    // Gets the time to first byte of all requests measured so far.
+    std::vector<std::chrono::microseconds> GetTimesToFirstByte()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_timesToFirstByte;
+    }
+
+    // Gets the number of bytes forwarded to the sink so far.
+    uint64_t GetTotalSize() const
+    {
+        return m_totalSize;
+    }
+
+    // Waits until the stream is closed, i.e. until the synthesizer that writes to the stream has been destroyed.
+    void Join()
+    {
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+private:
+    void ReadLoop()
+    {
+        std::vector<uint8_t> buffer(m_chunkSize);
+        uint32_t filledSize = 0;
+
+        // Read() blocks until data is available, and returns 0 once the stream is closed.
+        while ((filledSize = m_stream->Read(buffer.data(), static_cast<uint32_t>(buffer.size()))) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_requestPending && m_totalSize + filledSize > m_requestOffset)
+                {
+                    m_timesToFirstByte.push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_requestStart));
+                    m_requestPending = false;
+                    m_firstByteCondition.notify_all();
+                }
+            }
+
+            m_totalSize += filledSize;
+            m_sink(buffer.data(), filledSize);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+        m_firstByteCondition.notify_all();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioOutputStream> m_stream;
+    Sink m_sink;
+    const uint32_t m_chunkSize;
+    std::atomic<uint64_t> m_totalSize{ 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_firstByteCondition;
+    Clock::time_point m_requestStart;
+    bool m_requestPending = false;
+    bool m_finished = false;
+    uint64_t m_writtenSize = 0;     // audio of the completed requests.
+    uint64_t m_requestOffset = 0;   // where the audio of the current request starts in the stream.
+    std::vector<std::chrono::microseconds> m_timesToFirstByte;
+
+    std::thread m_thread;
+};
@@ -0,0 +1,49 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <exception>
+#include <memory>
+
+// A recognizer reading from its own push stream, for the classes that replace the recognizer of a long running feed
+// (RotatingRecognitionSession, ReplayingPushRecognizer). They derive their session state from it.
+// The session owns the recognizer, so the event handlers connected to the recognizer must not hold the session, which
+// would never be freed: they get a raw pointer to it. This is safe as long as the recognizer is released, with Stop(),
+// before the last reference to the session: the handlers do not run anymore once Stop() has returned.
+struct PushStreamSession
+{
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> Stream;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> Recognizer;
+
+    // Creates the stream, in 'format' or the default 16 kHz 16-bit mono PCM if null, and a recognizer reading from it.
+    // The recognition is not started.
+    void Open(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+              std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> format)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        Stream = format ? AudioInputStream::CreatePushStream(format) : AudioInputStream::CreatePushStream();
+        Recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(Stream));
+    }
+
+    // Stops the recognition and releases the recognizer. Errors are ignored, the session is being discarded.
+    void Stop()
+    {
+        if (!Recognizer)
+        {
+            return;
+        }
+        try
+        {
+            Recognizer->StopContinuousRecognitionAsync().get();
+        }
+        catch (const std::exception&)
+        {
+        }
+        Recognizer = nullptr;
+    }
+};
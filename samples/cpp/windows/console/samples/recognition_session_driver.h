@@ -0,0 +1,240 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// How a recognition session ended.
+enum class RecognitionSessionOutcome
+{
+    // The session stopped on its own, e.g. at the end of the audio.
+    Completed,
+    // The session was canceled, other than with an error.
+    Canceled,
+    // The session was canceled with an error.
+    Error,
+    // The session did not stop before the timeout, it was stopped.
+    Timeout,
+    // StartContinuousRecognitionAsync() or StopContinuousRecognitionAsync() failed, or no recognizer is attached.
+    Failed
+};
+
+struct RecognitionSessionResult
+{
+    RecognitionSessionOutcome Outcome = RecognitionSessionOutcome::Completed;
+    Microsoft::CognitiveServices::Speech::CancellationErrorCode ErrorCode = Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError;
+    std::string ErrorDetails;
+    std::chrono::milliseconds Duration{ 0 };
+};
+
+// Runs continuous recognition sessions, and owns the wiring the samples build by hand around a promise:
+// completion on SessionStopped or Canceled (whichever comes first, so the end is signaled exactly once),
+// a timeout, and stopping the recognizer. The same driver runs any number of sessions one after the other,
+// with the same recognizer (e.g. microphone input) or a new one attached for each session (e.g. file input).
+// Errors are reported in the result instead of thrown.
+// RecognizerT is SpeechRecognizer, IntentRecognizer or TranslationRecognizer, EventArgsT the args of its Recognized event.
+template<typename RecognizerT, typename EventArgsT>
+class RecognitionSessionDriver final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using RecognizedCallback = std::function<void(const EventArgsT& e)>;
+
+    // 'onRecognized' receives the Recognized events of the running session only.
+    explicit RecognitionSessionDriver(RecognizedCallback onRecognized = nullptr)
+        : m_state(std::make_shared<State>())
+    {
+        m_state->OnRecognized = std::move(onRecognized);
+    }
+
+    RecognitionSessionDriver(const RecognitionSessionDriver&) = delete;
+    RecognitionSessionDriver& operator=(const RecognitionSessionDriver&) = delete;
+
+    // Attaches the recognizer that the next sessions run on. Its events are connected once, attaching it again does nothing.
+    // Events of a previously attached recognizer are ignored from now on.
+    void Attach(const std::shared_ptr<RecognizerT>& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (recognizer == m_recognizer)
+        {
+            return;
+        }
+
+        uint64_t attachment;
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            attachment = ++m_state->Attachment;
+        }
+        m_recognizer = recognizer;
+        if (!m_recognizer)
+        {
+            return;
+        }
+
+        // The handlers hold the state, not the driver, so a late event after the driver is gone is harmless.
+        auto state = m_state;
+        m_recognizer->Recognized.Connect([state, attachment](const EventArgsT& e)
+        {
+            if (state->IsRunning(attachment) && state->OnRecognized)
+            {
+                state->OnRecognized(e);
+            }
+        });
+        m_recognizer->Canceled.Connect([state, attachment](const auto& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                state->Complete(attachment, RecognitionSessionOutcome::Error, e.ErrorCode, e.ErrorDetails);
+            }
+            else if (e.Reason == CancellationReason::CancelledByUser)
+            {
+                state->Complete(attachment, RecognitionSessionOutcome::Canceled, e.ErrorCode, std::string());
+            }
+            // EndOfStream is followed by SessionStopped.
+        });
+        m_recognizer->SessionStopped.Connect([state, attachment](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            state->Complete(attachment, RecognitionSessionOutcome::Completed, CancellationErrorCode::NoError, std::string());
+        });
+    }
+
+    // Detaches the recognizer, its late events are ignored.
+    void Detach()
+    {
+        Attach(nullptr);
+    }
+
+    // Runs one session on the attached recognizer, and returns when it has ended and the recognizer is stopped.
+    RecognitionSessionResult Run(std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+    {
+        RecognitionSessionResult result;
+        auto start = Clock::now();
+        if (!m_recognizer)
+        {
+            result.Outcome = RecognitionSessionOutcome::Failed;
+            result.ErrorDetails = "No recognizer attached.";
+            return result;
+        }
+
+        m_state->Begin();
+        try
+        {
+            m_recognizer->StartContinuousRecognitionAsync().get();
+        }
+        catch (const std::exception& e)
+        {
+            m_state->Complete(m_state->CurrentAttachment(), RecognitionSessionOutcome::Failed,
+                              Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError, e.what());
+        }
+
+        if (!m_state->Wait(timeout))
+        {
+            m_state->Complete(m_state->CurrentAttachment(), RecognitionSessionOutcome::Timeout,
+                              Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError, std::string());
+        }
+
+        try
+        {
+            m_recognizer->StopContinuousRecognitionAsync().get();
+        }
+        catch (const std::exception& e)
+        {
+            m_state->Complete(m_state->CurrentAttachment(), RecognitionSessionOutcome::Failed,
+                              Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError, e.what());
+        }
+
+        m_state->End(result);
+        result.Duration = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        return result;
+    }
+
+private:
+    // Shared with the event handlers, and reused by all sessions.
+    struct State
+    {
+        bool IsRunning(uint64_t attachment)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return Running && attachment == Attachment;
+        }
+
+        uint64_t CurrentAttachment()
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return Attachment;
+        }
+
+        void Begin()
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Running = true;
+            Ended = false;
+            Outcome = RecognitionSessionOutcome::Completed;
+            ErrorCode = Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError;
+            ErrorDetails.clear();
+        }
+
+        // Only the first end of a session counts, later ones (e.g. SessionStopped after Canceled) are ignored.
+        void Complete(uint64_t attachment, RecognitionSessionOutcome outcome,
+                      Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode, const std::string& errorDetails)
+        {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!Running || Ended || attachment != Attachment)
+                {
+                    return;
+                }
+                Ended = true;
+                Outcome = outcome;
+                ErrorCode = errorCode;
+                ErrorDetails = errorDetails;
+            }
+            Condition.notify_all();
+        }
+
+        bool Wait(std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            if (timeout == std::chrono::milliseconds::max())
+            {
+                Condition.wait(lock, [this] { return Ended; });
+                return true;
+            }
+            return Condition.wait_for(lock, timeout, [this] { return Ended; });
+        }
+
+        void End(RecognitionSessionResult& result)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Running = false;
+            result.Outcome = Outcome;
+            result.ErrorCode = ErrorCode;
+            result.ErrorDetails = ErrorDetails;
+        }
+
+        std::mutex Mutex;
+        std::condition_variable Condition;
+        uint64_t Attachment = 0;
+        bool Running = false;
+        bool Ended = false;
+        RecognitionSessionOutcome Outcome = RecognitionSessionOutcome::Completed;
+        Microsoft::CognitiveServices::Speech::CancellationErrorCode ErrorCode = Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError;
+        std::string ErrorDetails;
+        RecognizedCallback OnRecognized;
+    };
+
+    std::shared_ptr<State> m_state;
+    std::shared_ptr<RecognizerT> m_recognizer;
+};
+
+using SpeechRecognitionSessionDriver = RecognitionSessionDriver<Microsoft::CognitiveServices::Speech::SpeechRecognizer, Microsoft::CognitiveServices::Speech::SpeechRecognitionEventArgs>;
@@ -0,0 +1,416 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "push_stream_session.h"
+
+// A bounded ring of the most recent audio of a feed, indexed by the byte offset in the feed.
+// When more than the capacity is appended, the oldest audio is dropped.
+class AudioReplayRing final
+{
+public:
+    explicit AudioReplayRing(size_t capacity)
+        : m_buffer(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    AudioReplayRing(const AudioReplayRing&) = delete;
+    AudioReplayRing& operator=(const AudioReplayRing&) = delete;
+
+    void Append(const uint8_t* data, size_t size)
+    {
+        m_end += size;
+        // Only the last capacity bytes of a large append are kept.
+        if (size > m_buffer.size())
+        {
+            data += size - m_buffer.size();
+            size = m_buffer.size();
+        }
+        auto position = static_cast<size_t>((m_end - size) % m_buffer.size());
+        auto first = std::min(size, m_buffer.size() - position);
+        std::copy(data, data + first, m_buffer.begin() + position);
+        std::copy(data + first, data + size, m_buffer.begin());
+        m_begin = std::max(m_begin, m_end > m_buffer.size() ? m_end - m_buffer.size() : 0);
+    }
+
+    // Drops the audio before 'offset', it is not needed anymore.
+    void Release(uint64_t offset)
+    {
+        m_begin = std::min(std::max(m_begin, offset), m_end);
+    }
+
+    // Passes the audio from 'offset' (or the oldest audio kept, if it was dropped) to the end to 'write',
+    // in up to two contiguous parts. Returns the offset the audio starts at.
+    template<typename WriteT>
+    uint64_t ReadFrom(uint64_t offset, WriteT&& write) const
+    {
+        auto from = std::min(std::max(offset, m_begin), m_end);
+        auto size = static_cast<size_t>(m_end - from);
+        auto position = static_cast<size_t>(from % m_buffer.size());
+        auto first = std::min(size, m_buffer.size() - position);
+        if (first > 0)
+        {
+            write(m_buffer.data() + position, first);
+        }
+        if (size > first)
+        {
+            write(m_buffer.data(), size - first);
+        }
+        return from;
+    }
+
+    // The offset of the oldest audio kept.
+    uint64_t Begin() const { return m_begin; }
+
+    // The offset after the last byte appended, i.e. the size of the feed so far.
+    uint64_t End() const { return m_end; }
+
+private:
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_begin = 0;
+    uint64_t m_end = 0;
+};
+
+// Continuous recognition of a push stream feed that survives transient errors.
+// The audio written since the last final result is kept in a replay ring. When the session is canceled with a
+// transient error (e.g. a connection failure), a new recognizer is started on a new push stream on a separate thread,
+// and the audio is replayed to it from the end of the last final result, so the transcript has no gap.
+// Meanwhile, Write() keeps buffering into the ring, it never waits for the service.
+// Offsets of the results are in ticks since the first byte written, across reconnections.
+class ReplayingPushRecognizer final
+{
+public:
+    struct Options
+    {
+        // The audio kept for replay. Audio not finalized within that time is lost when reconnecting.
+        std::chrono::seconds ReplayCapacity{ 60 };
+        // Of the audio format of the push stream, the default is 16 kHz 16-bit mono PCM.
+        uint32_t BytesPerSecond = 32000;
+        uint32_t BlockAlign = 2;
+        // Attempts to reconnect after a transient error, before giving up. Reset by the first result after reconnecting.
+        uint32_t MaxReconnectAttempts = 5;
+        // The delay before the n-th attempt is n times this.
+        std::chrono::milliseconds ReconnectBackoff{ 500 };
+    };
+
+    struct Result
+    {
+        std::string Text;
+        uint64_t Offset = 0;        // in ticks since the first byte written.
+        uint64_t Duration = 0;      // in ticks.
+        uint32_t Session = 0;       // 0 for the first session, incremented with each reconnection.
+    };
+
+    struct Stats
+    {
+        uint64_t Reconnects = 0;
+        uint64_t ReplayedBytes = 0;
+        uint64_t LostBytes = 0;     // audio not finalized that was dropped from the ring before it could be replayed.
+    };
+
+    using ResultCallback = std::function<void(const Result& result)>;
+    // 'reconnecting' tells whether the recognizer tries to recover, or gave up.
+    using ErrorCallback = std::function<void(Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode, const std::string& errorDetails, bool reconnecting)>;
+
+    // 'onResult' is called from the SDK's threads, one result at a time, in offset order.
+    ReplayingPushRecognizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, Options options, ResultCallback onResult,
+                            ErrorCallback onError = nullptr, std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> format = nullptr)
+        : m_config(std::move(config)), m_options(options), m_onResult(std::move(onResult)), m_onError(std::move(onError)), m_format(std::move(format)),
+          m_ring(static_cast<size_t>(options.ReplayCapacity.count()) * options.BytesPerSecond)
+    {
+        if (!m_config || !m_onResult || m_options.BytesPerSecond == 0 || m_options.BlockAlign == 0)
+        {
+            throw std::invalid_argument("Invalid config, result callback or audio format");
+        }
+    }
+
+    ReplayingPushRecognizer(const ReplayingPushRecognizer&) = delete;
+    ReplayingPushRecognizer& operator=(const ReplayingPushRecognizer&) = delete;
+
+    ~ReplayingPushRecognizer()
+    {
+        Stop();
+    }
+
+    // Whether a cancellation with this error is worth a reconnection. Errors in the request or the credentials are not.
+    static bool IsTransient(Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode)
+    {
+        using Microsoft::CognitiveServices::Speech::CancellationErrorCode;
+        switch (errorCode)
+        {
+        case CancellationErrorCode::ConnectionFailure:
+        case CancellationErrorCode::ServiceTimeout:
+        case CancellationErrorCode::ServiceError:
+        case CancellationErrorCode::ServiceUnavailable:
+        case CancellationErrorCode::TooManyRequests:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Starts the first session. Throws if it cannot be started.
+    void Start()
+    {
+        auto session = CreateSession(0);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_session = session;
+        }
+        m_reconnection = std::thread(&ReplayingPushRecognizer::ReconnectionLoop, this);
+    }
+
+    // Writes audio of the feed to the current session, and keeps it until a final result covers it, for the replay.
+    // Reconnections run on their own thread, so a lost connection never delays the feed.
+    void Write(const uint8_t* data, uint32_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopped)
+        {
+            return;
+        }
+
+        m_ring.Append(data, size);
+
+        // While reconnecting, the audio is only buffered, it is replayed to the new session.
+        if (m_session && !m_session->Failed)
+        {
+            m_session->Stream->Write(const_cast<uint8_t*>(data), size);
+        }
+    }
+
+    // Ends the feed: waits for the results of the audio written so far, and stops recognition.
+    void Stop()
+    {
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopped)
+            {
+                return;
+            }
+            m_stopped = true;
+        }
+        m_changed.notify_all();
+        if (m_reconnection.joinable())
+        {
+            m_reconnection.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            session = m_session;
+        }
+        if (!session)
+        {
+            return;
+        }
+
+        session->Stream->Close();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait_for(lock, std::chrono::seconds(30), [&session] { return session->Ended; });
+        }
+        session->Stop();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_session = nullptr;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    struct Session : PushStreamSession
+    {
+        uint32_t Index = 0;
+        uint64_t BaseBytes = 0;     // position of the first byte of this session's stream in the feed.
+        bool Failed = false;
+        bool Ended = false;
+    };
+
+    uint64_t TicksFor(uint64_t bytes) const
+    {
+        return bytes * 10000000 / m_options.BytesPerSecond;
+    }
+
+    uint64_t BytesFor(uint64_t ticks) const
+    {
+        auto bytes = ticks * m_options.BytesPerSecond / 10000000;
+        return bytes - bytes % m_options.BlockAlign;
+    }
+
+    std::shared_ptr<Session> CreateSession(uint32_t index)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto session = std::make_shared<Session>();
+        session->Index = index;
+        session->Open(m_config, m_format);
+
+        // Late events of a session that failed and was replaced are recognized by the session, and ignored.
+        auto raw = session.get();
+        session->Recognizer->Recognized.Connect([this, raw](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                OnRecognized(raw, e.Result->Text, e.Result->Offset(), e.Result->Duration());
+            }
+        });
+        session->Recognizer->Canceled.Connect([this, raw](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            OnCanceled(raw, e.Reason, e.ErrorCode, e.ErrorDetails);
+        });
+        session->Recognizer->SessionStopped.Connect([this, raw](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                raw->Ended = true;
+            }
+            m_changed.notify_all();
+        });
+
+        session->Recognizer->StartContinuousRecognitionAsync().get();
+        return session;
+    }
+
+    void OnRecognized(Session* session, const std::string& text, uint64_t offset, uint64_t duration)
+    {
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (session != m_session.get() || session->Failed)
+            {
+                return;
+            }
+            result.Text = text;
+            result.Offset = TicksFor(session->BaseBytes) + offset;
+            result.Duration = duration;
+            result.Session = session->Index;
+
+            // The audio up to the end of a final result is never replayed.
+            m_finalized = std::max(m_finalized, session->BaseBytes + BytesFor(offset + duration));
+            m_ring.Release(m_finalized);
+            m_attempts = 0;
+        }
+        m_onResult(result);
+    }
+
+    void OnCanceled(Session* session, Microsoft::CognitiveServices::Speech::CancellationReason reason,
+                    Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode, const std::string& errorDetails)
+    {
+        using Microsoft::CognitiveServices::Speech::CancellationReason;
+        bool reconnecting = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (reason != CancellationReason::Error)
+            {
+                // The end of the stream, when stopping.
+                session->Ended = true;
+            }
+            else if (session == m_session.get() && !session->Failed)
+            {
+                session->Failed = true;
+                session->Ended = true;
+                reconnecting = !m_stopped && IsTransient(errorCode) && m_attempts < m_options.MaxReconnectAttempts;
+                m_reconnectRequested = reconnecting;
+            }
+        }
+        m_changed.notify_all();
+
+        if (reason == CancellationReason::Error && m_onError)
+        {
+            m_onError(errorCode, errorDetails, reconnecting);
+        }
+    }
+
+    void ReconnectionLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_changed.wait(lock, [this] { return m_stopped || m_reconnectRequested; });
+            if (m_stopped)
+            {
+                break;
+            }
+
+            m_reconnectRequested = false;
+            auto attempt = ++m_attempts;
+            auto failed = m_session;
+            auto index = failed->Index + 1;
+            if (!m_changed.wait_for(lock, m_options.ReconnectBackoff * attempt, [this] { return m_stopped; }))
+            {
+                lock.unlock();
+                failed->Stop();
+
+                std::shared_ptr<Session> session;
+                try
+                {
+                    session = CreateSession(index);
+                }
+                catch (const std::exception& e)
+                {
+                    if (m_onError)
+                    {
+                        m_onError(Microsoft::CognitiveServices::Speech::CancellationErrorCode::ConnectionFailure, e.what(),
+                                  attempt < m_options.MaxReconnectAttempts);
+                    }
+                }
+                lock.lock();
+
+                if (!session)
+                {
+                    m_reconnectRequested = attempt < m_options.MaxReconnectAttempts;
+                    continue;
+                }
+
+                // Replays the audio from the end of the last final result, which makes the new session's offsets start there.
+                // Done under the lock, so the next Write() goes after the replayed audio.
+                auto replayed = m_ring.ReadFrom(m_finalized, [&session](const uint8_t* data, size_t size)
+                {
+                    session->Stream->Write(const_cast<uint8_t*>(data), static_cast<uint32_t>(size));
+                });
+                session->BaseBytes = replayed;
+                m_stats.Reconnects++;
+                m_stats.ReplayedBytes += m_ring.End() - replayed;
+                m_stats.LostBytes += replayed - m_finalized;
+                m_finalized = replayed;
+                m_session = session;
+            }
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Options m_options;
+    ResultCallback m_onResult;
+    ErrorCallback m_onError;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> m_format;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::shared_ptr<Session> m_session;
+    AudioReplayRing m_ring;
+    uint64_t m_finalized = 0;       // offset in the feed of the end of the last final result.
+    uint32_t m_attempts = 0;
+    bool m_reconnectRequested = false;
+    bool m_stopped = false;
+    Stats m_stats;
+
+    std::thread m_reconnection;
+};
@@ -0,0 +1,395 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// The kind of event a result record was created from.
+enum class ResultRecordKind : uint8_t
+{
+    Recognizing = 1,
+    Recognized = 2,
+    NoMatch = 3,
+    Canceled = 4,
+    Transcribed = 5,
+    Synthesizing = 6,
+    SessionStarted = 7,
+    SessionStopped = 8
+};
+
+// A fixed-size, trivially copyable record of one event, so that it can be queued without allocating.
+// Texts longer than MaxTextLength are truncated, and counted in ResultSink::Counters::Truncated.
+struct ResultRecord
+{
+    static constexpr size_t Size = 1024;
+
+    uint64_t Timestamp;     // microseconds since the sink was created.
+    uint64_t Offset;        // in ticks (1 tick = 100 nanoseconds), or a byte count for Synthesizing.
+    uint64_t Duration;      // in ticks.
+    uint32_t Stream;        // set by the caller, e.g. the index of the session.
+    uint16_t TextLength;
+    ResultRecordKind Kind;
+    uint8_t Truncated;
+    char Text[Size - 32];
+
+    static constexpr size_t MaxTextLength = Size - 32;
+};
+static_assert(sizeof(ResultRecord) == ResultRecord::Size, "unexpected size of ResultRecord");
+static_assert(offsetof(ResultRecord, Text) == 32, "unexpected layout of ResultRecord");
+
+// Takes results off the SDK callback threads: callbacks push records into a bounded lock-free queue, and a writer
+// thread formats them in batches and writes them to a stream, flushing it periodically instead of on every line.
+// When the queue is full, Push() either drops the record or waits for the writer, see Options::BlockWhenFull.
+// Either way it is counted, so the counters show whether the writer keeps up.
+class ResultSink final
+{
+public:
+    enum class Format
+    {
+        // One line of text per record, for the console.
+        Text,
+        // One JSON object per line.
+        Jsonl,
+        // The records as they are in memory (host byte order): the 32-byte header followed by TextLength bytes.
+        Binary
+    };
+
+    struct Options
+    {
+        Format OutputFormat = Format::Jsonl;
+        // Number of records the queue can hold, rounded up to a power of two.
+        size_t Capacity = 4096;
+        // Maximum number of records formatted and written at once.
+        size_t BatchSize = 256;
+        // How often the stream is flushed while records are written.
+        std::chrono::milliseconds FlushInterval{ 200 };
+        // Whether Push() waits for space when the queue is full, instead of dropping the record.
+        bool BlockWhenFull = false;
+    };
+
+    struct Counters
+    {
+        uint64_t Pushed = 0;
+        uint64_t Dropped = 0;       // records not queued because the queue was full.
+        uint64_t Blocked = 0;       // pushes that had to wait because the queue was full.
+        uint64_t Truncated = 0;
+        uint64_t Written = 0;
+        uint64_t Batches = 0;
+        uint64_t Flushes = 0;
+        uint64_t MaxDepth = 0;      // highest number of queued records seen by the writer.
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    ResultSink(std::ostream& out, Options options)
+        : m_out(out), m_options(options), m_start(Clock::now())
+    {
+        size_t capacity = 2;
+        while (capacity < m_options.Capacity)
+        {
+            capacity *= 2;
+        }
+        m_mask = capacity - 1;
+        m_cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; i++)
+        {
+            m_cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+        m_writer = std::thread(&ResultSink::WriteLoop, this);
+    }
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    ~ResultSink()
+    {
+        Close();
+    }
+
+    // Writes the remaining records, flushes the stream and stops the writer, so the counters are final.
+    // All Push() calls must have returned, e.g. disconnect the event handlers or destroy the recognizer first.
+    // Records pushed after Close() are not written.
+    void Close()
+    {
+        m_stopping.store(true, std::memory_order_release);
+        if (m_writer.joinable())
+        {
+            m_writer.join();
+        }
+    }
+
+    // Queues a record. Returns false if it was dropped because the queue was full.
+    // Can be called from any number of threads, it does not take a lock.
+    bool Push(ResultRecordKind kind, uint32_t stream, uint64_t offset, uint64_t duration, const std::string& text = std::string())
+    {
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+        size_t position;
+        Cell* cell;
+        bool blocked = false;
+        while ((cell = Reserve(position)) == nullptr)
+        {
+            if (!m_options.BlockWhenFull)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (!blocked)
+            {
+                blocked = true;
+                m_blocked.fetch_add(1, std::memory_order_relaxed);
+            }
+            std::this_thread::yield();
+        }
+
+        auto& record = cell->Record;
+        record.Timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_start).count());
+        record.Offset = offset;
+        record.Duration = duration;
+        record.Stream = stream;
+        record.Kind = kind;
+        record.TextLength = static_cast<uint16_t>(std::min(text.size(), ResultRecord::MaxTextLength));
+        record.Truncated = text.size() > ResultRecord::MaxTextLength ? 1 : 0;
+        memcpy(record.Text, text.data(), record.TextLength);
+        if (record.Truncated)
+        {
+            m_truncated.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Publishes the record to the writer.
+        cell->Sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    Counters GetCounters() const
+    {
+        Counters counters;
+        counters.Pushed = m_pushed.load(std::memory_order_relaxed);
+        counters.Dropped = m_dropped.load(std::memory_order_relaxed);
+        counters.Blocked = m_blocked.load(std::memory_order_relaxed);
+        counters.Truncated = m_truncated.load(std::memory_order_relaxed);
+        counters.Written = m_written.load(std::memory_order_relaxed);
+        counters.Batches = m_batches.load(std::memory_order_relaxed);
+        counters.Flushes = m_flushes.load(std::memory_order_relaxed);
+        counters.MaxDepth = m_maxDepth.load(std::memory_order_relaxed);
+        return counters;
+    }
+
+    static const char* KindName(ResultRecordKind kind)
+    {
+        switch (kind)
+        {
+        case ResultRecordKind::Recognizing: return "Recognizing";
+        case ResultRecordKind::Recognized: return "Recognized";
+        case ResultRecordKind::NoMatch: return "NoMatch";
+        case ResultRecordKind::Canceled: return "Canceled";
+        case ResultRecordKind::Transcribed: return "Transcribed";
+        case ResultRecordKind::Synthesizing: return "Synthesizing";
+        case ResultRecordKind::SessionStarted: return "SessionStarted";
+        case ResultRecordKind::SessionStopped: return "SessionStopped";
+        default: return "Unknown";
+        }
+    }
+
+private:
+    // A slot of the bounded multi-producer queue (D. Vyukov). Its sequence tells whether it is free for the producer
+    // at a given position (sequence == position) or holds a record for the consumer (sequence == position + 1).
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        ResultRecord Record;
+    };
+
+    // Claims the cell for the next position, or returns nullptr if the queue is full.
+    Cell* Reserve(size_t& position)
+    {
+        position = m_enqueuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto cell = &m_cells[position & m_mask];
+            auto sequence = cell->Sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    return cell;
+                }
+            }
+            else if (difference < 0)
+            {
+                return nullptr;
+            }
+            else
+            {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only called by the writer thread.
+    bool TryPop(ResultRecord& record)
+    {
+        auto cell = &m_cells[m_dequeuePosition & m_mask];
+        if (cell->Sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1)
+        {
+            return false;
+        }
+        memcpy(&record, &cell->Record, offsetof(ResultRecord, Text) + cell->Record.TextLength);
+        cell->Sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+        m_dequeuePosition++;
+        return true;
+    }
+
+    void WriteLoop()
+    {
+        std::string buffer;
+        ResultRecord record;
+        auto lastFlush = Clock::now();
+        bool unflushed = false;
+
+        while (true)
+        {
+            // Read before popping, so that no record pushed before the sink was stopped is left behind.
+            auto stopping = m_stopping.load(std::memory_order_acquire);
+
+            auto depth = m_enqueuePosition.load(std::memory_order_relaxed) - m_dequeuePosition;
+            if (depth > m_maxDepth.load(std::memory_order_relaxed))
+            {
+                m_maxDepth.store(depth, std::memory_order_relaxed);
+            }
+
+            size_t count = 0;
+            while (count < m_options.BatchSize && TryPop(record))
+            {
+                Append(buffer, record);
+                count++;
+            }
+            if (count > 0)
+            {
+                m_out.write(buffer.data(), buffer.size());
+                buffer.clear();
+                unflushed = true;
+                m_written.fetch_add(count, std::memory_order_relaxed);
+                m_batches.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            auto now = Clock::now();
+            if (unflushed && now - lastFlush >= m_options.FlushInterval)
+            {
+                m_out.flush();
+                m_flushes.fetch_add(1, std::memory_order_relaxed);
+                lastFlush = now;
+                unflushed = false;
+            }
+
+            if (count == 0)
+            {
+                if (stopping)
+                {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        m_out.flush();
+        m_flushes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Append(std::string& buffer, const ResultRecord& record) const
+    {
+        switch (m_options.OutputFormat)
+        {
+        case Format::Binary:
+            buffer.append(reinterpret_cast<const char*>(&record), offsetof(ResultRecord, Text) + record.TextLength);
+            break;
+
+        case Format::Jsonl:
+            buffer += "{\"timestamp\":" + std::to_string(record.Timestamp);
+            buffer += ",\"stream\":" + std::to_string(record.Stream);
+            buffer += ",\"kind\":\"";
+            buffer += KindName(record.Kind);
+            buffer += "\",\"offset\":" + std::to_string(record.Offset);
+            buffer += ",\"duration\":" + std::to_string(record.Duration);
+            buffer += ",\"text\":\"";
+            AppendJsonEscaped(buffer, record.Text, record.TextLength);
+            buffer += record.Truncated ? "\",\"truncated\":true}\n" : "\"}\n";
+            break;
+
+        case Format::Text:
+        default:
+            buffer += "[" + std::to_string(record.Stream) + "] ";
+            buffer += KindName(record.Kind);
+            buffer += ": Offset=" + std::to_string(record.Offset) + " Duration=" + std::to_string(record.Duration);
+            if (record.TextLength > 0)
+            {
+                buffer += " Text=";
+                buffer.append(record.Text, record.TextLength);
+            }
+            buffer += "\n";
+            break;
+        }
+    }
+
+    static void AppendJsonEscaped(std::string& buffer, const char* text, size_t length)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (size_t i = 0; i < length; i++)
+        {
+            auto c = static_cast<unsigned char>(text[i]);
+            switch (c)
+            {
+            case '"': buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    buffer += "\\u00";
+                    buffer += hex[c >> 4];
+                    buffer += hex[c & 0xF];
+                }
+                else
+                {
+                    buffer += static_cast<char>(c);
+                }
+            }
+        }
+    }
+
+    std::ostream& m_out;
+    const Options m_options;
+    const Clock::time_point m_start;
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    std::atomic<size_t> m_enqueuePosition{ 0 };
+    size_t m_dequeuePosition = 0;
+
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<uint64_t> m_pushed{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<uint64_t> m_blocked{ 0 };
+    std::atomic<uint64_t> m_truncated{ 0 };
+    std::atomic<uint64_t> m_written{ 0 };
+    std::atomic<uint64_t> m_batches{ 0 };
+    std::atomic<uint64_t> m_flushes{ 0 };
+    std::atomic<uint64_t> m_maxDepth{ 0 };
+
+    std::thread m_writer;
+};
@@ -0,0 +1,618 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "push_stream_session.h"
+
+// Continuous recognition of a live feed that runs for days, as a sequence of sessions that are rotated regularly,
+// so that no connection or recognizer lives forever.
+// Audio is written with Write() to the current session's push stream. Ahead of each rotation, the next recognizer is
+// created and started on its own push stream, so its connection is up when it is needed. At rotation time, the next
+// stream is fed with the last Overlap of audio, and then with the feed, in parallel with the current one. The cut over
+// happens at the end of the first phrase recognized by the current session within the overlap, i.e. at a silence,
+// or after MaxCutDelay if the speaker does not pause. Results of the old session are kept before the cut, results of
+// the new session after it (by the middle of each phrase), so the overlap is not reported twice.
+// Offsets are in ticks since the first byte written, they never go back across rotations. Write() never waits for
+// the service: recognizers are created and stopped on a separate thread, and results are reported outside the lock.
+class RotatingRecognitionSession final
+{
+public:
+    struct Options
+    {
+        // Audio time after which a session is replaced.
+        std::chrono::seconds RotationInterval{ 600 };
+        // How long before the rotation the next recognizer is created and connected.
+        std::chrono::seconds PrewarmLead{ 10 };
+        // Audio fed to both sessions before the cut over.
+        std::chrono::milliseconds Overlap{ 3000 };
+        // Maximum audio time after the start of the overlap before the cut over is forced.
+        std::chrono::milliseconds MaxCutDelay{ 15000 };
+        // Of the audio format of the push streams, the default is 16 kHz 16-bit mono PCM.
+        uint32_t BytesPerSecond = 32000;
+    };
+
+    struct Result
+    {
+        std::string Text;
+        uint64_t Offset = 0;        // in ticks since the first byte written.
+        uint64_t Duration = 0;      // in ticks.
+        uint32_t Session = 0;       // index of the session that recognized it.
+    };
+
+    struct Stats
+    {
+        uint64_t Rotations = 0;
+        uint64_t ForcedCuts = 0;        // cut overs without a silence within MaxCutDelay.
+        uint64_t ErrorRotations = 0;    // rotations because the current session was canceled with an error.
+        uint64_t Duplicates = 0;        // results dropped in the overlap.
+    };
+
+    using ResultCallback = std::function<void(const Result& result)>;
+    using ErrorCallback = std::function<void(uint32_t session, const std::string& errorDetails)>;
+
+    // 'onResult' is called from the SDK's threads, one result at a time, in offset order.
+    RotatingRecognitionSession(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, Options options, ResultCallback onResult,
+                               ErrorCallback onError = nullptr, std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> format = nullptr)
+        : m_config(std::move(config)), m_options(options), m_onResult(std::move(onResult)), m_onError(std::move(onError)), m_format(std::move(format))
+    {
+        if (!m_config || !m_onResult || m_options.BytesPerSecond == 0)
+        {
+            throw std::invalid_argument("Invalid config, result callback or bytes per second");
+        }
+        m_overlapBytes = BytesFor(m_options.Overlap);
+        m_ring.resize(m_overlapBytes > 0 ? m_overlapBytes : 1);
+    }
+
+    RotatingRecognitionSession(const RotatingRecognitionSession&) = delete;
+    RotatingRecognitionSession& operator=(const RotatingRecognitionSession&) = delete;
+
+    ~RotatingRecognitionSession()
+    {
+        Stop();
+    }
+
+    // Starts the first session. Throws if it cannot be started.
+    void Start()
+    {
+        auto session = CreateSession(0);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active = session;
+            m_state = State::Steady;
+        }
+        m_rotation = std::thread(&RotatingRecognitionSession::RotationLoop, this);
+    }
+
+    // Writes audio of the feed to the current session, and to the next one during the overlap. Sessions are created and
+    // stopped on the rotation thread, so a rotation never delays the feed.
+    void Write(const uint8_t* data, uint32_t size)
+    {
+        bool notify = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_active || m_state == State::Stopped)
+            {
+                return;
+            }
+
+            m_active->Stream->Write(const_cast<uint8_t*>(data), size);
+            if (m_next && m_state == State::Overlapping)
+            {
+                m_next->Stream->Write(const_cast<uint8_t*>(data), size);
+            }
+            AppendToRing(data, size);
+            m_totalBytes += size;
+
+            auto activeBytes = m_totalBytes - m_active->BaseBytes;
+            if (m_state == State::Steady && !m_prewarmRequested && activeBytes + BytesFor(m_options.PrewarmLead) >= BytesFor(m_options.RotationInterval))
+            {
+                m_prewarmRequested = true;
+                notify = true;
+            }
+            else if (m_state == State::Prewarmed && activeBytes >= BytesFor(m_options.RotationInterval))
+            {
+                BeginOverlap();
+            }
+            else if (m_state == State::Overlapping && m_totalBytes >= m_next->BaseBytes + BytesFor(m_options.MaxCutDelay))
+            {
+                m_stats.ForcedCuts++;
+                Cut(TicksFor(m_totalBytes));
+                notify = true;
+            }
+        }
+        if (notify)
+        {
+            m_changed.notify_all();
+        }
+    }
+
+    // Ends the feed: waits for the results of the audio written so far, and stops all sessions.
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_state == State::Stopped)
+            {
+                return;
+            }
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        if (m_rotation.joinable())
+        {
+            m_rotation.join();
+        }
+        StopDiscarded();
+        Retire();
+
+        std::shared_ptr<Session> active, next;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            active = m_active;
+            next = m_next;
+            m_next = nullptr;
+            m_state = State::Stopped;
+        }
+        if (next)
+        {
+            StopSession(next, false);
+        }
+        if (active)
+        {
+            StopSession(active, true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active = nullptr;
+        }
+        DrainResults();
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    enum class State
+    {
+        Steady,         // one session.
+        Prewarmed,      // the next session is started, but not fed yet.
+        Overlapping,    // both sessions are fed, until the cut over.
+        Retiring,       // the old session finishes its results, the new one is fed alone.
+        Stopped
+    };
+
+    struct Session : PushStreamSession
+    {
+        uint32_t Index = 0;
+        uint64_t BaseBytes = 0;     // position of the first byte of this session's stream in the feed.
+        bool Ended = false;
+        std::vector<Result> Pending;    // results held back until the previous session is done.
+    };
+
+    uint64_t BytesFor(std::chrono::milliseconds duration) const
+    {
+        return static_cast<uint64_t>(duration.count()) * m_options.BytesPerSecond / 1000;
+    }
+
+    uint64_t TicksFor(uint64_t bytes) const
+    {
+        return bytes * 10000000 / m_options.BytesPerSecond;
+    }
+
+    std::shared_ptr<Session> CreateSession(uint32_t index)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto session = std::make_shared<Session>();
+        session->Index = index;
+        session->Open(m_config, m_format);
+
+        // Up to three sessions run during a rotation, their events are told apart by the session they come from.
+        auto raw = session.get();
+        session->Recognizer->Recognized.Connect([this, raw](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                OnRecognized(raw, e.Result->Text, e.Result->Offset(), e.Result->Duration());
+            }
+        });
+        session->Recognizer->Canceled.Connect([this, raw](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            OnEnded(raw, e.Reason == CancellationReason::Error ? e.ErrorDetails : std::string(), e.Reason == CancellationReason::Error);
+        });
+        session->Recognizer->SessionStopped.Connect([this, raw](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            OnEnded(raw, std::string(), false);
+        });
+
+        session->Recognizer->StartContinuousRecognitionAsync().get();
+        return session;
+    }
+
+    // Closes the stream, waits for the session to deliver its last results, and stops the recognizer.
+    void StopSession(const std::shared_ptr<Session>& session, bool waitForResults)
+    {
+        session->Stream->Close();
+        if (waitForResults)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait_for(lock, std::chrono::seconds(30), [&session] { return session->Ended; });
+        }
+        session->Stop();
+    }
+
+    void AppendToRing(const uint8_t* data, uint32_t size)
+    {
+        if (m_overlapBytes == 0)
+        {
+            return;
+        }
+        // Only the last m_overlapBytes of a large write matter.
+        if (size > m_overlapBytes)
+        {
+            data += size - m_overlapBytes;
+            size = static_cast<uint32_t>(m_overlapBytes);
+        }
+        for (uint32_t i = 0; i < size; i++)
+        {
+            m_ring[m_ringEnd] = data[i];
+            m_ringEnd = (m_ringEnd + 1) % m_ring.size();
+        }
+        m_ringSize = std::min<uint64_t>(m_ringSize + size, m_ring.size());
+    }
+
+    // Feeds the next session with the buffered overlap, and from now on with the feed. Called with m_mutex held.
+    void BeginOverlap()
+    {
+        auto start = (m_ringEnd + m_ring.size() - m_ringSize) % m_ring.size();
+        auto first = std::min<size_t>(m_ringSize, m_ring.size() - start);
+        if (first > 0)
+        {
+            m_next->Stream->Write(m_ring.data() + start, static_cast<uint32_t>(first));
+        }
+        if (m_ringSize > first)
+        {
+            m_next->Stream->Write(m_ring.data(), static_cast<uint32_t>(m_ringSize - first));
+        }
+        m_next->BaseBytes = m_totalBytes - m_ringSize;
+        m_state = State::Overlapping;
+    }
+
+    // Switches the feed to the next session. Called with m_mutex held.
+    void Cut(uint64_t cutTicks)
+    {
+        m_cutTicks = cutTicks;
+        m_retiring = m_active;
+        m_active = m_next;
+        m_next = nullptr;
+        m_state = State::Retiring;
+
+        // Results the new session recognized so far are kept if they are after the cut.
+        auto pending = std::move(m_active->Pending);
+        m_active->Pending.clear();
+        for (auto& result : pending)
+        {
+            if (result.Offset + result.Duration / 2 >= m_cutTicks)
+            {
+                m_active->Pending.push_back(std::move(result));
+            }
+            else
+            {
+                m_stats.Duplicates++;
+            }
+        }
+    }
+
+    void OnRecognized(Session* session, const std::string& text, uint64_t offset, uint64_t duration)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Result result;
+            result.Text = text;
+            result.Offset = TicksFor(session->BaseBytes) + offset;
+            result.Duration = duration;
+            result.Session = session->Index;
+            auto middle = result.Offset + result.Duration / 2;
+
+            if (session == m_next.get())
+            {
+                // Before the cut over, it is not known yet which of these results are kept.
+                session->Pending.push_back(std::move(result));
+            }
+            else if (session == m_retiring.get())
+            {
+                if (middle < m_cutTicks)
+                {
+                    Emit(std::move(result));
+                }
+                else
+                {
+                    m_stats.Duplicates++;
+                }
+            }
+            else if (session == m_active.get())
+            {
+                if (middle < m_cutTicks)
+                {
+                    m_stats.Duplicates++;
+                }
+                else if (m_state == State::Retiring)
+                {
+                    session->Pending.push_back(std::move(result));
+                }
+                else
+                {
+                    auto end = result.Offset + result.Duration;
+                    Emit(std::move(result));
+
+                    // The end of a phrase in the overlap is a silence, a good point to cut over.
+                    if (m_state == State::Overlapping && end > TicksFor(m_next->BaseBytes))
+                    {
+                        Cut(end);
+                        m_changed.notify_all();
+                    }
+                }
+            }
+        }
+        DrainResults();
+    }
+
+    void OnEnded(Session* session, const std::string& errorDetails, bool error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto first = !session->Ended;
+            session->Ended = true;
+
+            // A next session that ends before the cut over is of no use, it is replaced by a new one.
+            if (first && session == m_next.get() && !m_stopping && m_state != State::Stopped)
+            {
+                DiscardNext();
+            }
+
+            // Only the streams of sessions being stopped are closed, the current session must not end by itself.
+            if (first && session == m_active.get() && !m_stopping && m_state != State::Stopped)
+            {
+                m_stats.ErrorRotations++;
+                if (m_state == State::Overlapping)
+                {
+                    Cut(TakeOverTicks());
+                }
+                else
+                {
+                    m_rotateNow = true;
+                }
+            }
+        }
+        m_changed.notify_all();
+
+        if (error && m_onError)
+        {
+            m_onError(session->Index, errorDetails);
+        }
+    }
+
+    // Drops the next session, to be stopped by the rotation thread, and requests a new one. Called with m_mutex held.
+    void DiscardNext()
+    {
+        m_discarded.push_back(std::move(m_next));
+        m_next = nullptr;
+        m_state = State::Steady;
+        m_prewarmRequested = true;
+    }
+
+    void StopDiscarded()
+    {
+        std::vector<std::shared_ptr<Session>> discarded;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            discarded.swap(m_discarded);
+        }
+        for (const auto& session : discarded)
+        {
+            StopSession(session, false);
+        }
+    }
+
+    // Where the next session takes over from a current session that ended, without a silence to cut at.
+    // Called with m_mutex held.
+    uint64_t TakeOverTicks() const
+    {
+        return std::max(m_lastEmittedEnd, TicksFor(m_next->BaseBytes));
+    }
+
+    // Called with m_mutex held. Results are passed to the callback by DrainResults(), outside the lock.
+    void Emit(Result result)
+    {
+        // Guarantees monotonic offsets, whatever the sessions report in the overlap.
+        if (result.Offset < m_lastEmittedEnd)
+        {
+            m_stats.Duplicates++;
+            return;
+        }
+        m_lastEmittedEnd = result.Offset + result.Duration;
+        m_results.push_back(std::move(result));
+    }
+
+    void DrainResults()
+    {
+        // The emit lock keeps the callbacks in order, and is never held by Write().
+        std::lock_guard<std::mutex> emitLock(m_emitMutex);
+        while (true)
+        {
+            std::deque<Result> results;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                results.swap(m_results);
+            }
+            if (results.empty())
+            {
+                return;
+            }
+            for (const auto& result : results)
+            {
+                m_onResult(result);
+            }
+        }
+    }
+
+    // Waits for the old session to deliver its last results, then reports the held back results of the new one.
+    void Retire()
+    {
+        std::shared_ptr<Session> retiring;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            retiring = m_retiring;
+        }
+        if (!retiring)
+        {
+            return;
+        }
+
+        StopSession(retiring, true);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& result : m_active->Pending)
+            {
+                Emit(std::move(result));
+            }
+            m_active->Pending.clear();
+            m_retiring = nullptr;
+            if (m_state == State::Retiring)
+            {
+                m_state = State::Steady;
+            }
+            m_stats.Rotations++;
+        }
+        m_changed.notify_all();
+        DrainResults();
+    }
+
+    void RotationLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_changed.wait(lock, [this]
+            {
+                return m_stopping || m_state == State::Retiring || !m_discarded.empty() ||
+                    (m_state == State::Steady && (m_prewarmRequested || m_rotateNow)) ||
+                    (m_rotateNow && (m_state == State::Prewarmed || m_state == State::Overlapping));
+            });
+            if (m_stopping)
+            {
+                break;
+            }
+
+            if (!m_discarded.empty())
+            {
+                lock.unlock();
+                StopDiscarded();
+                lock.lock();
+                continue;
+            }
+
+            if (m_state == State::Retiring)
+            {
+                lock.unlock();
+                Retire();
+                lock.lock();
+                continue;
+            }
+
+            if (m_state != State::Steady)
+            {
+                // The current session ended, the next one takes over at once and replays the buffered audio.
+                if (m_next->Ended)
+                {
+                    // It cannot take over either, a new one is started first.
+                    DiscardNext();
+                    continue;
+                }
+                m_rotateNow = false;
+                if (m_state == State::Prewarmed)
+                {
+                    BeginOverlap();
+                }
+                Cut(TakeOverTicks());
+                continue;
+            }
+
+            auto index = m_active->Index + 1;
+            lock.unlock();
+            std::shared_ptr<Session> next;
+            try
+            {
+                next = CreateSession(index);
+            }
+            catch (const std::exception& e)
+            {
+                if (m_onError)
+                {
+                    m_onError(index, e.what());
+                }
+            }
+            lock.lock();
+
+            if (!next)
+            {
+                // Retried after a pause, the current session keeps running meanwhile.
+                m_changed.wait_for(lock, std::chrono::seconds(5), [this] { return m_stopping; });
+                continue;
+            }
+            m_prewarmRequested = false;
+            m_next = next;
+            m_state = State::Prewarmed;
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Options m_options;
+    ResultCallback m_onResult;
+    ErrorCallback m_onError;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> m_format;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    State m_state = State::Steady;
+    bool m_stopping = false;
+    bool m_prewarmRequested = false;
+    bool m_rotateNow = false;
+    std::shared_ptr<Session> m_active;
+    std::shared_ptr<Session> m_next;
+    std::shared_ptr<Session> m_retiring;
+    std::vector<std::shared_ptr<Session>> m_discarded;     // next sessions that ended early, not stopped yet.
+    uint64_t m_totalBytes = 0;
+    uint64_t m_cutTicks = 0;
+    uint64_t m_lastEmittedEnd = 0;
+    Stats m_stats;
+
+    // The last Overlap of audio, replayed to the next session.
+    std::vector<uint8_t> m_ring;
+    uint64_t m_overlapBytes = 0;
+    size_t m_ringEnd = 0;
+    uint64_t m_ringSize = 0;
+
+    std::mutex m_emitMutex;
+    std::deque<Result> m_results;
+
+    std::thread m_rotation;
+};
@@ -0,0 +1,131 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Append-only audio buffer made of fixed-size blocks.
+// Appending never moves audio that was already received, so long-form synthesis output does not need
+// one contiguous allocation and is not copied again every time the buffer grows.
+class SegmentedAudioBuffer final
+{
+public:
+    // A contiguous piece of the buffer, used for scatter-gather iteration.
+    struct Segment
+    {
+        const uint8_t* Data;
+        size_t Size;
+    };
+
+    // 32000 bytes is one second of 16 kHz, 16 bits per sample, mono PCM audio.
+    static constexpr size_t DefaultBlockSize = 32000;
+
+    explicit SegmentedAudioBuffer(size_t blockSize = DefaultBlockSize)
+        : m_blockSize(blockSize == 0 ? DefaultBlockSize : blockSize)
+    {
+    }
+
+    SegmentedAudioBuffer(const SegmentedAudioBuffer&) = delete;
+    SegmentedAudioBuffer& operator=(const SegmentedAudioBuffer&) = delete;
+
+    // Copies 'size' bytes to the end of the buffer, allocating new blocks as needed.
+    void Append(const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            auto used = m_size % m_blockSize;
+            if (used == 0 && m_size / m_blockSize == m_blocks.size())
+            {
+                m_blocks.emplace_back(new uint8_t[m_blockSize]);
+            }
+
+            auto count = std::min(size, m_blockSize - used);
+            memcpy(m_blocks.back().get() + used, data, count);
+            m_size += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    // Gets the number of bytes in the buffer.
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    // Gets the number of blocks allocated so far.
+    size_t BlockCount() const
+    {
+        return m_blocks.size();
+    }
+
+    // Calls 'func' with each contiguous segment of the buffer, in order.
+    template<typename Func>
+    void ForEachSegment(Func&& func) const
+    {
+        auto remaining = m_size;
+        for (const auto& block : m_blocks)
+        {
+            if (remaining == 0)
+            {
+                break;
+            }
+            auto count = std::min(remaining, m_blockSize);
+            func(Segment{ block.get(), count });
+            remaining -= count;
+        }
+    }
+
+    // Gets all segments of the buffer, e.g. to pass them to a vectored write.
+    std::vector<Segment> GetSegments() const
+    {
+        std::vector<Segment> segments;
+        segments.reserve(m_blocks.size());
+        ForEachSegment([&segments](const Segment& segment) { segments.push_back(segment); });
+        return segments;
+    }
+
+    // Copies up to 'size' bytes starting at 'offset' into 'dataBuffer'.
+    // Returns the number of bytes copied.
+    size_t CopyTo(size_t offset, uint8_t* dataBuffer, size_t size) const
+    {
+        size_t copied = 0;
+        while (copied < size && offset < m_size)
+        {
+            auto block = offset / m_blockSize;
+            auto used = offset % m_blockSize;
+            auto count = std::min(std::min(size - copied, m_blockSize - used), m_size - offset);
+            memcpy(dataBuffer + copied, m_blocks[block].get() + used, count);
+            copied += count;
+            offset += count;
+        }
+        return copied;
+    }
+
+    // Copies the whole buffer into one contiguous byte vector.
+    // Only call this when a contiguous copy is really needed, it allocates Size() bytes.
+    std::shared_ptr<std::vector<uint8_t>> Flatten() const
+    {
+        auto flattened = std::make_shared<std::vector<uint8_t>>(m_size);
+        CopyTo(0, flattened->data(), m_size);
+        return flattened;
+    }
+
+    // Releases all blocks.
+    void Clear()
+    {
+        m_blocks.clear();
+        m_size = 0;
+    }
+
+private:
+    const size_t m_blockSize;
+    size_t m_size = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> m_blocks;
+};
@@ -6,10 +6,12 @@
 #include "stdafx.h"
 
 // <toplevel>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <speechapi_cxx.h>
 #include "wav_file_reader.h"
+#include "bulk_voice_enrollment.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -225,6 +227,75 @@ void SpeakerIdentificationWithMicrophone()
     }
 }
 
+// Bulk enrollment of the voice profiles of many customers, resumable from a journal.
+void SpeakerBulkEnrollmentWithJournal()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Reads the customers from enrollment_manifest.txt, one per line, the customer id, a tab and the enrollment files, e.g.
+    //   customer-0001<TAB>customer-0001-a.wav;customer-0001-b.wav
+    // Uses two customers with the sample enrollment audio if the file does not exist.
+    vector<VoiceEnrollmentJob> jobs;
+    if (ifstream("enrollment_manifest.txt").good())
+    {
+        try
+        {
+            jobs = BulkVoiceEnroller::LoadManifest("enrollment_manifest.txt");
+        }
+        catch (const invalid_argument& e)
+        {
+            cout << "Invalid manifest: " << e.what() << endl;
+            return;
+        }
+    }
+    else
+    {
+        jobs.push_back({ "katie", { "enrollment_audio_katie.wav" } });
+        jobs.push_back({ "steve", { "enrollment_audio_steve.wav" } });
+    }
+
+    // Records the progress, run the sample again to resume an interrupted run. Delete the journal to enroll from scratch.
+    VoiceEnrollmentJournal journal("enrollment_journal.txt");
+
+    // Runs at most 8 enrollments at the same time, and retries throttled requests up to 5 times.
+    BulkVoiceEnroller::Options options;
+    options.MaxConcurrentEnrollments = 8;
+    options.MaxAttempts = 5;
+    options.ProfileType = VoiceProfileType::TextIndependentIdentification;
+    BulkVoiceEnroller enroller(config, journal, options);
+
+    // The callback receives the results as the customers complete, one at a time.
+    enroller.Run(jobs, [](const VoiceEnrollmentResult& result)
+    {
+        if (result.Skipped)
+        {
+            cout << "SKIPPED: " << result.CustomerId << (result.Enrolled ? " enrolled as " + result.ProfileId : " failed before") << endl;
+        }
+        else if (result.Enrolled)
+        {
+            cout << "ENROLLED: " << result.CustomerId << " as " << result.ProfileId << " (" << result.CreateAttempts << " creation and "
+                 << result.Attempts << " enrollment requests, "
+                 << result.ProcessingTime.count() << " ms)" << endl;
+        }
+        else
+        {
+            cout << "CANCELED: " << result.CustomerId << ": " << result.ErrorDetails << endl;
+        }
+    });
+
+    auto error = enroller.GetError();
+    if (!error.empty())
+    {
+        cout << "Run canceled: " << error << endl;
+    }
+    auto stats = enroller.GetStats();
+    cout << "Enrolled " << stats.Enrolled << " profiles, skipped " << stats.Skipped << ", failed " << stats.Failed << ", with "
+         << stats.CreateRetries << " creation and " << stats.Retries << " enrollment retries, in " << stats.WallTime.count() << " ms." << endl;
+    enroller.EnrollmentTime().Print(cout, "Enrollment time", 1.0, "ms");
+}
+
 // helper function for speaker verification.
 void VerifyVoiceProfileFromMicrophone(const shared_ptr<SpeechConfig>& config, const shared_ptr<VoiceProfile>& profile)
 {
@@ -0,0 +1,731 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "speech_synthesizer_pool.h"
+#include "latency_histogram.h"
+
+// The intent matched in the text of an utterance, no IntentId if none matched.
+struct TurnIntent
+{
+    std::string Text;
+    std::string IntentId;
+    std::map<std::string, std::string> Entities;
+};
+
+// A dialog turn: the final result of an utterance, and the response spoken to it.
+struct TurnResult
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Index of the turn in the input, starting at 0.
+    size_t Turn = 0;
+    TurnIntent Intent;
+    // Empty if the turn has no response.
+    std::string Response;
+    // Set if the response was synthesized from a partial result, ahead of the final one.
+    bool Speculative = false;
+    bool Failed = false;
+    std::string ErrorDetails;
+    // Position of the utterance in the audio input, in ticks (100 nanoseconds).
+    uint64_t Offset = 0;
+    uint64_t Duration = 0;
+    Clock::time_point RecognizedAt;
+    // Not set if the turn has no response, or its synthesis failed before any audio.
+    Clock::time_point FirstAudioAt;
+};
+
+// Runs the stages of a dialog turn, recognition, intent matching and synthesis of the response, as a pipeline rather than
+// one after the other.
+// Intents are matched on the partial results as soon as they are stable, i.e. as soon as the last StablePartials
+// Recognizing events agree on their first words. The response to a partial result is synthesized right away on a
+// synthesizer of the pool, and its audio is held back. Once the final result arrives, the held back audio is played if the
+// response to the final result is the same (the speculation is committed), otherwise the speculative synthesis is stopped
+// and the response is synthesized again (the speculation is discarded).
+// The responses are played in the order of the turns, one after the other.
+class SpeculativeTurnEngine final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // Matches the intent of a text, partial or final. Called on the engine thread, it should be fast, e.g. a local pattern
+    // matching model rather than a service round trip.
+    using IntentMatcher = std::function<TurnIntent(const std::string& text)>;
+    // Returns the text of the response to an intent, or an empty text for no response. Called on the engine thread, for
+    // partial and final results alike, it must not have side effects: a response may be synthesized and never played.
+    using ResponseGenerator = std::function<std::string(const TurnIntent& intent)>;
+    // Called on a synthesis thread with the audio of the response of a turn, in order.
+    using AudioCallback = std::function<void(size_t turn, const uint8_t* data, size_t size)>;
+    // Called once per turn, after its response has been played, or right away if it has none.
+    using TurnCallback = std::function<void(const TurnResult& result)>;
+
+    struct Options
+    {
+        // If not set, the responses are synthesized from the final results only, e.g. as a baseline.
+        bool Speculate = true;
+        // Number of consecutive partial results that must agree on their first words.
+        size_t StablePartials = 2;
+        // Stable partial results with fewer words are not matched.
+        size_t MinStableWords = 2;
+        // Speculations started for the same utterance, e.g. as its intent becomes clearer.
+        size_t MaxSpeculationsPerTurn = 3;
+        std::string Voice = "en-US-JennyNeural";
+        Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat OutputFormat =
+            Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm;
+        std::chrono::milliseconds AcquireTimeout{ 5000 };
+    };
+
+    struct Stats
+    {
+        uint64_t Turns = 0;
+        uint64_t NoResponse = 0;
+        uint64_t SpeculationsStarted = 0;
+        uint64_t SpeculationsCommitted = 0;
+        uint64_t SpeculationsDiscarded = 0;
+        uint64_t Failed = 0;
+    };
+
+    // Matches the intents with an intent recognizer, e.g. one with a pattern matching model, which recognizes text locally.
+    static IntentMatcher MatcherFromIntentRecognizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::Intent::IntentRecognizer> recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        return [recognizer](const std::string& text)
+        {
+            TurnIntent intent;
+            intent.Text = text;
+            auto result = recognizer->RecognizeOnceAsync(text).get();
+            if (result->Reason == ResultReason::RecognizedIntent)
+            {
+                intent.IntentId = result->IntentId;
+                intent.Entities = result->GetEntities();
+            }
+            return intent;
+        };
+    }
+
+    // 'audioInput' is the input of the recognizer, e.g. the default microphone, or a PacedWavFileInput for benchmarks.
+    // The responses are synthesized on synthesizers of 'pool', prewarm it for the voice and format of the options.
+    SpeculativeTurnEngine(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+                          std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> audioInput, SpeechSynthesizerPool& pool,
+                          IntentMatcher match, ResponseGenerator respond, AudioCallback onAudio, TurnCallback onTurn, Options options)
+        : m_pool(pool), m_match(std::move(match)), m_respond(std::move(respond)), m_onAudio(std::move(onAudio)),
+          m_onTurn(std::move(onTurn)), m_options(options)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (!m_match || !m_respond || !m_onAudio)
+        {
+            throw std::invalid_argument("An intent matcher, a response generator and an audio callback are required");
+        }
+        if (m_options.StablePartials == 0)
+        {
+            throw std::invalid_argument("StablePartials must be at least 1");
+        }
+
+        m_recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+        m_recognizer->Recognizing += [this](const SpeechRecognitionEventArgs& e)
+        {
+            Post(Event{ Event::Type::Partial, e.Result->Text, 0, 0, Clock::now() });
+        };
+        m_recognizer->Recognized += [this](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+            {
+                Post(Event{ Event::Type::Final, e.Result->Text, e.Result->Offset(), e.Result->Duration(), Clock::now() });
+            }
+            else
+            {
+                // Nothing was recognized, the speculations on its partial results are dropped.
+                Post(Event{ Event::Type::NoMatch, std::string(), 0, 0, Clock::now() });
+            }
+        };
+        m_recognizer->Canceled += [this](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (e.Reason == CancellationReason::Error)
+                {
+                    m_error = e.ErrorDetails;
+                }
+            }
+            Post(Event{ Event::Type::End, std::string(), 0, 0, Clock::now() });
+        };
+        m_recognizer->SessionStopped += [this](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            Post(Event{ Event::Type::End, std::string(), 0, 0, Clock::now() });
+        };
+    }
+
+    SpeculativeTurnEngine(const SpeculativeTurnEngine&) = delete;
+    SpeculativeTurnEngine& operator=(const SpeculativeTurnEngine&) = delete;
+
+    ~SpeculativeTurnEngine()
+    {
+        Stop();
+    }
+
+    void Start()
+    {
+        m_thread = std::thread(&SpeculativeTurnEngine::EngineLoop, this);
+        m_recognizer->StartContinuousRecognitionAsync().get();
+    }
+
+    // Waits for the end of the input, and for the responses of all its turns to be played.
+    void WaitUntilEnded()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] { return m_stopping || (m_inputEnded && m_events.empty() && m_played == m_committed); });
+    }
+
+    // Stops the recognition. The responses not played yet are dropped.
+    void Stop()
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        m_recognizer->StopContinuousRecognitionAsync().get();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+
+        // The engine thread discarded the speculations still pending, the committed ones stop at m_stopping.
+        for (auto& speculation : m_speculations)
+        {
+            speculation->Thread.join();
+        }
+        m_speculations.clear();
+    }
+
+    // The recognition error, if the recognition was canceled with an error.
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    // Time from the final result of an utterance to the first audio of its response, in microseconds.
+    const LatencyHistogram& RecognizedToFirstAudio() const
+    {
+        return m_recognizedToFirstAudio;
+    }
+
+private:
+    struct Event
+    {
+        enum class Type
+        {
+            Partial,
+            Final,
+            NoMatch,
+            End
+        };
+
+        Type Kind;
+        std::string Text;
+        uint64_t Offset;
+        uint64_t Duration;
+        Clock::time_point At;
+    };
+
+    // The synthesis of a response. The decision fields are guarded by the engine mutex, the audio is only accessed by the
+    // synthesis thread.
+    struct Speculation
+    {
+        std::string Response;
+        bool Committed = false;
+        bool Discarded = false;
+        // Set once a discarded synthesis has been stopped, the synthesizer is returned to the pool only then.
+        bool StopIssued = false;
+        bool Done = false;
+        // Position of the response in the output, and its turn, set on commit.
+        size_t OutputIndex = 0;
+        TurnResult Result;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> Synthesizer;
+        std::vector<uint8_t> Audio;
+        size_t Delivered = 0;
+        std::thread Thread;
+    };
+
+    static std::vector<std::string> Words(const std::string& text)
+    {
+        std::vector<std::string> words;
+        std::istringstream stream(text);
+        std::string word;
+        while (stream >> word)
+        {
+            words.push_back(word);
+        }
+        return words;
+    }
+
+    void Post(Event event)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (event.Kind == Event::Type::End)
+            {
+                if (m_endPosted)
+                {
+                    return;
+                }
+                m_endPosted = true;
+            }
+            m_events.push_back(std::move(event));
+        }
+        m_changed.notify_all();
+    }
+
+    void EngineLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_changed.wait(lock, [this] { return m_stopping || !m_events.empty(); });
+            if (m_stopping)
+            {
+                break;
+            }
+            auto event = std::move(m_events.front());
+            m_events.pop_front();
+            lock.unlock();
+
+            switch (event.Kind)
+            {
+            case Event::Type::Partial:
+                OnPartial(event);
+                break;
+            case Event::Type::Final:
+                OnFinal(event);
+                break;
+            case Event::Type::NoMatch:
+                Discard(m_current);
+                ResetUtterance();
+                break;
+            case Event::Type::End:
+                Discard(m_current);
+                ResetUtterance();
+                break;
+            }
+
+            lock.lock();
+            if (event.Kind == Event::Type::End)
+            {
+                m_inputEnded = true;
+            }
+            Reap(lock);
+            m_changed.notify_all();
+        }
+        lock.unlock();
+        Discard(m_current);
+    }
+
+    void OnPartial(const Event& event)
+    {
+        if (!m_options.Speculate)
+        {
+            return;
+        }
+
+        m_partials.push_back(Words(event.Text));
+        if (m_partials.size() > m_options.StablePartials)
+        {
+            m_partials.pop_front();
+        }
+        if (m_partials.size() < m_options.StablePartials)
+        {
+            return;
+        }
+
+        // The stable words are the ones all the recent partial results agree on.
+        size_t stable = m_partials.front().size();
+        for (const auto& partial : m_partials)
+        {
+            stable = std::min(stable, partial.size());
+            for (size_t i = 0; i < stable; i++)
+            {
+                if (partial[i] != m_partials.front()[i])
+                {
+                    stable = i;
+                    break;
+                }
+            }
+        }
+        if (stable < m_options.MinStableWords || stable == m_matchedWords)
+        {
+            return;
+        }
+        m_matchedWords = stable;
+
+        std::string text;
+        for (size_t i = 0; i < stable; i++)
+        {
+            text += (i == 0 ? "" : " ") + m_partials.front()[i];
+        }
+        // Only a matched intent is worth a speculation, a fallback response would likely be discarded.
+        auto intent = m_match(text);
+        if (intent.IntentId.empty())
+        {
+            return;
+        }
+        auto response = m_respond(intent);
+        if (response.empty() || (m_current != nullptr && m_current->Response == response) ||
+            m_speculationsThisTurn >= m_options.MaxSpeculationsPerTurn)
+        {
+            return;
+        }
+
+        // The intent changed as the utterance went on, the previous speculation is wrong.
+        Discard(m_current);
+        m_current = Synthesize(response);
+        m_speculationsThisTurn++;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.SpeculationsStarted++;
+    }
+
+    void OnFinal(const Event& event)
+    {
+        TurnResult result;
+        result.Turn = m_turns++;
+        result.Intent = m_match(event.Text);
+        result.Response = m_respond(result.Intent);
+        result.Offset = event.Offset;
+        result.Duration = event.Duration;
+        result.RecognizedAt = event.At;
+
+        auto speculation = std::move(m_current);
+        m_current = nullptr;
+        ResetUtterance();
+
+        if (result.Response.empty())
+        {
+            Discard(speculation);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.Turns++;
+                m_stats.NoResponse++;
+            }
+            if (m_onTurn)
+            {
+                m_onTurn(result);
+            }
+            return;
+        }
+
+        if (speculation != nullptr && speculation->Response == result.Response)
+        {
+            result.Speculative = true;
+        }
+        else
+        {
+            Discard(speculation);
+            speculation = Synthesize(result.Response);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.Turns++;
+            if (result.Speculative)
+            {
+                m_stats.SpeculationsCommitted++;
+            }
+            speculation->Committed = true;
+            speculation->OutputIndex = m_committed++;
+            speculation->Result = std::move(result);
+        }
+        m_changed.notify_all();
+    }
+
+    void ResetUtterance()
+    {
+        m_partials.clear();
+        m_matchedWords = 0;
+        m_speculationsThisTurn = 0;
+    }
+
+    std::shared_ptr<Speculation> Synthesize(const std::string& response)
+    {
+        auto speculation = std::make_shared<Speculation>();
+        speculation->Response = response;
+        speculation->Thread = std::thread(&SpeculativeTurnEngine::SynthesisLoop, this, speculation.get());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_speculations.push_back(speculation);
+        return speculation;
+    }
+
+    // Drops a speculation that is not committed, and stops its synthesis.
+    void Discard(std::shared_ptr<Speculation>& speculation)
+    {
+        if (speculation == nullptr)
+        {
+            return;
+        }
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            speculation->Discarded = true;
+            synthesizer = speculation->Synthesizer;
+            m_stats.SpeculationsDiscarded++;
+        }
+        if (synthesizer != nullptr)
+        {
+            try
+            {
+                synthesizer->StopSpeakingAsync().get();
+            }
+            catch (const std::exception&)
+            {
+                // The synthesis ends by itself, its audio is dropped anyway.
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            speculation->StopIssued = true;
+        }
+        m_changed.notify_all();
+        speculation = nullptr;
+    }
+
+    // Joins the synthesis threads that are done. Must be called with the engine locked.
+    void Reap(std::unique_lock<std::mutex>& lock)
+    {
+        std::vector<std::shared_ptr<Speculation>> done;
+        for (auto it = m_speculations.begin(); it != m_speculations.end();)
+        {
+            if ((*it)->Done)
+            {
+                done.push_back(std::move(*it));
+                it = m_speculations.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        lock.unlock();
+        for (auto& speculation : done)
+        {
+            speculation->Thread.join();
+        }
+        lock.lock();
+    }
+
+    // Plays the audio of a committed response that has not been played yet. Only called on its synthesis thread.
+    void Deliver(Speculation& speculation)
+    {
+        if (speculation.Delivered == speculation.Audio.size())
+        {
+            return;
+        }
+        if (speculation.Delivered == 0)
+        {
+            speculation.Result.FirstAudioAt = Clock::now();
+        }
+        m_onAudio(speculation.Result.Turn, speculation.Audio.data() + speculation.Delivered, speculation.Audio.size() - speculation.Delivered);
+        speculation.Delivered = speculation.Audio.size();
+    }
+
+    // Runs on its own thread, from the checkout of a synthesizer to its return to the pool.
+    void SynthesisLoop(Speculation* speculation)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        std::string error;
+        SpeechSynthesizerPool::Lease lease;
+        try
+        {
+            lease = m_pool.Acquire(m_options.Voice, m_options.OutputFormat, m_options.AcquireTimeout);
+            if (!lease)
+            {
+                error = "No synthesizer available";
+            }
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+        }
+
+        std::shared_ptr<AudioDataStream> stream;
+        if (lease)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!speculation->Discarded)
+                {
+                    speculation->Synthesizer = lease.Get();
+                }
+            }
+            if (speculation->Synthesizer != nullptr)
+            {
+                try
+                {
+                    // Returns once the first audio has been received, the rest is read from the stream as it arrives.
+                    auto result = lease->StartSpeakingTextAsync(speculation->Response).get();
+                    if (result->Reason == ResultReason::SynthesizingAudioStarted)
+                    {
+                        stream = AudioDataStream::FromResult(result);
+                    }
+                    else if (result->Reason == ResultReason::Canceled)
+                    {
+                        auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+                        error = cancellation->ErrorDetails;
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+            }
+        }
+
+        std::vector<uint8_t> chunk(4096);
+        while (stream != nullptr)
+        {
+            auto size = stream->ReadData(chunk.data(), static_cast<uint32_t>(chunk.size()));
+            if (size == 0)
+            {
+                break;
+            }
+            speculation->Audio.insert(speculation->Audio.end(), chunk.begin(), chunk.begin() + size);
+
+            bool deliver = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (speculation->Discarded || m_stopping)
+                {
+                    break;
+                }
+                // A committed response is played as it arrives once the previous responses have been played.
+                deliver = speculation->Committed && m_played == speculation->OutputIndex;
+            }
+            if (deliver)
+            {
+                Deliver(*speculation);
+            }
+        }
+        if (stream != nullptr && stream->GetStatus() == StreamStatus::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromStream(stream);
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                error = cancellation->ErrorDetails;
+            }
+        }
+
+        // Holds the synthesizer until the speculation is decided, and until a discarded one has been stopped.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this, speculation]
+        {
+            return m_stopping || (speculation->Discarded && speculation->StopIssued) ||
+                (speculation->Committed && m_played == speculation->OutputIndex);
+        });
+        speculation->Synthesizer = nullptr;
+
+        if (speculation->Committed && !m_stopping)
+        {
+            lock.unlock();
+            Deliver(*speculation);
+            auto& result = speculation->Result;
+            if (!error.empty())
+            {
+                result.Failed = true;
+                result.ErrorDetails = error;
+            }
+            if (speculation->Delivered > 0)
+            {
+                m_recognizedToFirstAudio.Record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(result.FirstAudioAt - result.RecognizedAt).count()));
+            }
+            if (m_onTurn)
+            {
+                m_onTurn(result);
+            }
+            lock.lock();
+            if (result.Failed)
+            {
+                m_stats.Failed++;
+            }
+            m_played++;
+        }
+        bool stop = !speculation->Committed || m_stopping;
+        lock.unlock();
+
+        // A synthesis started just after it was stopped still runs, it must not hold up the next checkout.
+        if (stop && lease)
+        {
+            try
+            {
+                lease->StopSpeakingAsync().get();
+            }
+            catch (const std::exception&)
+            {
+                lease.Invalidate();
+            }
+        }
+        lease = SpeechSynthesizerPool::Lease();
+
+        lock.lock();
+        speculation->Done = true;
+        lock.unlock();
+        m_changed.notify_all();
+    }
+
+    SpeechSynthesizerPool& m_pool;
+    IntentMatcher m_match;
+    ResponseGenerator m_respond;
+    AudioCallback m_onAudio;
+    TurnCallback m_onTurn;
+    const Options m_options;
+
+    std::mutex m_mutex;
+    // Notified on new events, speculation decisions, and played responses.
+    std::condition_variable m_changed;
+    std::deque<Event> m_events;
+    std::vector<std::shared_ptr<Speculation>> m_speculations;
+    // Number of responses committed, and played, in the order of the turns.
+    size_t m_committed = 0;
+    size_t m_played = 0;
+    bool m_endPosted = false;
+    bool m_inputEnded = false;
+    bool m_stopping = false;
+    std::string m_error;
+    Stats m_stats;
+    LatencyHistogram m_recognizedToFirstAudio;
+
+    // Owned by the engine thread: the utterance being recognized.
+    std::deque<std::vector<std::string>> m_partials;
+    size_t m_matchedWords = 0;
+    size_t m_speculationsThisTurn = 0;
+    size_t m_turns = 0;
+    std::shared_ptr<Speculation> m_current;
+
+    std::thread m_thread;
+    // Declared last, so it is destroyed first, while the state its event handlers use is still alive.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> m_recognizer;
+};
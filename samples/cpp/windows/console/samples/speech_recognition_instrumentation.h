@@ -0,0 +1,226 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include "latency_histogram.h"
+
+// Measures the latency of a recognizer by timestamping its session and recognition events on a monotonic clock,
+// and correlating them with the audio time of the results (Offset() and Duration(), in ticks of 100 nanoseconds).
+// The audio time is mapped to wall time assuming the audio is fed in real time from the session start, e.g. from a
+// microphone or a paced push stream. For audio that is fed faster than real time, only FirstPartial, SessionDuration
+// and RealTimeFactor are meaningful.
+// All latencies are recorded in microseconds:
+// - FirstPartial: session start to the first Recognizing event of the session.
+// - PartialLatency: how long after its audio was captured each Recognizing result arrives.
+// - Finalization: how long after the end of its audio each Recognized result arrives.
+// - EndOfSpeech: how long after the end of speech the SpeechEndDetected event arrives.
+// - SessionDuration: session start to the SessionStopped event.
+// - RealTimeFactor: session duration divided by the recognized audio duration, recorded in thousandths.
+class SpeechRecognitionInstrumentation final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Attaches to the events of a SpeechRecognizer, IntentRecognizer or TranslationRecognizer.
+    // If 'exportOnExit' is set, the histograms are written to it when this object is destroyed.
+    template<typename RecognizerT>
+    explicit SpeechRecognitionInstrumentation(const std::shared_ptr<RecognizerT>& recognizer, std::ostream* exportOnExit = nullptr)
+        : m_state(std::make_shared<State>()), m_exportOnExit(exportOnExit)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        // The handlers only hold the state, so they stay valid even if the recognizer outlives this object.
+        auto state = m_state;
+        recognizer->SessionStarted.Connect([state](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            state->OnSessionStarted(Clock::now());
+        });
+        recognizer->Recognizing.Connect([state](const auto& e)
+        {
+            state->OnRecognizing(e.Result->Offset(), e.Result->Duration(), Clock::now());
+        });
+        recognizer->Recognized.Connect([state](const auto& e)
+        {
+            state->OnRecognized(e.Result->Reason == ResultReason::NoMatch, e.Result->Offset(), e.Result->Duration(), Clock::now());
+        });
+        recognizer->SpeechEndDetected.Connect([state](const RecognitionEventArgs& e)
+        {
+            state->OnSpeechEndDetected(e.Offset, Clock::now());
+        });
+        recognizer->SessionStopped.Connect([state](const SessionEventArgs& e)
+        {
+            UNUSED(e);
+            state->OnSessionStopped(Clock::now());
+        });
+    }
+
+    SpeechRecognitionInstrumentation(const SpeechRecognitionInstrumentation&) = delete;
+    SpeechRecognitionInstrumentation& operator=(const SpeechRecognitionInstrumentation&) = delete;
+
+    ~SpeechRecognitionInstrumentation()
+    {
+        if (m_exportOnExit != nullptr)
+        {
+            Export(*m_exportOnExit);
+        }
+    }
+
+    const LatencyHistogram& FirstPartial() const { return m_state->FirstPartial; }
+    const LatencyHistogram& PartialLatency() const { return m_state->PartialLatency; }
+    const LatencyHistogram& Finalization() const { return m_state->Finalization; }
+    const LatencyHistogram& EndOfSpeech() const { return m_state->EndOfSpeech; }
+    const LatencyHistogram& SessionDuration() const { return m_state->SessionDuration; }
+    const LatencyHistogram& RealTimeFactor() const { return m_state->RealTimeFactor; }
+
+    uint64_t NoMatchCount() const
+    {
+        return m_state->NoMatch.load(std::memory_order_relaxed);
+    }
+
+    // Writes all histograms to 'out', latencies in milliseconds.
+    void Export(std::ostream& out) const
+    {
+        out << "Speech recognition latency (" << SessionDuration().Count() << " sessions, "
+            << Finalization().Count() << " recognized, " << NoMatchCount() << " no match):\n";
+        FirstPartial().Print(out, "FirstPartial", 1000.0, "ms");
+        PartialLatency().Print(out, "PartialLatency", 1000.0, "ms");
+        Finalization().Print(out, "Finalization", 1000.0, "ms");
+        EndOfSpeech().Print(out, "EndOfSpeech", 1000.0, "ms");
+        SessionDuration().Print(out, "SessionDuration", 1000.0, "ms");
+        RealTimeFactor().Print(out, "RealTimeFactor", 1000.0);
+        out.flush();
+    }
+
+private:
+    struct State
+    {
+        void OnSessionStarted(Clock::time_point now)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            SessionStart = now;
+            SessionActive = true;
+            HasPartial = false;
+            AudioEnd = 0;
+        }
+
+        void OnRecognizing(uint64_t offset, uint64_t duration, Clock::time_point now)
+        {
+            Clock::time_point start;
+            bool first = false;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!SessionActive)
+                {
+                    return;
+                }
+                start = SessionStart;
+                first = !HasPartial;
+                HasPartial = true;
+            }
+            if (first)
+            {
+                FirstPartial.Record(Microseconds(start, now));
+            }
+            PartialLatency.Record(LatencyAfterAudio(start, offset + duration, now));
+        }
+
+        void OnRecognized(bool noMatch, uint64_t offset, uint64_t duration, Clock::time_point now)
+        {
+            if (noMatch)
+            {
+                NoMatch.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            Clock::time_point start;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!SessionActive)
+                {
+                    return;
+                }
+                start = SessionStart;
+                if (offset + duration > AudioEnd)
+                {
+                    AudioEnd = offset + duration;
+                }
+            }
+            Finalization.Record(LatencyAfterAudio(start, offset + duration, now));
+        }
+
+        void OnSpeechEndDetected(uint64_t offset, Clock::time_point now)
+        {
+            Clock::time_point start;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!SessionActive)
+                {
+                    return;
+                }
+                start = SessionStart;
+            }
+            EndOfSpeech.Record(LatencyAfterAudio(start, offset, now));
+        }
+
+        void OnSessionStopped(Clock::time_point now)
+        {
+            Clock::time_point start;
+            uint64_t audioEnd = 0;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!SessionActive)
+                {
+                    return;
+                }
+                SessionActive = false;
+                start = SessionStart;
+                audioEnd = AudioEnd;
+            }
+
+            auto elapsed = Microseconds(start, now);
+            SessionDuration.Record(elapsed);
+            // The unit of audioEnd is tick (1 tick = 100 nanoseconds).
+            if (audioEnd >= 10)
+            {
+                RealTimeFactor.Record(elapsed * 1000 / (audioEnd / 10));
+            }
+        }
+
+        // Gets how long after 'audioTime' (in ticks since the session start) 'now' is.
+        static uint64_t LatencyAfterAudio(Clock::time_point sessionStart, uint64_t audioTime, Clock::time_point now)
+        {
+            auto elapsed = Microseconds(sessionStart, now);
+            auto audio = audioTime / 10;
+            return elapsed > audio ? elapsed - audio : 0;
+        }
+
+        static uint64_t Microseconds(Clock::time_point from, Clock::time_point to)
+        {
+            return to > from ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count()) : 0;
+        }
+
+        std::mutex Mutex;
+        Clock::time_point SessionStart;
+        bool SessionActive = false;
+        bool HasPartial = false;
+        uint64_t AudioEnd = 0;
+
+        LatencyHistogram FirstPartial;
+        LatencyHistogram PartialLatency;
+        LatencyHistogram Finalization;
+        LatencyHistogram EndOfSpeech;
+        LatencyHistogram SessionDuration;
+        LatencyHistogram RealTimeFactor;
+        std::atomic<uint64_t> NoMatch{ 0 };
+    };
+
+    std::shared_ptr<State> m_state;
+    std::ostream* m_exportOnExit;
+};
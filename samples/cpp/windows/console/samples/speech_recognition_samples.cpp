@@ -9,7 +9,20 @@
 #include <speechapi_cxx.h>
 #include <nlohmann/json.hpp>
 #include <fstream>
+#include <map>
+#include <random>
 #include "wav_file_reader.h"
+#include "speech_recognition_instrumentation.h"
+#include "batch_transcriber.h"
+#include "work_stealing_scheduler.h"
+#include "speech_recognizer_pool.h"
+#include "coroutine_adapters.h"
+#include "result_sink.h"
+#include "transcript_records.h"
+#include "recognition_session_driver.h"
+#include "rotating_recognition_session.h"
+#include "replaying_push_recognizer.h"
+#include "multichannel_recognizer.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -454,6 +467,705 @@ void SpeechContinuousRecognitionWithPushStream()
     recognizer->StopContinuousRecognitionAsync().get();
 }
 
+// Speech continuous recognition with latency instrumentation, using a push stream fed in real time.
+void SpeechContinuousRecognitionWithLatencyInstrumentation()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a push stream
+    auto pushStream = AudioInputStream::CreatePushStream();
+
+    // Creates a speech recognizer from stream input;
+    auto audioInput = AudioConfig::FromStreamInput(pushStream);
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    // Subscribes to the recognizer events and records their timing into latency histograms.
+    // The histograms are printed when the instrumentation goes out of scope.
+    SpeechRecognitionInstrumentation instrumentation(recognizer, &cout);
+
+    // promise for synchronization of recognition end.
+    promise<void> recognitionEnd;
+
+    // Subscribes to events.
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "Session stopped." << std::endl;
+        recognitionEnd.set_value(); // Notify to stop recognition.
+    });
+
+    WavFileReader reader("whatstheweatherlike.wav");
+
+    // 100ms of 16 kHz, 16 bits per sample, mono audio.
+    vector<uint8_t> buffer(3200);
+
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().wait();
+
+    // Read data and push them into the stream at the pace they would come from a microphone,
+    // so that the audio time of the results can be compared with the wall time.
+    auto pushStart = chrono::steady_clock::now();
+    auto pushed = chrono::milliseconds(0);
+    int readSamples = 0;
+    while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    {
+        // Push a buffer into the stream
+        pushStream->Write(buffer.data(), readSamples);
+        pushed += chrono::milliseconds(100);
+        this_thread::sleep_until(pushStart + pushed);
+    }
+
+    // Close the push stream.
+    pushStream->Close();
+
+    // Waits for recognition end.
+    recognitionEnd.get_future().get();
+
+    // Stops recognition.
+    recognizer->StopContinuousRecognitionAsync().get();
+}
+
+// Speech continuous recognition of a batch of files, with a bounded number of concurrent recognizers.
+void SpeechBatchTranscriptionWithFiles()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Reads the files to transcribe from a manifest with one file path per line.
+    // Replace with your own manifest, this sample falls back to transcribing the same file several times.
+    vector<string> manifest;
+    try
+    {
+        manifest = BatchTranscriber::LoadManifest("batch_manifest.txt");
+    }
+    catch (const invalid_argument&)
+    {
+        manifest.assign(8, "whatstheweatherlike.wav");
+    }
+
+    // Runs at most 4 recognizers at the same time, with at most 60 seconds of audio in flight.
+    BatchTranscriber::Options options;
+    options.MaxConcurrentSessions = 4;
+    options.MaxAudioSecondsInFlight = 60;
+    options.OrderedResults = true;
+
+    // The callback receives the results in manifest order, one at a time.
+    BatchTranscriber transcriber(config, options, [](const BatchTranscriptionResult& result)
+    {
+        if (result.Succeeded)
+        {
+            cout << "RECOGNIZED: [" << result.Index << "] " << result.Path << " (" << result.ProcessingTime.count() << " ms): " << result.Text << std::endl;
+        }
+        else
+        {
+            cout << "CANCELED: [" << result.Index << "] " << result.Path << ": " << result.ErrorDetails << std::endl;
+        }
+    });
+
+    vector<future<BatchTranscriptionResult>> results;
+    for (const auto& path : manifest)
+    {
+        results.push_back(transcriber.Add(path));
+    }
+
+    // Waits for all files. Each future can also be waited for on its own.
+    transcriber.Wait();
+
+    auto stats = transcriber.GetStats();
+    cout << "Transcribed " << stats.Completed << " files (" << stats.Failed << " failed), "
+         << stats.AudioSeconds << " seconds of audio in " << stats.WallTime.count() << " ms, "
+         << stats.Throughput() << "x real time." << std::endl;
+}
+
+// Simulates recognizers processing a batch of jobs, where job i takes processingSeconds[i], and returns when the last one finishes.
+// 'take' gets the next job for a worker, or returns false when the worker has nothing left to do.
+double SimulateBatchMakespan(size_t workers, const vector<double>& processingSeconds, const function<bool(size_t worker, size_t& job)>& take)
+{
+    vector<double> freeAt(workers, 0.0);
+    vector<bool> finished(workers, false);
+    double makespan = 0;
+
+    // Each step lets the worker that becomes free first take its next job.
+    for (size_t active = workers; active > 0;)
+    {
+        size_t worker = workers;
+        for (size_t i = 0; i < workers; i++)
+        {
+            if (!finished[i] && (worker == workers || freeAt[i] < freeAt[worker]))
+            {
+                worker = i;
+            }
+        }
+
+        size_t job = 0;
+        if (take(worker, job))
+        {
+            freeAt[worker] += processingSeconds[job];
+        }
+        else
+        {
+            finished[worker] = true;
+            makespan = max(makespan, freeAt[worker]);
+            active--;
+        }
+    }
+    return makespan;
+}
+
+// Compares a FIFO queue with the duration-aware work-stealing scheduler on a batch of mixed-length files, without
+// calling the service. The durations are read from the WAV headers of the files in the manifest, or generated.
+void SpeechBatchSchedulingSimulation()
+{
+    const size_t workers = 16;
+
+    // Reads the durations of the files in the manifest from their headers.
+    // Replace with your own manifest, this sample falls back to a mix of short voice notes and long meetings.
+    vector<double> durations;
+    try
+    {
+        for (const auto& path : BatchTranscriber::LoadManifest("batch_manifest.txt"))
+        {
+            WavFileReader reader(path);
+            durations.push_back(reader.GetDurationSeconds());
+        }
+    }
+    catch (const exception& e)
+    {
+        cout << "Using generated durations: " << e.what() << std::endl;
+        durations.clear();
+
+        mt19937 random(42);
+        uniform_real_distribution<double> voiceNote(3, 60);
+        uniform_real_distribution<double> meeting(30 * 60, 90 * 60);
+        for (int i = 0; i < 2000; i++)
+        {
+            durations.push_back(voiceNote(random));
+        }
+        for (int i = 0; i < 12; i++)
+        {
+            durations.push_back(meeting(random));
+        }
+        shuffle(durations.begin(), durations.end(), random);
+    }
+
+    // The actual processing time differs from the duration, recognition runs at a varying fraction of real time.
+    mt19937 random(7);
+    uniform_real_distribution<double> realTimeFactor(0.3, 0.6);
+    vector<double> processingSeconds;
+    double totalSeconds = 0;
+    double longestSeconds = 0;
+    for (auto duration : durations)
+    {
+        processingSeconds.push_back(duration * realTimeFactor(random));
+        totalSeconds += processingSeconds.back();
+        longestSeconds = max(longestSeconds, processingSeconds.back());
+    }
+
+    // No schedule can finish before the total work is evenly spread, or before the longest job is done.
+    auto ideal = max(totalSeconds / workers, longestSeconds);
+
+    // FIFO: every free worker takes the next file in manifest order.
+    size_t next = 0;
+    auto fifo = SimulateBatchMakespan(workers, processingSeconds, [&](size_t worker, size_t& job)
+    {
+        UNUSED(worker);
+        if (next == processingSeconds.size())
+        {
+            return false;
+        }
+        job = next++;
+        return true;
+    });
+
+    // Work stealing: files are assigned longest first by the duration from their header.
+    WorkStealingScheduler<size_t> scheduler(workers);
+    vector<ScheduledJob<size_t>> jobs;
+    for (size_t i = 0; i < durations.size(); i++)
+    {
+        jobs.push_back({ i, durations[i] });
+    }
+    scheduler.Assign(move(jobs));
+    auto stealing = SimulateBatchMakespan(workers, processingSeconds, [&](size_t worker, size_t& job)
+    {
+        ScheduledJob<size_t> taken;
+        if (!scheduler.TryTake(worker, taken))
+        {
+            return false;
+        }
+        job = taken.Payload;
+        return true;
+    });
+
+    cout << durations.size() << " files on " << workers << " recognizers, " << totalSeconds << " seconds of processing.\n"
+         << "  Ideal makespan:         " << ideal << " s\n"
+         << "  FIFO makespan:          " << fifo << " s (" << fifo / ideal << "x ideal)\n"
+         << "  Work-stealing makespan: " << stealing << " s (" << stealing / ideal << "x ideal, " << scheduler.StealCount() << " steals)" << std::endl;
+
+    // To transcribe for real, process the jobs on the scheduler's own threads, e.g.
+    //   scheduler.Run([&](size_t worker, const ScheduledJob<size_t>& job) { /* recognize file job.Payload */ });
+}
+
+// Speech recognition of short commands using microphone, with recognizers prewarmed in a pool per language.
+void SpeechRecognitionWithPrewarmedRecognizerPool()
+{
+    // One pool per language, each with its own config.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    map<string, unique_ptr<SpeechRecognizerPool>> pools;
+    for (const auto& language : { "en-US", "de-DE" })
+    {
+        auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        config->SetSpeechRecognitionLanguage(language);
+
+        // Keeps 2 recognizers connected, and evicts extra ones after they stayed idle for a minute.
+        SpeechRecognizerPool::Options options;
+        options.MinIdle = 2;
+        options.MaxSize = 4;
+        options.IdleTimeout = chrono::seconds(60);
+        pools[language].reset(new SpeechRecognizerPool(config, options));
+    }
+
+    while (true)
+    {
+        cout << "Enter a language (en-US or de-DE) and say a command, or press Enter to exit: ";
+        string language;
+        getline(cin, language);
+        if (language.empty())
+        {
+            break;
+        }
+
+        auto pool = pools.find(language);
+        if (pool == pools.end())
+        {
+            cout << "Unsupported language " << language << std::endl;
+            continue;
+        }
+
+        // Checks out a recognizer, it is returned to the pool at the end of the scope.
+        auto recognizer = pool->second->Acquire();
+        if (!recognizer)
+        {
+            cout << "No recognizer available." << std::endl;
+            continue;
+        }
+
+        cout << "Say something..." << std::endl;
+        auto start = chrono::steady_clock::now();
+        auto result = recognizer->RecognizeOnceAsync().get();
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << " (" << elapsed.count() << " ms)" << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+
+                // Does not put a broken recognizer back into the pool.
+                recognizer.Invalidate();
+            }
+        }
+    }
+
+    for (auto& pool : pools)
+    {
+        auto stats = pool.second->GetStats();
+        cout << pool.first << ": " << stats.WarmCheckouts << " warm and " << stats.ColdCheckouts << " cold checkouts, "
+             << stats.Created << " recognizers created, " << stats.Evicted << " evicted, " << stats.Reopened << " reconnected." << std::endl;
+    }
+}
+
+#ifdef SAMPLES_HAS_COROUTINES
+// One continuous recognition session as a coroutine, it holds no thread while it waits for the service.
+Task<void> SpeechContinuousRecognitionSession(CoroutineExecutor& executor, shared_ptr<SpeechConfig> config, string fileName, size_t session)
+{
+    auto audioInput = AudioConfig::FromWavFileInput(fileName);
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    // Signal for the end of recognition, awaited instead of a promise.
+    auto recognitionEnd = make_shared<AsyncSignal>(executor);
+
+    // Subscribes to events.
+    recognizer->Recognized.Connect([session](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Session=" << session << " Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([session, recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: Session=" << session << " ErrorCode=" << (int)e.ErrorCode << " ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+        recognitionEnd->Set(); // Notify to stop recognition.
+    });
+
+    recognizer->SessionStopped.Connect([recognitionEnd](const SessionEventArgs& e)
+    {
+        UNUSED(e);
+        recognitionEnd->Set(); // Notify to stop recognition.
+    });
+
+    // Starts continuous recognition, waits for its end, and stops it, without blocking a worker.
+    co_await executor.Await(recognizer->StartContinuousRecognitionAsync());
+    co_await *recognitionEnd;
+    co_await executor.Await(recognizer->StopContinuousRecognitionAsync());
+}
+#endif
+
+// Speech continuous recognition of many files concurrently, with coroutines driven by one worker thread per core.
+void SpeechContinuousRecognitionWithCoroutines()
+{
+#ifdef SAMPLES_HAS_COROUTINES
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    CoroutineExecutor executor;
+
+    // Starts all sessions at once, each one only takes a worker while it handles a completion.
+    vector<future<void>> sessions;
+    for (size_t session = 0; session < 32; session++)
+    {
+        sessions.push_back(executor.Spawn(SpeechContinuousRecognitionSession(executor, config, "whatstheweatherlike.wav", session)));
+    }
+
+    for (size_t session = 0; session < sessions.size(); session++)
+    {
+        try
+        {
+            sessions[session].get();
+        }
+        catch (const exception& e)
+        {
+            cout << "Session " << session << " failed: " << e.what() << std::endl;
+        }
+    }
+    cout << "All sessions stopped." << std::endl;
+#else
+    cout << "This sample requires C++20 coroutines, build the samples with /std:c++20 or --std=c++20." << std::endl;
+#endif
+}
+
+// Speech continuous recognition with file input, writing the results through sinks instead of from the event handlers.
+void SpeechContinuousRecognitionWithResultSink()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The handlers only queue records, the sinks format and write them on their own threads.
+    // The recognizer, whose handlers push to the sinks, is released before the sinks are closed.
+    ResultSink::Options consoleOptions;
+    consoleOptions.OutputFormat = ResultSink::Format::Text;
+    ResultSink console(cout, consoleOptions);
+
+    ofstream jsonFile("recognition_results.jsonl");
+    ResultSink::Options jsonOptions;
+    jsonOptions.OutputFormat = ResultSink::Format::Jsonl;
+    jsonOptions.BlockWhenFull = true; // Never loses a result, at the cost of delaying the events when the disk is slow.
+    ResultSink json(jsonFile, jsonOptions);
+
+    auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    // Subscribes to events.
+    recognizer->Recognizing.Connect([&console](const SpeechRecognitionEventArgs& e)
+    {
+        console.Push(ResultRecordKind::Recognizing, 0, e.Result->Offset(), e.Result->Duration(), e.Result->Text);
+    });
+
+    recognizer->Recognized.Connect([&console, &json](const SpeechRecognitionEventArgs& e)
+    {
+        auto kind = e.Result->Reason == ResultReason::RecognizedSpeech ? ResultRecordKind::Recognized : ResultRecordKind::NoMatch;
+        console.Push(kind, 0, e.Result->Offset(), e.Result->Duration(), e.Result->Text);
+        json.Push(kind, 0, e.Result->Offset(), e.Result->Duration(), e.Result->Text);
+    });
+
+    // Runs the session until it stops or is canceled.
+    SpeechRecognitionSessionDriver driver;
+    driver.Attach(recognizer);
+    auto session = driver.Run();
+    if (session.Outcome != RecognitionSessionOutcome::Completed)
+    {
+        auto details = "Outcome=" + to_string((int)session.Outcome) + " ErrorCode=" + to_string((int)session.ErrorCode) + " ErrorDetails=" + session.ErrorDetails;
+        console.Push(ResultRecordKind::Canceled, 0, 0, 0, details);
+        json.Push(ResultRecordKind::Canceled, 0, 0, 0, details);
+    }
+    console.Push(ResultRecordKind::SessionStopped, 0, 0, 0);
+
+    // The driver holds the recognizer too, both references are released so no handler runs anymore.
+    driver.Detach();
+    recognizer = nullptr;
+
+    // Waits for the sinks to write all their records.
+    console.Close();
+    json.Close();
+    auto counters = json.GetCounters();
+    cout << "JSON sink: " << counters.Written << " of " << counters.Pushed << " records written in " << counters.Batches << " batches, "
+         << counters.Flushes << " flushes, " << counters.Dropped << " dropped, " << counters.Blocked << " blocked, max depth " << counters.MaxDepth << "." << std::endl;
+}
+
+// Speech continuous recognition with file input, storing the results as compact binary transcript records.
+void SpeechContinuousRecognitionWithTranscriptRecords()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Request detailed output format, so the records include the alternatives with their confidence.
+    config->SetOutputFormat(OutputFormat::Detailed);
+
+    // The records of the session are built in an arena, without an allocation per result.
+    TranscriptArena transcript;
+
+    auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    // Runs the session until it stops or is canceled, and appends the recognized results.
+    SpeechRecognitionSessionDriver driver([&transcript](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            transcript.Append(*e.Result);
+        }
+    });
+    driver.Attach(recognizer);
+    auto session = driver.Run();
+    if (session.Outcome == RecognitionSessionOutcome::Error)
+    {
+        cout << "CANCELED: ErrorCode=" << (int)session.ErrorCode << "\n"
+             << "CANCELED: ErrorDetails=" << session.ErrorDetails << "\n"
+             << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+
+    transcript.Save("transcript.bin");
+    cout << "Saved " << transcript.RecordCount() << " records, " << transcript.Size() << " bytes." << std::endl;
+
+    // Reads the records back from the mapped file, the texts are not copied.
+    TranscriptFileReader reader("transcript.bin");
+    reader.ForEach([](const TranscriptRecordView& record)
+    {
+        auto text = record.Text();
+        cout << "RECORD: Offset=" << record.Offset() << " Duration=" << record.Duration() << " Confidence=" << record.Confidence()
+             << " Text=" << string(text.Data, text.Size) << " Alternatives=" << record.NBestCount() << std::endl;
+    });
+
+    // Converts the records to JSON lines.
+    ofstream jsonl("transcript.jsonl");
+    reader.WriteJsonl(jsonl);
+}
+
+// Speech continuous recognition of many files one after the other, with one reusable session driver.
+void SpeechContinuousRecognitionWithSessionDriver()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The driver owns the completion, the timeout and the stop of each session, and is reused for all of them.
+    size_t session = 0;
+    SpeechRecognitionSessionDriver driver([&session](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Session=" << session << " Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    size_t completed = 0;
+    for (session = 0; session < 100; session++)
+    {
+        // A file input recognizer reads its file once, so every session gets a new recognizer.
+        // Replace with your own audio files.
+        auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+        driver.Attach(SpeechRecognizer::FromConfig(config, audioInput));
+
+        auto result = driver.Run(chrono::seconds(60));
+        if (result.Outcome == RecognitionSessionOutcome::Completed)
+        {
+            completed++;
+        }
+        else
+        {
+            cout << "Session " << session << " ended with outcome " << (int)result.Outcome << ": ErrorCode=" << (int)result.ErrorCode
+                 << " ErrorDetails=" << result.ErrorDetails << std::endl;
+            if (result.Outcome == RecognitionSessionOutcome::Error)
+            {
+                cout << "Did you update the subscription info?" << std::endl;
+                break;
+            }
+        }
+    }
+    driver.Detach();
+
+    cout << completed << " of " << session << " sessions completed." << std::endl;
+}
+
+// Speech continuous recognition of a long running feed, with the session rotated regularly.
+void SpeechContinuousRecognitionWithRotatingSessions()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Rotates every 30 seconds of audio for the demo, a live feed would rather rotate every few minutes or hours.
+    RotatingRecognitionSession::Options options;
+    options.RotationInterval = chrono::seconds(30);
+    options.PrewarmLead = chrono::seconds(5);
+    options.Overlap = chrono::milliseconds(3000);
+
+    RotatingRecognitionSession rotating(config, options, [](const RotatingRecognitionSession::Result& result)
+    {
+        cout << "RECOGNIZED: Session=" << result.Session << " Offset=" << result.Offset << " Duration=" << result.Duration
+             << " Text=" << result.Text << std::endl;
+    },
+    [](uint32_t session, const string& errorDetails)
+    {
+        cout << "CANCELED: Session=" << session << " ErrorDetails=" << errorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    });
+    rotating.Start();
+
+    // Simulates a two minutes live feed by looping over a file at the pace of a microphone.
+    // 100ms of 16 kHz, 16 bits per sample, mono audio.
+    vector<uint8_t> buffer(3200);
+    auto feedStart = chrono::steady_clock::now();
+    auto fed = chrono::milliseconds(0);
+    while (fed < chrono::minutes(2))
+    {
+        WavFileReader reader("whatstheweatherlike.wav");
+        int readSamples = 0;
+        while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+        {
+            rotating.Write(buffer.data(), readSamples);
+            fed += chrono::milliseconds(100);
+            this_thread::sleep_until(feedStart + fed);
+        }
+    }
+
+    // Waits for the last results.
+    rotating.Stop();
+
+    auto stats = rotating.GetStats();
+    cout << "Rotations=" << stats.Rotations << " ForcedCuts=" << stats.ForcedCuts << " ErrorRotations=" << stats.ErrorRotations
+         << " Duplicates=" << stats.Duplicates << std::endl;
+}
+
+// Speech continuous recognition from a push stream, which reconnects and replays the audio after a transient error.
+void SpeechContinuousRecognitionWithReconnectingPushStream()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Keeps up to 30 seconds of audio that was not finalized yet, for replay to a new session.
+    ReplayingPushRecognizer::Options options;
+    options.ReplayCapacity = chrono::seconds(30);
+
+    ReplayingPushRecognizer recognizer(config, options, [](const ReplayingPushRecognizer::Result& result)
+    {
+        cout << "RECOGNIZED: Session=" << result.Session << " Offset=" << result.Offset << " Duration=" << result.Duration
+             << " Text=" << result.Text << std::endl;
+    },
+    [](CancellationErrorCode errorCode, const string& errorDetails, bool reconnecting)
+    {
+        cout << "CANCELED: ErrorCode=" << (int)errorCode << " Reconnecting=" << reconnecting << std::endl;
+        cout << "CANCELED: ErrorDetails=" << errorDetails << std::endl;
+        if (!reconnecting)
+        {
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+    recognizer.Start();
+
+    WavFileReader reader("whatstheweatherlike.wav");
+
+    // 100ms of 16 kHz, 16 bits per sample, mono audio.
+    vector<uint8_t> buffer(3200);
+
+    // Read data and push them at the pace they would come from a microphone.
+    auto pushStart = chrono::steady_clock::now();
+    auto pushed = chrono::milliseconds(0);
+    int readSamples = 0;
+    while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    {
+        recognizer.Write(buffer.data(), readSamples);
+        pushed += chrono::milliseconds(100);
+        this_thread::sleep_until(pushStart + pushed);
+    }
+
+    // Waits for the last results.
+    recognizer.Stop();
+
+    auto stats = recognizer.GetStats();
+    cout << "Reconnects=" << stats.Reconnects << " ReplayedBytes=" << stats.ReplayedBytes << " LostBytes=" << stats.LostBytes << std::endl;
+}
+
+// Speech recognition of a stereo call recording, with one speaker per channel, merged into one timeline.
+void SpeechRecognitionWithMultiChannelSplit()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The agent is on the left channel, the customer on the right one.
+    MultiChannelRecognizer recognizer(config, { "Agent", "Customer" });
+
+    // Replace with your own stereo recording. The file is read once, its channels are recognized concurrently.
+    vector<RecognitionSessionResult> outcomes;
+    auto timeline = recognizer.Recognize("YourStereoCallRecording.wav", &outcomes);
+
+    for (size_t channel = 0; channel < outcomes.size(); channel++)
+    {
+        if (outcomes[channel].Outcome == RecognitionSessionOutcome::Error)
+        {
+            cout << "CANCELED: Channel=" << channel << " ErrorCode=" << (int)outcomes[channel].ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << outcomes[channel].ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+
+    for (const auto& result : timeline)
+    {
+        cout << "[" << result.Offset / 10000 << "ms] " << result.Speaker << ": " << result.Text << std::endl;
+    }
+}
+
 // Keyword-triggered speech recognition using microphone.
 void KeywordTriggeredSpeechRecognitionWithMicrophone()
 {
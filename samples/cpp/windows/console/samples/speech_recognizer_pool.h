@@ -0,0 +1,409 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// A pool of speech recognizers whose service connections are opened ahead of time, so that connection setup
+// (TLS handshake and websocket upgrade) is not on the critical path of a recognition.
+// All recognizers of a pool share one SpeechConfig, so use one pool per language or endpoint.
+// A background thread keeps at least MinIdle recognizers connected, reopens connections the service has dropped,
+// and evicts recognizers that stayed idle for longer than IdleTimeout.
+class SpeechRecognizerPool final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using AudioConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>()>;
+
+    struct Options
+    {
+        // Number of connected recognizers kept ready for checkout.
+        size_t MinIdle = 2;
+        // Maximum number of recognizers, checked out or idle.
+        size_t MaxSize = 8;
+        // Idle recognizers above MinIdle are evicted after this time.
+        std::chrono::seconds IdleTimeout{ 120 };
+        // How often idle recognizers are checked.
+        std::chrono::seconds ProbeInterval{ 10 };
+        // Passed to Connection::Open(), set for pools used with StartContinuousRecognitionAsync().
+        bool ForContinuousRecognition = false;
+    };
+
+    struct Stats
+    {
+        uint64_t Created = 0;
+        uint64_t Evicted = 0;
+        uint64_t Reopened = 0;
+        uint64_t WarmCheckouts = 0;     // checked out with an open connection.
+        uint64_t ColdCheckouts = 0;     // created or reconnected on checkout.
+    };
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> Recognizer;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> Connection;
+        // Shared with the connection event handlers, the entry itself is not captured to avoid a reference cycle.
+        std::shared_ptr<std::atomic<bool>> Connected;
+        Clock::time_point LastUsed;
+    };
+
+public:
+    // A checked out recognizer, returned to the pool when destroyed.
+    class Lease final
+    {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) : m_pool(other.m_pool), m_entry(std::move(other.m_entry)), m_healthy(other.m_healthy)
+        {
+            other.m_pool = nullptr;
+        }
+        Lease& operator=(Lease&& other)
+        {
+            if (this != &other)
+            {
+                Return();
+                m_pool = other.m_pool;
+                m_entry = std::move(other.m_entry);
+                m_healthy = other.m_healthy;
+                other.m_pool = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        ~Lease()
+        {
+            Return();
+        }
+
+        explicit operator bool() const
+        {
+            return m_entry != nullptr;
+        }
+
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer>& Get() const
+        {
+            return m_entry->Recognizer;
+        }
+
+        Microsoft::CognitiveServices::Speech::SpeechRecognizer* operator->() const
+        {
+            return m_entry->Recognizer.get();
+        }
+
+        // Marks the recognizer as broken (e.g. canceled with an error), so the pool discards it instead of reusing it.
+        void Invalidate()
+        {
+            m_healthy = false;
+        }
+
+    private:
+        friend class SpeechRecognizerPool;
+        Lease(SpeechRecognizerPool* pool, std::shared_ptr<Entry> entry) : m_pool(pool), m_entry(std::move(entry)) {}
+
+        void Return()
+        {
+            if (m_pool != nullptr && m_entry != nullptr)
+            {
+                m_pool->Release(std::move(m_entry), m_healthy);
+            }
+            m_pool = nullptr;
+            m_entry = nullptr;
+        }
+
+        SpeechRecognizerPool* m_pool = nullptr;
+        std::shared_ptr<Entry> m_entry;
+        bool m_healthy = true;
+    };
+
+    // Creates the pool and starts warming up MinIdle recognizers in the background.
+    // 'audioConfig' creates the audio input of each recognizer, the default microphone if not set.
+    SpeechRecognizerPool(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, Options options, AudioConfigFactory audioConfig = nullptr)
+        : m_config(std::move(config)), m_options(options), m_audioConfig(std::move(audioConfig))
+    {
+        if (!m_config)
+        {
+            throw std::invalid_argument("Speech config is null");
+        }
+        if (m_options.MaxSize == 0 || m_options.MinIdle > m_options.MaxSize)
+        {
+            throw std::invalid_argument("MaxSize must be at least 1 and at least MinIdle");
+        }
+        m_maintenance = std::thread(&SpeechRecognizerPool::MaintenanceLoop, this);
+    }
+
+    SpeechRecognizerPool(const SpeechRecognizerPool&) = delete;
+    SpeechRecognizerPool& operator=(const SpeechRecognizerPool&) = delete;
+
+    // All leases must have been returned before the pool is destroyed.
+    ~SpeechRecognizerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        m_maintenance.join();
+
+        for (auto& entry : m_idle)
+        {
+            Close(*entry);
+        }
+    }
+
+    // Checks out a recognizer, preferably one with an open connection. Creates a new one if none is idle and the pool
+    // is not full, otherwise waits for one to be returned. Returns an empty lease if the timeout expires first.
+    Lease Acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds(10000))
+    {
+        std::shared_ptr<Entry> entry;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_changed.wait_for(lock, timeout, [this] { return !m_idle.empty() || m_size < m_options.MaxSize; }))
+            {
+                return Lease();
+            }
+
+            if (!m_idle.empty())
+            {
+                // The most recently used recognizer is the most likely to still be connected.
+                entry = m_idle.back();
+                m_idle.pop_back();
+            }
+            else
+            {
+                m_size++;
+            }
+        }
+
+        if (entry == nullptr)
+        {
+            try
+            {
+                entry = Create();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_size--;
+                m_changed.notify_all();
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.ColdCheckouts++;
+        }
+        else if (!entry->Connected->load())
+        {
+            // The recognizer connects on first use anyway, this only starts it as early as possible.
+            Reopen(*entry);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.ColdCheckouts++;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.WarmCheckouts++;
+        }
+
+        // Idle recognizers are replenished in the background.
+        m_changed.notify_all();
+        return Lease(this, std::move(entry));
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    size_t IdleCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_idle.size();
+    }
+
+private:
+    std::shared_ptr<Entry> Create()
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto entry = std::make_shared<Entry>();
+        auto audioInput = m_audioConfig ? m_audioConfig() : AudioConfig::FromDefaultMicrophoneInput();
+        entry->Recognizer = SpeechRecognizer::FromConfig(m_config, audioInput);
+        entry->Connection = Connection::FromRecognizer(entry->Recognizer);
+        entry->Connected = std::make_shared<std::atomic<bool>>(false);
+
+        auto connected = entry->Connected;
+        entry->Connection->Connected += [connected](const ConnectionEventArgs& e)
+        {
+            UNUSED(e);
+            connected->store(true);
+        };
+        entry->Connection->Disconnected += [connected](const ConnectionEventArgs& e)
+        {
+            UNUSED(e);
+            connected->store(false);
+        };
+
+        entry->Connection->Open(m_options.ForContinuousRecognition);
+        entry->LastUsed = Clock::now();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.Created++;
+        return entry;
+    }
+
+    void Reopen(Entry& entry)
+    {
+        try
+        {
+            entry.Connection->Open(m_options.ForContinuousRecognition);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.Reopened++;
+        }
+        catch (const std::exception&)
+        {
+            // The recognizer reports the error when it is used, the connection is retried then.
+        }
+    }
+
+    static void Close(Entry& entry)
+    {
+        try
+        {
+            entry.Connection->Close();
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+
+    void Release(std::shared_ptr<Entry> entry, bool healthy)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (healthy && !m_stopping)
+            {
+                entry->LastUsed = Clock::now();
+                m_idle.push_back(entry);
+                entry = nullptr;
+            }
+            else
+            {
+                m_size--;
+                m_stats.Evicted++;
+            }
+        }
+        m_changed.notify_all();
+
+        if (entry != nullptr)
+        {
+            Close(*entry);
+        }
+    }
+
+    void MaintenanceLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            // Evicts recognizers idle for too long, starting with the least recently used.
+            std::vector<std::shared_ptr<Entry>> evicted;
+            auto now = Clock::now();
+            while (m_idle.size() > m_options.MinIdle && now - m_idle.front()->LastUsed > m_options.IdleTimeout)
+            {
+                evicted.push_back(m_idle.front());
+                m_idle.pop_front();
+                m_size--;
+                m_stats.Evicted++;
+            }
+
+            // Probes the idle recognizers, and reconnects the ones the service disconnected.
+            std::vector<std::shared_ptr<Entry>> disconnected;
+            for (auto& entry : m_idle)
+            {
+                if (!entry->Connected->load())
+                {
+                    disconnected.push_back(entry);
+                }
+            }
+
+            // Tops up the idle recognizers.
+            size_t missing = 0;
+            while (m_idle.size() + missing < m_options.MinIdle && m_size < m_options.MaxSize)
+            {
+                missing++;
+                m_size++;
+            }
+
+            lock.unlock();
+            for (auto& entry : evicted)
+            {
+                Close(*entry);
+            }
+            for (auto& entry : disconnected)
+            {
+                Reopen(*entry);
+            }
+            std::vector<std::shared_ptr<Entry>> created;
+            for (size_t i = 0; i < missing; i++)
+            {
+                try
+                {
+                    created.push_back(Create());
+                }
+                catch (const std::exception&)
+                {
+                    // Retried at the next probe.
+                }
+            }
+            lock.lock();
+
+            bool failed = created.size() < missing;
+            m_size -= missing - created.size();
+            for (auto& entry : created)
+            {
+                m_idle.push_back(entry);
+            }
+            if (missing > 0)
+            {
+                m_changed.notify_all();
+            }
+
+            // Wakes up at the next probe, or when a checkout leaves too few idle recognizers.
+            // After a failure to create a recognizer, waits for the next probe to not retry in a tight loop.
+            m_changed.wait_for(lock, m_options.ProbeInterval, [this, failed]
+            {
+                return m_stopping || (!failed && m_idle.size() < m_options.MinIdle && m_size < m_options.MaxSize);
+            });
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Options m_options;
+    AudioConfigFactory m_audioConfig;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // Idle recognizers, the least recently used at the front.
+    std::deque<std::shared_ptr<Entry>> m_idle;
+    // Number of recognizers, checked out, idle or being created.
+    size_t m_size = 0;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    std::thread m_maintenance;
+};
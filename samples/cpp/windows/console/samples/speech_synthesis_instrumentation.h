@@ -0,0 +1,243 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include "latency_histogram.h"
+
+// Measures the latency of a speech synthesizer by timestamping its events on a monotonic clock.
+// All latencies are recorded in microseconds, relative to the start of the request (see BeginRequest()),
+// or to the SynthesisStarted event if the start of the request was not marked:
+// - SynthesisStarted: request start to the SynthesisStarted event.
+// - FirstByte: request start to the first Synthesizing event with audio (time to first byte).
+// - FirstWordBoundary: request start to the first WordBoundary event.
+// - WordBoundaryLag: how much later each WordBoundary event arrives than its audio plays, assuming
+//   playback starts with the first byte. Zero when the event arrives in time.
+// - Completed: request start to the SynthesisCompleted event.
+// - RealTimeFactor: processing time divided by audio duration, recorded in thousandths.
+class SpeechSynthesisInstrumentation final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Attaches to the events of 'synthesizer'. 'bytesPerSecond' is used to derive the audio duration
+    // from the synthesized audio size, the default matches the default 16 kHz 16-bit mono PCM output format.
+    // If 'exportOnExit' is set, the histograms are written to it when this object is destroyed.
+    SpeechSynthesisInstrumentation(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer>& synthesizer,
+                                   uint32_t bytesPerSecond = 32000, std::ostream* exportOnExit = nullptr)
+        : m_state(std::make_shared<State>()), m_exportOnExit(exportOnExit)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        m_state->BytesPerSecond = bytesPerSecond;
+
+        // The handlers only hold the state, so they stay valid even if the synthesizer outlives this object.
+        auto state = m_state;
+        synthesizer->SynthesisStarted += [state](const SpeechSynthesisEventArgs& e)
+        {
+            UNUSED(e);
+            state->OnStarted(Clock::now());
+        };
+        synthesizer->Synthesizing += [state](const SpeechSynthesisEventArgs& e)
+        {
+            auto now = Clock::now();
+            auto audioData = e.Result->GetAudioData();
+            state->OnSynthesizing(audioData ? audioData->size() : 0, now);
+        };
+        synthesizer->WordBoundary += [state](const SpeechSynthesisWordBoundaryEventArgs& e)
+        {
+            state->OnWordBoundary(e.AudioOffset, Clock::now());
+        };
+        synthesizer->SynthesisCompleted += [state](const SpeechSynthesisEventArgs& e)
+        {
+            UNUSED(e);
+            state->OnFinished(Clock::now(), true);
+        };
+        synthesizer->SynthesisCanceled += [state](const SpeechSynthesisEventArgs& e)
+        {
+            UNUSED(e);
+            state->OnFinished(Clock::now(), false);
+        };
+    }
+
+    SpeechSynthesisInstrumentation(const SpeechSynthesisInstrumentation&) = delete;
+    SpeechSynthesisInstrumentation& operator=(const SpeechSynthesisInstrumentation&) = delete;
+
+    ~SpeechSynthesisInstrumentation()
+    {
+        if (m_exportOnExit != nullptr)
+        {
+            Export(*m_exportOnExit);
+        }
+    }
+
+    // Marks the start of a request. Call it right before SpeakTextAsync() or SpeakSsmlAsync().
+    // A synthesizer processes its requests one at a time and in order, so each SynthesisStarted event
+    // is matched with the oldest marked start, and all other events belong to the request in progress.
+    void BeginRequest()
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        m_state->PendingStarts.push_back(Clock::now());
+    }
+
+    const LatencyHistogram& SynthesisStarted() const { return m_state->SynthesisStarted; }
+    const LatencyHistogram& FirstByte() const { return m_state->FirstByte; }
+    const LatencyHistogram& FirstWordBoundary() const { return m_state->FirstWordBoundary; }
+    const LatencyHistogram& WordBoundaryLag() const { return m_state->WordBoundaryLag; }
+    const LatencyHistogram& Completed() const { return m_state->Completed; }
+    const LatencyHistogram& RealTimeFactor() const { return m_state->RealTimeFactor; }
+
+    uint64_t CanceledCount() const
+    {
+        return m_state->Canceled.load(std::memory_order_relaxed);
+    }
+
+    // Writes all histograms to 'out', latencies in milliseconds.
+    void Export(std::ostream& out) const
+    {
+        out << "Speech synthesis latency (" << Completed().Count() << " completed, " << CanceledCount() << " canceled):\n";
+        SynthesisStarted().Print(out, "SynthesisStarted", 1000.0, "ms");
+        FirstByte().Print(out, "FirstByte", 1000.0, "ms");
+        FirstWordBoundary().Print(out, "FirstWordBoundary", 1000.0, "ms");
+        WordBoundaryLag().Print(out, "WordBoundaryLag", 1000.0, "ms");
+        Completed().Print(out, "Completed", 1000.0, "ms");
+        RealTimeFactor().Print(out, "RealTimeFactor", 1000.0);
+        out.flush();
+    }
+
+private:
+    struct Request
+    {
+        Clock::time_point Start;
+        Clock::time_point FirstByte;
+        bool Active = false;
+        bool HasFirstByte = false;
+        bool HasWordBoundary = false;
+        uint64_t AudioSize = 0;
+    };
+
+    struct State
+    {
+        void OnStarted(Clock::time_point now)
+        {
+            Clock::time_point start = now;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!PendingStarts.empty())
+                {
+                    start = PendingStarts.front();
+                    PendingStarts.pop_front();
+                }
+                Current = Request();
+                Current.Start = start;
+                Current.Active = true;
+            }
+            SynthesisStarted.Record(Microseconds(start, now));
+        }
+
+        void OnSynthesizing(size_t size, Clock::time_point now)
+        {
+            Clock::time_point start;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Current.AudioSize += size;
+                if (!Current.Active || Current.HasFirstByte || size == 0)
+                {
+                    return;
+                }
+                Current.HasFirstByte = true;
+                Current.FirstByte = now;
+                start = Current.Start;
+            }
+            FirstByte.Record(Microseconds(start, now));
+        }
+
+        void OnWordBoundary(uint64_t audioOffset, Clock::time_point now)
+        {
+            Request request;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!Current.Active)
+                {
+                    return;
+                }
+                request = Current;
+                Current.HasWordBoundary = true;
+            }
+            if (!request.HasWordBoundary)
+            {
+                FirstWordBoundary.Record(Microseconds(request.Start, now));
+            }
+            if (request.HasFirstByte)
+            {
+                // The unit of audioOffset is tick (1 tick = 100 nanoseconds).
+                auto elapsed = Microseconds(request.FirstByte, now);
+                auto playback = audioOffset / 10;
+                WordBoundaryLag.Record(elapsed > playback ? elapsed - playback : 0);
+            }
+        }
+
+        void OnFinished(Clock::time_point now, bool completed)
+        {
+            Request request;
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!Current.Active)
+                {
+                    // Canceled before SynthesisStarted, its start must not be taken by the next request.
+                    if (!completed && !PendingStarts.empty())
+                    {
+                        PendingStarts.pop_front();
+                        Canceled.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    return;
+                }
+                request = Current;
+                Current.Active = false;
+            }
+            if (!completed)
+            {
+                Canceled.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            auto elapsed = Microseconds(request.Start, now);
+            Completed.Record(elapsed);
+            if (request.AudioSize > 0 && BytesPerSecond > 0)
+            {
+                auto audioMicroseconds = request.AudioSize * 1000000 / BytesPerSecond;
+                if (audioMicroseconds > 0)
+                {
+                    RealTimeFactor.Record(elapsed * 1000 / audioMicroseconds);
+                }
+            }
+        }
+
+        static uint64_t Microseconds(Clock::time_point from, Clock::time_point to)
+        {
+            return to > from ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count()) : 0;
+        }
+
+        uint32_t BytesPerSecond = 0;
+        std::mutex Mutex;
+        std::deque<Clock::time_point> PendingStarts;
+        Request Current;
+
+        LatencyHistogram SynthesisStarted;
+        LatencyHistogram FirstByte;
+        LatencyHistogram FirstWordBoundary;
+        LatencyHistogram WordBoundaryLag;
+        LatencyHistogram Completed;
+        LatencyHistogram RealTimeFactor;
+        std::atomic<uint64_t> Canceled{ 0 };
+    };
+
+    std::shared_ptr<State> m_state;
+    std::ostream* m_exportOnExit;
+};
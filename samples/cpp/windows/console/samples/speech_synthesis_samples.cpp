@@ -7,6 +7,19 @@
 
 #include <speechapi_cxx.h>
 #include <fstream>
+#include <thread>
+#include <vector>
+#include "segmented_audio_buffer.h"
+#include "pull_audio_output_stream_reader.h"
+#include "speech_synthesis_instrumentation.h"
+#include "synthesis_audio_cache.h"
+#include "long_form_synthesizer.h"
+#include "speech_synthesizer_pool.h"
+#include "latency_histogram.h"
+#include "synthesis_event_timeline.h"
+#include "mapped_file.h"
+#include "voice_catalog.h"
+#include "barge_in_voice_loop.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -316,6 +329,15 @@ void SpeechSynthesisToPullAudioOutputStream()
     // Creates an audio out stream.
     auto stream = AudioOutputStream::CreatePullStream();
 
+    // Reads(pulls) data from the stream on a separate thread while the synthesis is running,
+    // so the audio is available as soon as the first chunk is synthesized.
+    // The sink here appends the audio to a file, it could also send it to a socket or a player.
+    ofstream audioFile("outputaudio.pcm", ios_base::binary);
+    PullAudioOutputStreamReader reader(stream, [&audioFile](const uint8_t* data, uint32_t size)
+    {
+        audioFile.write(reinterpret_cast<const char*>(data), size);
+    });
+
     // Creates a speech synthesizer using audio stream output.
     auto streamConfig = AudioConfig::FromStreamOutput(stream);
     auto synthesizer = SpeechSynthesizer::FromConfig(config, streamConfig);
@@ -332,12 +354,20 @@ void SpeechSynthesisToPullAudioOutputStream()
             break;
         }
 
+        reader.MarkRequestStart();
         auto result = synthesizer->SpeakTextAsync(text).get();
+        reader.MarkRequestEnd(result->GetAudioLength());
 
         // Checks result.
         if (result->Reason == ResultReason::SynthesizingAudioCompleted)
         {
             cout << "Speech synthesized for text [" << text << "], and the audio was written to output stream." << std::endl;
+
+            chrono::microseconds timeToFirstByte;
+            if (reader.WaitForFirstByte(chrono::milliseconds(1000), timeToFirstByte))
+            {
+                cout << "Time to first audio byte: " << timeToFirstByte.count() / 1000.0 << "ms" << std::endl;
+            }
         }
         else if (result->Reason == ResultReason::Canceled)
         {
@@ -353,21 +383,11 @@ void SpeechSynthesisToPullAudioOutputStream()
         }
     }
 
-    // Destroys the synthesizer so that the while statement below won't infinitely wait for data from the stream.
+    // Destroys the synthesizer so that the stream is closed and the reader thread won't infinitely wait for data from it.
     synthesizer = nullptr;
+    reader.Join();
 
-    // Reads(pulls) data from the stream
-    uint8_t buffer[32000];
-    uint32_t totalSize = 0;
-    uint32_t filledSize = 0;
-
-    while ((filledSize = stream->Read(buffer, sizeof(buffer))) > 0)
-    {
-        cout << filledSize << " bytes received." << endl;
-        totalSize += filledSize;
-    }
-
-    cout << "Totally " << totalSize << " bytes received." << endl;
+    cout << "Totally " << reader.GetTotalSize() << " bytes received, and saved to [outputaudio.pcm]." << endl;
 }
 
 // Speech synthesis to push audio output stream.
@@ -375,14 +395,15 @@ void SpeechSynthesisToPushAudioOutputStream()
 {
     // First, defines push audio output stream callback class that implements the
     // PushAudioOutputStreamCallback interface. The sample here illustrates how to define such
-    // a callback that writes audio data to a byte vector.
+    // a callback that writes audio data to a segmented buffer of fixed-size blocks, so that
+    // long-form synthesis doesn't reallocate and copy all received audio on every write.
     // PushAudioOutputStreamSampleCallback implements PushAudioOutputStreamCallback interface
     class PushAudioOutputStreamSampleCallback : public PushAudioOutputStreamCallback
     {
     public:
         PushAudioOutputStreamSampleCallback()
         {
-            m_audioData = std::make_shared<std::vector<uint8_t>>();
+            m_audioData = std::make_shared<SegmentedAudioBuffer>();
         }
 
         /// <summary>
@@ -393,9 +414,7 @@ void SpeechSynthesisToPushAudioOutputStream()
         /// <returns>Tell synthesizer how many bytes are received.</returns>
         int Write(uint8_t* dataBuffer, uint32_t size) override
         {
-            auto oldSize = m_audioData->size();
-            m_audioData->resize(oldSize + size);
-            memcpy(m_audioData->data() + oldSize, dataBuffer, size);
+            m_audioData->Append(dataBuffer, size);
 
             cout << size << " bytes received." << endl;
 
@@ -416,20 +435,20 @@ void SpeechSynthesisToPushAudioOutputStream()
         /// <returns>The received audio data size</returns>
         size_t GetAudioSize()
         {
-            return m_audioData->size();
+            return m_audioData->Size();
         }
 
         /// <summary>
         /// Gets the received audio data
         /// </summary>
-        /// <returns>The received audio data in byte vector</returns>
-        std::shared_ptr<std::vector<uint8_t>> GetAudioData()
+        /// <returns>The received audio data in a segmented buffer</returns>
+        std::shared_ptr<SegmentedAudioBuffer> GetAudioData()
         {
             return m_audioData;
         }
 
     private:
-        std::shared_ptr<std::vector<uint8_t>> m_audioData;
+        std::shared_ptr<SegmentedAudioBuffer> m_audioData;
     };
 
     // Creates an instance of a speech config with specified subscription key and service region.
@@ -480,6 +499,16 @@ void SpeechSynthesisToPushAudioOutputStream()
     }
 
     cout << "Totally " << callback->GetAudioSize() << " bytes received." << endl;
+
+    // The received audio can be processed block by block without copying it, e.g. to write it to a file.
+    // Call Flatten() instead if you need all the audio in one contiguous byte vector.
+    auto audioData = callback->GetAudioData();
+    ofstream audioFile("outputaudio.pcm", ios_base::binary);
+    audioData->ForEachSegment([&audioFile](const SegmentedAudioBuffer::Segment& segment)
+    {
+        audioFile.write(reinterpret_cast<const char*>(segment.Data), segment.Size);
+    });
+    cout << "Audio data in " << audioData->BlockCount() << " blocks was saved to [outputaudio.pcm]" << endl;
 }
 
 // Gets synthesized audio data from result.
@@ -665,6 +694,525 @@ void SpeechSynthesisEvents()
     }
 }
 
+// Speech synthesis latency instrumentation.
+void SpeechSynthesisLatencyInstrumentation()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer with a null output stream.
+    // This means the audio output data will not be written to any stream.
+    // You can just get the audio from the result.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Subscribes to the synthesizer events and records their timing into latency histograms.
+    // The histograms are printed on demand, and again when the instrumentation goes out of scope.
+    SpeechSynthesisInstrumentation instrumentation(synthesizer, 32000, &cout);
+
+    while (true)
+    {
+        // Receives a text from console input and synthesize it to result.
+        cout << "Enter some text that you want to synthesize, enter '?' to print the latency histograms, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+        if (text == "?")
+        {
+            instrumentation.Export(cout);
+            continue;
+        }
+
+        instrumentation.BeginRequest();
+        auto result = synthesizer->SpeakTextAsync(text).get();
+
+        // Checks result.
+        if (result->Reason == ResultReason::SynthesizingAudioCompleted)
+        {
+            cout << "Speech synthesized for text [" << text << "]" << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << static_cast<int>(cancellation->Reason) << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << static_cast<int>(cancellation->ErrorCode) << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+}
+
+// Speech synthesis through a memory and disk cache of the synthesized audio, for prompts that are spoken again and again.
+void SpeechSynthesisWithAudioCache()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer with a null output stream, the audio is taken from the result and cached.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Keeps up to 16 MB of audio in memory, and all of it in the current directory, which persists across runs.
+    SynthesisAudioCache::Options options;
+    options.MemoryCapacity = 16 * 1024 * 1024;
+    options.Directory = ".";
+    SynthesisAudioCache cache(options);
+
+    while (true)
+    {
+        // Receives a text from console input and synthesize it to result, or gets it from the cache.
+        cout << "Enter some text that you want to synthesize, enter '?' to print the cache metrics, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+        if (text == "?")
+        {
+            cout << "MemoryHits=" << cache.MemoryHits() << " DiskHits=" << cache.DiskHits() << " Misses=" << cache.Misses()
+                 << " Failures=" << cache.Failures() << " Evictions=" << cache.Evictions() << std::endl;
+            cache.HitLatency().Print(cout, "Hit latency", 1000.0, "ms");
+            cache.MissLatency().Print(cout, "Miss latency", 1000.0, "ms");
+            continue;
+        }
+
+        auto result = cache.SpeakText(*synthesizer, text);
+        if (result.Audio)
+        {
+            static const char* sources[] = { "memory", "disk", "service" };
+            cout << "Speech synthesized for text [" << text << "] from " << sources[static_cast<int>(result.Source)] << std::endl;
+
+            // Reads the audio the same way as from an audio data stream.
+            CachedAudioStream audioDataStream(result.Audio);
+            uint8_t buffer[16000];
+            uint32_t totalSize = 0;
+            uint32_t filledSize = 0;
+            while ((filledSize = audioDataStream.ReadData(buffer, sizeof(buffer))) > 0)
+            {
+                totalSize += filledSize;
+            }
+            cout << "Totally " << totalSize << " bytes received for text [" << text << "]" << endl;
+        }
+        else if (result.Result && result.Result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result.Result);
+            cout << "CANCELED: Reason=" << static_cast<int>(cancellation->Reason) << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << static_cast<int>(cancellation->ErrorCode) << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+}
+
+// Speech synthesis of a long text, with its sentences synthesized concurrently and the audio reassembled in order.
+void SpeechSynthesisLongFormParallel()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Synthesizes up to 4 segments of about 2 sentences at a time, as 16 kHz, 16 bits per sample, mono PCM audio.
+    LongFormSynthesizer::Options options;
+    options.Concurrency = 4;
+    options.MaxSegmentLength = 200;
+    LongFormSynthesizer synthesizer(config, options);
+
+    // Replace with your own long text, e.g. a book chapter.
+    string text =
+        "The ocelot is a medium-sized spotted wild cat. It is native to the southwestern United States, Mexico, "
+        "Central and South America, and the Caribbean islands of Trinidad and Margarita. It is the largest species in the "
+        "Leopardus genus. It is mostly active during twilight and at night, and tends to be solitary and territorial. "
+        "It is efficient at climbing, leaping and swimming. It preys on small terrestrial mammals, such as armadillo, "
+        "opossum, and lagomorphs. Males and females form pairs only to mate.\n"
+        "The ocelot has been listed as Least Concern on the IUCN Red List since 2008. Its population is estimated to be "
+        "decreasing. It is threatened by habitat loss and fragmentation, poaching, and road accidents.";
+
+    // The audio comes in order, and starts before the whole text is synthesized, e.g. to start playback early.
+    ofstream audioFile("outputaudio.pcm", ios_base::binary);
+    auto result = synthesizer.SpeakText(text, [&audioFile](const uint8_t* data, size_t size)
+    {
+        audioFile.write(reinterpret_cast<const char*>(data), size);
+    },
+    [](const LongFormWordBoundary& boundary)
+    {
+        cout << "Word boundary: Segment=" << boundary.Segment << " AudioOffset=" << (boundary.AudioOffset + 5000) / 10000 << "ms"
+             << " TextOffset=" << boundary.TextOffset << " Text=" << boundary.Text << std::endl;
+    });
+
+    cout << "Synthesized " << result.Segments << " segments, " << result.AudioSize << " bytes, first audio after "
+         << result.TimeToFirstAudio.count() << "ms, all of it after " << result.Duration.count() << "ms." << std::endl;
+    if (result.FailedSegments > 0)
+    {
+        cout << "CANCELED: " << result.FailedSegments << " segments failed, ErrorDetails=[" << result.ErrorDetails << "]" << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+}
+
+// Load benchmark of the time to first byte of concurrent prompts, with a synthesizer created per prompt and with a
+// pool of prewarmed synthesizers.
+void SpeechSynthesisPoolLoadBenchmark()
+{
+    // Runs against a local endpoint, e.g. a mock of the synthesis websocket protocol or a speech container, so the
+    // benchmark measures the client and connection overhead rather than the service.
+    // Use SpeechConfig::FromSubscription in createConfig instead to run against the service.
+    cout << "Enter the address of the endpoint to benchmark, e.g. ws://localhost:5000 for a speech container, or enter empty text to exit." << std::endl;
+    cout << "> ";
+    string host;
+    getline(cin, host);
+    if (host.empty())
+    {
+        cout << "No endpoint, the benchmark is not run." << std::endl;
+        return;
+    }
+    auto createConfig = [&host]() { return SpeechConfig::FromHost(host); };
+
+    const size_t requests = 500;
+    const vector<string> voices = { "en-US-JennyNeural", "en-US-GuyNeural" };
+    const auto format = SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm;
+    const string text = "Your call is important to us, please stay on the line.";
+
+    // Starts all the requests at once, each one on its own thread, and records the time from the start of the request to
+    // the first audio chunk, including the time to get a synthesizer.
+    auto run = [&](const string& name, function<shared_ptr<SpeechSynthesizer>(size_t request, function<void(bool healthy)>& release)> acquire)
+    {
+        LatencyHistogram timeToFirstByte;
+        atomic<uint64_t> failures{ 0 };
+        mutex mutex;
+        condition_variable started;
+        bool go = false;
+
+        vector<thread> threads;
+        for (size_t request = 0; request < requests; request++)
+        {
+            threads.emplace_back([&, request]
+            {
+                {
+                    unique_lock<std::mutex> lock(mutex);
+                    started.wait(lock, [&go] { return go; });
+                }
+
+                auto start = chrono::steady_clock::now();
+                function<void(bool healthy)> release;
+                auto synthesizer = acquire(request, release);
+                bool healthy = false;
+                if (synthesizer)
+                {
+                    // Returns as soon as the first audio chunk is received.
+                    auto result = synthesizer->StartSpeakingTextAsync(text).get();
+                    if (result->Reason == ResultReason::SynthesizingAudioStarted)
+                    {
+                        timeToFirstByte.Record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+
+                        // Reads the rest of the audio, so the synthesizer is idle again once released.
+                        auto audioDataStream = AudioDataStream::FromResult(result);
+                        uint8_t buffer[16000];
+                        while (audioDataStream->ReadData(buffer, sizeof(buffer)) > 0)
+                        {
+                        }
+                        healthy = audioDataStream->GetStatus() == StreamStatus::AllData;
+                    }
+                }
+                if (!healthy)
+                {
+                    failures++;
+                }
+                if (release)
+                {
+                    release(healthy);
+                }
+            });
+        }
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            go = true;
+        }
+        started.notify_all();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        timeToFirstByte.Print(cout, name, 1000.0, "ms");
+        cout << name << ": p99 time to first byte " << timeToFirstByte.Percentile(99.0) / 1000.0 << "ms, "
+             << failures.load() << " of " << requests << " requests failed." << std::endl;
+    };
+
+    // A new synthesizer per request, as in the other samples: connection setup is part of every request.
+    vector<shared_ptr<SpeechConfig>> configs;
+    for (const auto& voice : voices)
+    {
+        auto config = createConfig();
+        config->SetSpeechSynthesisVoiceName(voice);
+        config->SetSpeechSynthesisOutputFormat(format);
+        configs.push_back(config);
+    }
+    run("Synthesizer per request", [&configs](size_t request, function<void(bool healthy)>& release)
+    {
+        UNUSED(release);
+        return SpeechSynthesizer::FromConfig(configs[request % configs.size()], nullptr);
+    });
+
+    // Prewarmed synthesizers, enough for all the concurrent requests, half of them per voice.
+    SpeechSynthesizerPool::Options options;
+    options.MinIdle = requests / voices.size();
+    options.MaxSize = requests / voices.size();
+    SpeechSynthesizerPool pool(createConfig, options);
+    for (const auto& voice : voices)
+    {
+        pool.Prewarm(voice, format);
+    }
+
+    // Waits for the connections to be opened, up to 30 seconds.
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(30);
+    auto warm = [&]()
+    {
+        for (const auto& voice : voices)
+        {
+            if (pool.IdleCount(voice, format) < options.MinIdle)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    while (!warm() && chrono::steady_clock::now() < deadline)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+
+    run("Pooled synthesizer", [&pool, &voices, format](size_t request, function<void(bool healthy)>& release)
+    {
+        auto lease = make_shared<SpeechSynthesizerPool::Lease>(pool.Acquire(voices[request % voices.size()], format));
+        if (!*lease)
+        {
+            return shared_ptr<SpeechSynthesizer>();
+        }
+        release = [lease](bool healthy)
+        {
+            if (!healthy)
+            {
+                lease->Invalidate();
+            }
+            *lease = SpeechSynthesizerPool::Lease();
+        };
+        return lease->Get();
+    });
+
+    auto stats = pool.GetStats();
+    cout << "Pool: Created=" << stats.Created << " WarmCheckouts=" << stats.WarmCheckouts << " ColdCheckouts=" << stats.ColdCheckouts
+         << " Reopened=" << stats.Reopened << " Unhealthy=" << stats.Unhealthy << " Timeouts=" << stats.Timeouts << std::endl;
+}
+
+// Speech synthesis with the word boundary, viseme and bookmark events collected into a timeline, and looked up by playback
+// position, e.g. to animate an avatar frame by frame.
+void SpeechSynthesisEventTimeline()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer with a null output stream, the events are played back from the timeline.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Collects the events of the synthesis as they arrive.
+    SynthesisEventTimeline timeline;
+    synthesizer->WordBoundary += [&timeline](const SpeechSynthesisWordBoundaryEventArgs& e) { timeline.Add(e); };
+    synthesizer->VisemeReceived += [&timeline](const SpeechSynthesisVisemeEventArgs& e) { timeline.Add(e); };
+    synthesizer->BookmarkReached += [&timeline](const SpeechSynthesisBookmarkEventArgs& e) { timeline.Add(e); };
+
+    const auto ssml = "<speak version='1.0' xml:lang='en-US' xmlns='http://www.w3.org/2001/10/synthesis' xmlns:mstts='http://www.w3.org/2001/mstts'><voice name='Microsoft Server Speech Text to Speech Voice (en-US, AriaNeural)'><bookmark mark='wave'/> Hello, nice to meet you. <bookmark mark='smile'/> How can I help you today?</voice></speak>";
+    const auto result = synthesizer->SpeakSsmlAsync(ssml).get();
+
+    if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+        cout << "CANCELED: Reason=" << static_cast<int>(cancellation->Reason) << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << static_cast<int>(cancellation->ErrorCode) << std::endl;
+            cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+        return;
+    }
+
+    cout << "Speech synthesized with " << timeline.WordAudioOffsets().size() << " words, " << timeline.VisemeAudioOffsets().size()
+         << " visemes and " << timeline.BookmarkAudioOffsets().size() << " bookmarks." << std::endl;
+
+    // Saves the timeline next to the audio, and loads it back as a renderer would.
+    vector<uint8_t> data;
+    timeline.Serialize(data);
+    {
+        ofstream timelineFile("outputtimeline.bin", ios_base::binary);
+        timelineFile.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+    MappedFile timelineFile("outputtimeline.bin");
+    auto loaded = SynthesisEventTimeline::Deserialize(timelineFile.Data(), timelineFile.Size());
+    cout << "Timeline saved to [outputtimeline.bin], " << data.size() << " bytes." << std::endl;
+
+    // Plays the timeline back at 25 frames per second, printing the changes. The unit of the offsets is tick (100 nanoseconds).
+    uint64_t end = 0;
+    for (const auto* offsets : { &loaded.WordAudioOffsets(), &loaded.VisemeAudioOffsets(), &loaded.BookmarkAudioOffsets() })
+    {
+        end = offsets->empty() ? end : max(end, offsets->back());
+    }
+    const uint64_t frame = 400000;
+    size_t word = SynthesisEventTimeline::NotFound;
+    size_t viseme = SynthesisEventTimeline::NotFound;
+    for (uint64_t position = 0; position <= end; position += frame)
+    {
+        auto currentWord = loaded.WordAt(position);
+        auto currentViseme = loaded.VisemeAt(position);
+        auto bookmarks = loaded.BookmarksBetween(position, position + frame);
+
+        if (currentWord != word && currentWord != SynthesisEventTimeline::NotFound)
+        {
+            cout << position / 10000 << "ms: word at text offset " << loaded.WordTextOffsets()[currentWord]
+                 << ", length " << loaded.WordLengths()[currentWord] << std::endl;
+        }
+        if (currentViseme != viseme && currentViseme != SynthesisEventTimeline::NotFound)
+        {
+            cout << position / 10000 << "ms: viseme " << loaded.VisemeIds()[currentViseme] << std::endl;
+        }
+        for (auto bookmark = bookmarks.first; bookmark < bookmarks.second; bookmark++)
+        {
+            cout << position / 10000 << "ms: bookmark " << loaded.BookmarkNames()[loaded.BookmarkIds()[bookmark]] << std::endl;
+        }
+        word = currentWord;
+        viseme = currentViseme;
+    }
+}
+
+// Gets the available voices from a catalogue cached on disk, refreshed in the background once a day.
+void SpeechSynthesisGetAvailableVoicesCached()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    const auto speechConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Starts with the voices cached by the previous run, if any, and fetches them from the service if there are none or
+    // they are more than a day old.
+    VoiceCatalog::Options options;
+    options.CacheFile = "voices.cache";
+    options.Ttl = chrono::hours(24);
+    VoiceCatalog catalog(speechConfig, options);
+    cout << (catalog.GetStats().LoadedFromFile ? "Voices loaded from [voices.cache]." : "No cached voices, fetching them from the service.") << std::endl;
+
+    while (true)
+    {
+        cout << "Enter a locale (e.g. en-US), a gender (Female or Male) and a style (e.g. cheerful) separated by spaces, "
+             << "'-' for any, or enter empty to exit. Enter 'refresh' to fetch the voices again." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+        if (text == "refresh")
+        {
+            catalog.Refresh(true);
+            continue;
+        }
+
+        VoiceQuery query;
+        istringstream criteria(text);
+        string gender;
+        criteria >> query.Locale >> gender >> query.Style;
+        query.Locale = query.Locale == "-" ? "" : query.Locale;
+        query.Style = query.Style == "-" ? "" : query.Style;
+        gender = VoiceCatalogSnapshot::Lower(gender);
+        query.Gender = gender == "female" ? SynthesisVoiceGender::Female : gender == "male" ? SynthesisVoiceGender::Male : SynthesisVoiceGender::Unknown;
+
+        // Only waits if there were no cached voices, until the first refresh.
+        auto snapshot = catalog.WaitForCurrent(chrono::seconds(30));
+        if (!snapshot)
+        {
+            auto stats = catalog.GetStats();
+            cout << "CANCELED: ErrorDetails=[" << stats.LastError << "]" << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            continue;
+        }
+
+        auto voices = snapshot->Find(query);
+        cout << voices.size() << " of " << snapshot->Voices().size() << " voices match:" << std::endl;
+        for (const auto* voice : voices)
+        {
+            cout << voice->ShortName << " (" << voice->LocalName << ", " << voice->Locale << ")" << std::endl;
+        }
+    }
+}
+
+// Full-duplex voice loop: the user can interrupt a prompt by speaking (barge-in), recognition keeps running while the
+// prompt plays. Runs with file-backed audio: the input is a WAV file fed in real time, and the prompts are written to a file.
+void SpeechSynthesisWithBargeIn()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The user starts speaking 3 seconds into the greeting, which interrupts it.
+    // With a microphone, use AudioConfig::FromDefaultMicrophoneInput() with echo cancellation instead.
+    PacedWavFileInput input("whatstheweatherlike.wav", chrono::milliseconds(3000));
+
+    // Writes the prompts as they are played, 16 kHz, 16 bits per sample, mono PCM. Write the frames to your audio device
+    // instead to play them.
+    ofstream audioFile("outputaudio.pcm", ios_base::binary);
+    BargeInVoiceLoop::Options options;
+    BargeInVoiceLoop loop(config, input.GetAudioConfig(), [&audioFile](const uint8_t* data, size_t size)
+    {
+        audioFile.write(reinterpret_cast<const char*>(data), size);
+    }, options);
+
+    loop.Start();
+    input.Start();
+
+    static const char* outcomes[] = { "completed", "interrupted", "failed" };
+    auto outcome = loop.Speak("Welcome to the weather line. You can ask for the weather of today, of tomorrow, or of the whole week, "
+                              "in any city of the world. You can also ask for the chance of rain, the wind, or the time of the sunrise. "
+                              "What would you like to know?");
+    cout << "Greeting " << outcomes[static_cast<int>(outcome)] << "." << std::endl;
+
+    // Answers each utterance, until the end of the input.
+    VoiceLoopUtterance utterance;
+    while (!loop.InputEnded())
+    {
+        if (!loop.NextUtterance(utterance, chrono::milliseconds(500)))
+        {
+            continue;
+        }
+        cout << "RECOGNIZED: Text=" << utterance.Text << (utterance.BargeIn ? " (barge-in)" : "") << std::endl;
+        outcome = loop.Speak("You asked: " + utterance.Text + " It is sunny, with a high of 25 degrees.");
+        cout << "Answer " << outcomes[static_cast<int>(outcome)] << "." << std::endl;
+    }
+    loop.Stop();
+
+    auto error = loop.GetError();
+    if (!error.empty())
+    {
+        cout << "CANCELED: ErrorDetails=" << error << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+    loop.InterruptToSilence().Print(cout, "Interrupt to silence", 1000.0, "ms");
+    loop.InterruptToSynthesisStop().Print(cout, "Interrupt to synthesis stop", 1000.0, "ms");
+}
+
 // Speech synthesis word boundary event.
 void SpeechSynthesisWordBoundaryEvent()
 {
@@ -0,0 +1,530 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A pool of speech synthesizers whose service connections are opened ahead of time, so that connection setup
+// (TLS handshake and websocket upgrade) is not in the time to first byte of a prompt.
+// The synthesizers are partitioned by voice and output format, each partition has its own config and its own
+// synthesizers, and a checkout only ever waits for a synthesizer of its own partition.
+// A background thread keeps at least MinIdle synthesizers connected in each partition, reopens connections the service
+// has dropped, and evicts synthesizers that stayed idle for longer than IdleTimeout.
+class SpeechSynthesizerPool final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // Creates the config of a partition, the pool sets its voice and output format.
+    // Called once per partition, with the pool locked, it must not call back into the pool.
+    using ConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>()>;
+    using AudioConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>()>;
+
+    struct Options
+    {
+        // Number of connected synthesizers kept ready for checkout, per partition.
+        size_t MinIdle = 2;
+        // Maximum number of synthesizers, checked out or idle, per partition.
+        size_t MaxSize = 8;
+        // Idle synthesizers above MinIdle are evicted after this time.
+        std::chrono::seconds IdleTimeout{ 120 };
+        // How often idle synthesizers are checked.
+        std::chrono::seconds ProbeInterval{ 10 };
+    };
+
+    struct Stats
+    {
+        uint64_t Created = 0;
+        uint64_t Evicted = 0;
+        uint64_t Reopened = 0;
+        uint64_t Unhealthy = 0;         // discarded after a connection or service error.
+        uint64_t WarmCheckouts = 0;     // checked out with an open connection.
+        uint64_t ColdCheckouts = 0;     // created or reconnected on checkout.
+        uint64_t Timeouts = 0;
+    };
+
+private:
+    struct Partition;
+
+    struct Entry
+    {
+        Partition* Owner = nullptr;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> Synthesizer;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> Connection;
+        // Shared with the event handlers, the entry itself is not captured to avoid a reference cycle.
+        std::shared_ptr<std::atomic<bool>> Connected;
+        std::shared_ptr<std::atomic<bool>> Failed;
+        Clock::time_point LastUsed;
+    };
+
+    struct Partition
+    {
+        std::string Voice;
+        Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat Format;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> Config;
+        // Idle synthesizers, the least recently used at the front.
+        std::deque<std::shared_ptr<Entry>> Idle;
+        // Number of synthesizers, checked out, idle or being created.
+        size_t Size = 0;
+        // Notified when a synthesizer of this partition is returned or created, so only its waiters wake up.
+        std::condition_variable Available;
+    };
+
+public:
+    // A checked out synthesizer, returned to the pool when destroyed.
+    class Lease final
+    {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) : m_pool(other.m_pool), m_entry(std::move(other.m_entry)), m_healthy(other.m_healthy)
+        {
+            other.m_pool = nullptr;
+        }
+        Lease& operator=(Lease&& other)
+        {
+            if (this != &other)
+            {
+                Return();
+                m_pool = other.m_pool;
+                m_entry = std::move(other.m_entry);
+                m_healthy = other.m_healthy;
+                other.m_pool = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        ~Lease()
+        {
+            Return();
+        }
+
+        explicit operator bool() const
+        {
+            return m_entry != nullptr;
+        }
+
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer>& Get() const
+        {
+            return m_entry->Synthesizer;
+        }
+
+        Microsoft::CognitiveServices::Speech::SpeechSynthesizer* operator->() const
+        {
+            return m_entry->Synthesizer.get();
+        }
+
+        // Marks the synthesizer as broken, so the pool discards it instead of reusing it.
+        // Synthesizers canceled with a connection or service error are discarded without it.
+        void Invalidate()
+        {
+            m_healthy = false;
+        }
+
+    private:
+        friend class SpeechSynthesizerPool;
+        Lease(SpeechSynthesizerPool* pool, std::shared_ptr<Entry> entry) : m_pool(pool), m_entry(std::move(entry)) {}
+
+        void Return()
+        {
+            if (m_pool != nullptr && m_entry != nullptr)
+            {
+                m_pool->Release(std::move(m_entry), m_healthy);
+            }
+            m_pool = nullptr;
+            m_entry = nullptr;
+        }
+
+        SpeechSynthesizerPool* m_pool = nullptr;
+        std::shared_ptr<Entry> m_entry;
+        bool m_healthy = true;
+    };
+
+    // Creates the pool. Partitions are warmed up by Prewarm(), or on their first checkout.
+    // 'audioConfig' creates the audio output of each synthesizer, no output (audio in the result only) if not set.
+    SpeechSynthesizerPool(ConfigFactory config, Options options, AudioConfigFactory audioConfig = nullptr)
+        : m_configFactory(std::move(config)), m_options(options), m_audioConfig(std::move(audioConfig))
+    {
+        if (!m_configFactory)
+        {
+            throw std::invalid_argument("Config factory is null");
+        }
+        if (m_options.MaxSize == 0 || m_options.MinIdle > m_options.MaxSize)
+        {
+            throw std::invalid_argument("MaxSize must be at least 1 and at least MinIdle");
+        }
+        m_maintenance = std::thread(&SpeechSynthesizerPool::MaintenanceLoop, this);
+    }
+
+    SpeechSynthesizerPool(const SpeechSynthesizerPool&) = delete;
+    SpeechSynthesizerPool& operator=(const SpeechSynthesizerPool&) = delete;
+
+    // All leases must have been returned before the pool is destroyed.
+    ~SpeechSynthesizerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        m_maintenance.join();
+
+        for (auto& partition : m_partitions)
+        {
+            for (auto& entry : partition.second->Idle)
+            {
+                Close(*entry);
+            }
+        }
+    }
+
+    // Starts connecting MinIdle synthesizers for the voice and format in the background, e.g. at startup for the voices
+    // the application speaks with.
+    void Prewarm(const std::string& voice, Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat format)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            GetPartition(voice, format);
+        }
+        m_wake.notify_all();
+    }
+
+    // Checks out a synthesizer of the voice and format, preferably one with an open connection. Creates a new one if none
+    // is idle and the partition is not full, otherwise waits for one to be returned. Returns an empty lease if the
+    // timeout expires first.
+    Lease Acquire(const std::string& voice, Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat format,
+                  std::chrono::milliseconds timeout = std::chrono::milliseconds(10000))
+    {
+        std::shared_ptr<Entry> entry;
+        Partition* partition = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            partition = &GetPartition(voice, format);
+            if (!partition->Available.wait_for(lock, timeout, [this, partition]
+                {
+                    return m_stopping || !partition->Idle.empty() || partition->Size < m_options.MaxSize;
+                }) || m_stopping)
+            {
+                m_stats.Timeouts++;
+                return Lease();
+            }
+
+            if (!partition->Idle.empty())
+            {
+                // The most recently used synthesizer is the most likely to still be connected.
+                entry = partition->Idle.back();
+                partition->Idle.pop_back();
+            }
+            else
+            {
+                partition->Size++;
+            }
+        }
+
+        if (entry == nullptr)
+        {
+            try
+            {
+                entry = Create(*partition);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                partition->Size--;
+                partition->Available.notify_one();
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.ColdCheckouts++;
+        }
+        else if (!entry->Connected->load())
+        {
+            // The synthesizer connects on first use anyway, this only starts it as early as possible.
+            Reopen(*entry);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.ColdCheckouts++;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.WarmCheckouts++;
+        }
+
+        // Idle synthesizers are replenished in the background.
+        m_wake.notify_all();
+        return Lease(this, std::move(entry));
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    size_t IdleCount(const std::string& voice, Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat format)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto partition = m_partitions.find(Key(voice, format));
+        return partition == m_partitions.end() ? 0 : partition->second->Idle.size();
+    }
+
+private:
+    static std::string Key(const std::string& voice, Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat format)
+    {
+        return std::to_string(static_cast<int>(format)) + "|" + voice;
+    }
+
+    // Must be called with the pool locked. Partitions are never removed, so the reference stays valid.
+    Partition& GetPartition(const std::string& voice, Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat format)
+    {
+        // Only inserted once built, so a config factory that throws or returns null leaves no empty partition behind.
+        auto key = Key(voice, format);
+        auto existing = m_partitions.find(key);
+        if (existing != m_partitions.end())
+        {
+            return *existing->second;
+        }
+
+        auto config = m_configFactory();
+        if (!config)
+        {
+            throw std::invalid_argument("Speech config is null");
+        }
+        config->SetSpeechSynthesisVoiceName(voice);
+        config->SetSpeechSynthesisOutputFormat(format);
+
+        std::unique_ptr<Partition> partition(new Partition());
+        partition->Voice = voice;
+        partition->Format = format;
+        partition->Config = config;
+        return *(m_partitions[key] = std::move(partition));
+    }
+
+    std::shared_ptr<Entry> Create(Partition& partition)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto entry = std::make_shared<Entry>();
+        entry->Owner = &partition;
+        entry->Synthesizer = SpeechSynthesizer::FromConfig(partition.Config, m_audioConfig ? m_audioConfig() : nullptr);
+        entry->Connection = Connection::FromSpeechSynthesizer(entry->Synthesizer);
+        entry->Connected = std::make_shared<std::atomic<bool>>(false);
+        entry->Failed = std::make_shared<std::atomic<bool>>(false);
+
+        auto connected = entry->Connected;
+        entry->Connection->Connected += [connected](const ConnectionEventArgs& e)
+        {
+            UNUSED(e);
+            connected->store(true);
+        };
+        entry->Connection->Disconnected += [connected](const ConnectionEventArgs& e)
+        {
+            UNUSED(e);
+            connected->store(false);
+        };
+
+        // An invalid request (e.g. malformed SSML) does not break the synthesizer, other errors are not worth retrying on it.
+        auto failed = entry->Failed;
+        entry->Synthesizer->SynthesisCanceled += [failed](const SpeechSynthesisEventArgs& e)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(e.Result);
+            if (cancellation && cancellation->Reason == CancellationReason::Error && cancellation->ErrorCode != CancellationErrorCode::BadRequest)
+            {
+                failed->store(true);
+            }
+        };
+
+        entry->Connection->Open(false);
+        entry->LastUsed = Clock::now();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.Created++;
+        return entry;
+    }
+
+    void Reopen(Entry& entry)
+    {
+        try
+        {
+            entry.Connection->Open(false);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.Reopened++;
+        }
+        catch (const std::exception&)
+        {
+            // The synthesizer reports the error when it is used, the connection is retried then.
+        }
+    }
+
+    static void Close(Entry& entry)
+    {
+        try
+        {
+            entry.Connection->Close();
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+
+    void Release(std::shared_ptr<Entry> entry, bool healthy)
+    {
+        auto& partition = *entry->Owner;
+        bool failed = entry->Failed->load();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (healthy && !failed && !m_stopping)
+            {
+                entry->LastUsed = Clock::now();
+                partition.Idle.push_back(entry);
+                entry = nullptr;
+            }
+            else
+            {
+                partition.Size--;
+                m_stats.Evicted++;
+                if (failed)
+                {
+                    m_stats.Unhealthy++;
+                }
+            }
+            partition.Available.notify_one();
+        }
+        if (entry != nullptr)
+        {
+            // A replacement is connected in the background.
+            m_wake.notify_all();
+            Close(*entry);
+        }
+    }
+
+    void MaintenanceLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            std::vector<std::shared_ptr<Entry>> evicted;
+            std::vector<std::shared_ptr<Entry>> disconnected;
+            std::vector<Partition*> missing;
+            auto now = Clock::now();
+            for (auto& item : m_partitions)
+            {
+                auto& partition = *item.second;
+
+                // Evicts synthesizers idle for too long, starting with the least recently used.
+                while (partition.Idle.size() > m_options.MinIdle && now - partition.Idle.front()->LastUsed > m_options.IdleTimeout)
+                {
+                    evicted.push_back(partition.Idle.front());
+                    partition.Idle.pop_front();
+                    partition.Size--;
+                    m_stats.Evicted++;
+                }
+
+                // Probes the idle synthesizers, and reconnects the ones the service disconnected.
+                for (auto& entry : partition.Idle)
+                {
+                    if (!entry->Connected->load())
+                    {
+                        disconnected.push_back(entry);
+                    }
+                }
+
+                // Tops up the idle synthesizers.
+                for (size_t idle = partition.Idle.size(); idle < m_options.MinIdle && partition.Size < m_options.MaxSize; idle++)
+                {
+                    missing.push_back(&partition);
+                    partition.Size++;
+                }
+            }
+
+            lock.unlock();
+            for (auto& entry : evicted)
+            {
+                Close(*entry);
+            }
+            for (auto& entry : disconnected)
+            {
+                Reopen(*entry);
+            }
+            std::vector<std::shared_ptr<Entry>> created;
+            for (auto partition : missing)
+            {
+                try
+                {
+                    created.push_back(Create(*partition));
+                }
+                catch (const std::exception&)
+                {
+                    // Retried at the next probe.
+                    created.push_back(nullptr);
+                }
+            }
+            lock.lock();
+
+            bool failed = false;
+            for (size_t i = 0; i < missing.size(); i++)
+            {
+                if (created[i] == nullptr)
+                {
+                    missing[i]->Size--;
+                    failed = true;
+                }
+                else
+                {
+                    missing[i]->Idle.push_back(created[i]);
+                }
+                missing[i]->Available.notify_one();
+            }
+
+            // Wakes up at the next probe, or when a checkout leaves too few idle synthesizers in a partition.
+            // After a failure to create a synthesizer, waits for the next probe to not retry in a tight loop.
+            m_wake.wait_for(lock, m_options.ProbeInterval, [this, failed] { return m_stopping || (!failed && NeedsTopUp()); });
+        }
+
+        // Wakes up the checkouts still waiting, they fail.
+        for (auto& item : m_partitions)
+        {
+            item.second->Available.notify_all();
+        }
+    }
+
+    // Must be called with the pool locked.
+    bool NeedsTopUp() const
+    {
+        for (const auto& item : m_partitions)
+        {
+            if (item.second->Idle.size() < m_options.MinIdle && item.second->Size < m_options.MaxSize)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ConfigFactory m_configFactory;
+    const Options m_options;
+    AudioConfigFactory m_audioConfig;
+
+    std::mutex m_mutex;
+    // Notified when the maintenance thread may have work to do.
+    std::condition_variable m_wake;
+    std::map<std::string, std::unique_ptr<Partition>> m_partitions;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    std::thread m_maintenance;
+};
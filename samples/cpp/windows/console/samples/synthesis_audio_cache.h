@@ -0,0 +1,429 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "latency_histogram.h"
+#include "mapped_file.h"
+
+// The audio of a synthesis, in the output format of the synthesizer, held in memory or mapped from the disk cache.
+class CachedSynthesisAudio final
+{
+public:
+    explicit CachedSynthesisAudio(std::shared_ptr<const std::vector<uint8_t>> audio)
+        : m_memory(std::move(audio)), m_data(m_memory->data()), m_size(m_memory->size())
+    {
+    }
+
+    CachedSynthesisAudio(std::shared_ptr<const MappedFile> file, size_t offset)
+        : m_file(std::move(file)), m_data(m_file->Data() + offset), m_size(m_file->Size() - offset)
+    {
+    }
+
+    CachedSynthesisAudio(const CachedSynthesisAudio&) = delete;
+    CachedSynthesisAudio& operator=(const CachedSynthesisAudio&) = delete;
+
+    const uint8_t* Data() const
+    {
+        return m_data;
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    // Writes the audio to a push audio output stream callback, in chunks, the way the synthesizer would.
+    void WriteTo(Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback& stream, uint32_t chunkSize = 3200) const
+    {
+        for (size_t position = 0; position < m_size; position += chunkSize)
+        {
+            auto size = static_cast<uint32_t>(std::min<size_t>(chunkSize, m_size - position));
+            stream.Write(const_cast<uint8_t*>(m_data + position), size);
+        }
+    }
+
+    // Writes the audio as is, e.g. a WAV file for the Riff output formats.
+    bool SaveToFile(const std::string& fileName) const
+    {
+        std::ofstream file(fileName, std::ios_base::binary);
+        file.write(reinterpret_cast<const char*>(m_data), static_cast<std::streamsize>(m_size));
+        return file.good();
+    }
+
+private:
+    std::shared_ptr<const std::vector<uint8_t>> m_memory;
+    std::shared_ptr<const MappedFile> m_file;
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+// Reads cached audio with the methods of AudioDataStream, so the code reading a synthesis result stream can read a cache hit.
+class CachedAudioStream final
+{
+public:
+    explicit CachedAudioStream(std::shared_ptr<const CachedSynthesisAudio> audio)
+        : m_audio(std::move(audio))
+    {
+    }
+
+    Microsoft::CognitiveServices::Speech::StreamStatus GetStatus() const
+    {
+        return Microsoft::CognitiveServices::Speech::StreamStatus::AllData;
+    }
+
+    bool CanReadData(uint32_t bytesRequested) const
+    {
+        return m_position + bytesRequested <= m_audio->Size();
+    }
+
+    uint32_t ReadData(uint8_t* buffer, uint32_t bufferSize)
+    {
+        auto size = static_cast<uint32_t>(std::min<size_t>(bufferSize, m_audio->Size() - m_position));
+        memcpy(buffer, m_audio->Data() + m_position, size);
+        m_position += size;
+        return size;
+    }
+
+    uint32_t GetPosition() const
+    {
+        return static_cast<uint32_t>(m_position);
+    }
+
+    void SetPosition(uint32_t position)
+    {
+        m_position = std::min<size_t>(position, m_audio->Size());
+    }
+
+private:
+    std::shared_ptr<const CachedSynthesisAudio> m_audio;
+    size_t m_position = 0;
+};
+
+enum class SynthesisCacheSource
+{
+    Memory,
+    Disk,
+    Service
+};
+
+struct CachedSynthesisResult
+{
+    // Null if the synthesis failed.
+    std::shared_ptr<const CachedSynthesisAudio> Audio;
+    SynthesisCacheSource Source = SynthesisCacheSource::Service;
+    // The result of the synthesizer, only when the audio comes from the service, e.g. for the cancellation details.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesisResult> Result;
+};
+
+// Two-tier cache of synthesized audio, for prompts that are spoken again and again (e.g. IVR prompts):
+// a least recently used cache in memory, bounded in bytes, in front of a persistent store on disk with one file per
+// entry, mapped into memory when read. Entries are keyed by the voice, the output format and the canonical text or
+// SSML (so prosody, style and the like, which are part of the SSML, are part of the key too).
+// The disk store is never evicted, the directory must exist and is managed by the application.
+// Thread safe: concurrent requests for the same missing entry each go to the service.
+class SynthesisAudioCache final
+{
+public:
+    struct Options
+    {
+        size_t MemoryCapacity = 64 * 1024 * 1024;
+        // The directory of the disk store, none if empty.
+        std::string Directory;
+    };
+
+    SynthesisAudioCache(Options options)
+        : m_options(std::move(options))
+    {
+    }
+
+    SynthesisAudioCache(const SynthesisAudioCache&) = delete;
+    SynthesisAudioCache& operator=(const SynthesisAudioCache&) = delete;
+
+    // Speaks the text with the synthesizer, which has no audio output (e.g. FromConfig(config, nullptr)), unless the audio is cached.
+    // The voice and the output format of the key are the synthesizer's own.
+    CachedSynthesisResult SpeakText(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer, const std::string& text)
+    {
+        return Speak(MakeKey(synthesizer, "text", CanonicalText(text)), [&synthesizer, &text] { return synthesizer.SpeakTextAsync(text).get(); });
+    }
+
+    CachedSynthesisResult SpeakSsml(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer, const std::string& ssml)
+    {
+        return Speak(MakeKey(synthesizer, "ssml", CanonicalText(ssml)), [&synthesizer, &ssml] { return synthesizer.SpeakSsmlAsync(ssml).get(); });
+    }
+
+    // Trims the text or SSML and collapses runs of whitespace into one space, which does not change what is spoken.
+    // Whitespace between tags is kept, it may separate words.
+    static std::string CanonicalText(const std::string& text)
+    {
+        std::string canonical;
+        canonical.reserve(text.size());
+        bool space = false;
+        for (auto c : text)
+        {
+            if (IsSpace(c))
+            {
+                space = true;
+                continue;
+            }
+            if (space && !canonical.empty())
+            {
+                canonical += ' ';
+            }
+            space = false;
+            canonical += c;
+        }
+        return canonical;
+    }
+
+    // 64-bit FNV-1a.
+    static uint64_t Hash(const std::string& key)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (auto c : key)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    uint64_t MemoryHits() const { return m_memoryHits; }
+    uint64_t DiskHits() const { return m_diskHits; }
+    uint64_t Misses() const { return m_misses; }
+    uint64_t Failures() const { return m_failures; }
+    uint64_t Evictions() const { return m_evictions; }
+
+    // Time to get the audio, in microseconds, from the cache and from the service.
+    const LatencyHistogram& HitLatency() const { return m_hitLatency; }
+    const LatencyHistogram& MissLatency() const { return m_missLatency; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string Key;
+        std::shared_ptr<const CachedSynthesisAudio> Audio;
+    };
+
+    // A disk entry starts with this magic, followed by the key size (uint32_t), the key and the audio.
+    static const char* DiskMagic()
+    {
+        return "SPTC";
+    }
+    static constexpr size_t DiskMagicSize = 4;
+
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+    }
+
+    static std::string MakeKey(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer, const char* kind, const std::string& content)
+    {
+        using Microsoft::CognitiveServices::Speech::PropertyId;
+
+        // Without a voice name, the default voice of the language is used.
+        auto& properties = synthesizer.Properties;
+        auto voice = properties.GetProperty(PropertyId::SpeechServiceConnection_SynthVoice);
+        if (voice.empty())
+        {
+            voice = properties.GetProperty(PropertyId::SpeechServiceConnection_SynthLanguage);
+        }
+        return std::string(kind) + '\n' + voice + '\n' + properties.GetProperty(PropertyId::SpeechServiceConnection_SynthOutputFormat) + '\n' + content;
+    }
+
+    template<typename SynthesizeT>
+    CachedSynthesisResult Speak(const std::string& key, SynthesizeT&& synthesize)
+    {
+        auto start = Clock::now();
+        auto hash = Hash(key);
+        CachedSynthesisResult result;
+
+        result.Audio = FindInMemory(hash, key);
+        result.Source = SynthesisCacheSource::Memory;
+        if (!result.Audio)
+        {
+            result.Audio = FindOnDisk(hash, key);
+            result.Source = SynthesisCacheSource::Disk;
+            if (result.Audio)
+            {
+                StoreInMemory(hash, key, result.Audio);
+            }
+        }
+        if (result.Audio)
+        {
+            (result.Source == SynthesisCacheSource::Memory ? m_memoryHits : m_diskHits)++;
+            m_hitLatency.Record(Microseconds(start));
+            return result;
+        }
+
+        result.Source = SynthesisCacheSource::Service;
+        result.Result = synthesize();
+        if (!result.Result || result.Result->Reason != Microsoft::CognitiveServices::Speech::ResultReason::SynthesizingAudioCompleted)
+        {
+            m_failures++;
+            return result;
+        }
+        auto audio = std::shared_ptr<const std::vector<uint8_t>>(result.Result->GetAudioData());
+        if (!audio || audio->empty())
+        {
+            m_failures++;
+            return result;
+        }
+
+        m_misses++;
+        m_missLatency.Record(Microseconds(start));
+        result.Audio = std::make_shared<CachedSynthesisAudio>(audio);
+        StoreInMemory(hash, key, result.Audio);
+        StoreOnDisk(hash, key, *audio);
+        return result;
+    }
+
+    static uint64_t Microseconds(Clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    }
+
+    std::shared_ptr<const CachedSynthesisAudio> FindInMemory(uint64_t hash, const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(hash);
+        if (found == m_index.end() || found->second->Key != key)
+        {
+            return nullptr;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return found->second->Audio;
+    }
+
+    void StoreInMemory(uint64_t hash, const std::string& key, std::shared_ptr<const CachedSynthesisAudio> audio)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(hash);
+        if (found != m_index.end())
+        {
+            // Same key stored concurrently, or a hash collision, in which case the newest entry wins.
+            m_memorySize -= found->second->Audio->Size();
+            m_entries.erase(found->second);
+            m_index.erase(found);
+        }
+
+        m_memorySize += audio->Size();
+        m_entries.push_front(Entry{ key, std::move(audio) });
+        m_index[hash] = m_entries.begin();
+        while (m_memorySize > m_options.MemoryCapacity && m_entries.size() > 1)
+        {
+            auto& last = m_entries.back();
+            m_memorySize -= last.Audio->Size();
+            m_index.erase(Hash(last.Key));
+            m_entries.pop_back();
+            m_evictions++;
+        }
+    }
+
+    std::string DiskFileName(uint64_t hash) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.tts", static_cast<unsigned long long>(hash));
+        return m_options.Directory + "/" + name;
+    }
+
+    std::shared_ptr<const CachedSynthesisAudio> FindOnDisk(uint64_t hash, const std::string& key) const
+    {
+        if (m_options.Directory.empty())
+        {
+            return nullptr;
+        }
+
+        std::shared_ptr<const MappedFile> file;
+        try
+        {
+            file = std::make_shared<MappedFile>(DiskFileName(hash));
+        }
+        catch (const std::runtime_error&)
+        {
+            return nullptr;
+        }
+
+        // The key is checked, so a hash collision is a miss.
+        auto data = file->Data();
+        uint32_t keySize = 0;
+        if (file->Size() < DiskMagicSize + sizeof(keySize) || memcmp(data, DiskMagic(), DiskMagicSize) != 0)
+        {
+            return nullptr;
+        }
+        memcpy(&keySize, data + DiskMagicSize, sizeof(keySize));
+        auto audioOffset = DiskMagicSize + sizeof(keySize) + static_cast<size_t>(keySize);
+        if (keySize != key.size() || audioOffset >= file->Size() || memcmp(data + DiskMagicSize + sizeof(keySize), key.data(), keySize) != 0)
+        {
+            return nullptr;
+        }
+        return std::make_shared<CachedSynthesisAudio>(file, audioOffset);
+    }
+
+    void StoreOnDisk(uint64_t hash, const std::string& key, const std::vector<uint8_t>& audio) const
+    {
+        if (m_options.Directory.empty())
+        {
+            return;
+        }
+
+        // Written to a temporary file first, so a reader never maps a partial entry. The name is unique to the thread,
+        // and random, as other processes may share the directory.
+        auto fileName = DiskFileName(hash);
+        auto temporaryName = fileName + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+            std::to_string(std::random_device()()) + ".tmp";
+        {
+            std::ofstream file(temporaryName, std::ios_base::binary);
+            auto keySize = static_cast<uint32_t>(key.size());
+            file.write(DiskMagic(), DiskMagicSize);
+            file.write(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+            file.write(key.data(), static_cast<std::streamsize>(key.size()));
+            file.write(reinterpret_cast<const char*>(audio.data()), static_cast<std::streamsize>(audio.size()));
+            if (!file.good())
+            {
+                file.close();
+                std::remove(temporaryName.c_str());
+                return;
+            }
+        }
+        // Fails on Windows if the entry exists already, e.g. written concurrently, which is fine.
+        if (std::rename(temporaryName.c_str(), fileName.c_str()) != 0)
+        {
+            std::remove(temporaryName.c_str());
+        }
+    }
+
+    const Options m_options;
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;     // most recently used first.
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+    size_t m_memorySize = 0;
+
+    std::atomic<uint64_t> m_memoryHits{ 0 };
+    std::atomic<uint64_t> m_diskHits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+    std::atomic<uint64_t> m_failures{ 0 };
+    std::atomic<uint64_t> m_evictions{ 0 };
+    LatencyHistogram m_hitLatency;
+    LatencyHistogram m_missLatency;
+};
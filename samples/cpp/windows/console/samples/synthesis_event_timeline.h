@@ -0,0 +1,346 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The word boundary, viseme and bookmark events of a synthesis, stored as time-indexed columns (one array per field),
+// e.g. to drive an avatar in sync with the audio playback.
+// Each kind of event is kept in audio offset order, so the event at a playback position is found by binary search, without
+// allocating. The columns are preallocated for the expected number of events, and Clear() keeps their capacity, so a
+// timeline reused across prompts does not allocate either once it has grown to the longest prompt.
+// The timeline is not synchronized: add the events of one synthesis (the synthesizer raises them one at a time), and look
+// them up once it has completed.
+class SynthesisEventTimeline final
+{
+public:
+    // Returned by the lookups when no event starts at or before the playback position.
+    static const size_t NotFound = static_cast<size_t>(-1);
+
+    SynthesisEventTimeline(size_t expectedWords = 256, size_t expectedVisemes = 1024, size_t expectedBookmarks = 16)
+    {
+        Reserve(expectedWords, expectedVisemes, expectedBookmarks);
+    }
+
+    void Reserve(size_t words, size_t visemes, size_t bookmarks)
+    {
+        m_wordAudioOffsets.reserve(words);
+        m_wordTextOffsets.reserve(words);
+        m_wordLengths.reserve(words);
+        m_visemeAudioOffsets.reserve(visemes);
+        m_visemeIds.reserve(visemes);
+        m_bookmarkAudioOffsets.reserve(bookmarks);
+        m_bookmarkIds.reserve(bookmarks);
+    }
+
+    // Removes all the events, and keeps the capacity of the columns.
+    void Clear()
+    {
+        m_wordAudioOffsets.clear();
+        m_wordTextOffsets.clear();
+        m_wordLengths.clear();
+        m_visemeAudioOffsets.clear();
+        m_visemeIds.clear();
+        m_bookmarkAudioOffsets.clear();
+        m_bookmarkIds.clear();
+        m_bookmarkNames.clear();
+        m_bookmarkIndex.clear();
+    }
+
+    void Add(const Microsoft::CognitiveServices::Speech::SpeechSynthesisWordBoundaryEventArgs& e)
+    {
+        AddWordBoundary(e.AudioOffset, e.TextOffset, e.WordLength);
+    }
+
+    void Add(const Microsoft::CognitiveServices::Speech::SpeechSynthesisVisemeEventArgs& e)
+    {
+        AddViseme(e.AudioOffset, e.VisemeId);
+    }
+
+    void Add(const Microsoft::CognitiveServices::Speech::SpeechSynthesisBookmarkEventArgs& e)
+    {
+        AddBookmark(e.AudioOffset, e.Text);
+    }
+
+    // Audio offsets are in ticks (100 nanoseconds), as in the events.
+    void AddWordBoundary(uint64_t audioOffset, uint32_t textOffset, uint32_t wordLength)
+    {
+        auto index = InsertionPoint(m_wordAudioOffsets, audioOffset);
+        Insert(m_wordAudioOffsets, index, audioOffset);
+        Insert(m_wordTextOffsets, index, textOffset);
+        Insert(m_wordLengths, index, wordLength);
+    }
+
+    void AddViseme(uint64_t audioOffset, uint32_t visemeId)
+    {
+        auto index = InsertionPoint(m_visemeAudioOffsets, audioOffset);
+        Insert(m_visemeAudioOffsets, index, audioOffset);
+        Insert(m_visemeIds, index, static_cast<uint16_t>(visemeId));
+    }
+
+    // Bookmarks are stored by id, the index of their name in BookmarkNames(), so repeated bookmarks are stored once.
+    void AddBookmark(uint64_t audioOffset, const std::string& name)
+    {
+        auto id = m_bookmarkIndex.emplace(name, static_cast<uint32_t>(m_bookmarkNames.size()));
+        if (id.second)
+        {
+            m_bookmarkNames.push_back(name);
+        }
+        auto index = InsertionPoint(m_bookmarkAudioOffsets, audioOffset);
+        Insert(m_bookmarkAudioOffsets, index, audioOffset);
+        Insert(m_bookmarkIds, index, id.first->second);
+    }
+
+    // Index of the word being spoken at the playback position, i.e. the last one starting at or before it.
+    size_t WordAt(uint64_t audioOffset) const
+    {
+        return LastAtOrBefore(m_wordAudioOffsets, audioOffset);
+    }
+
+    // Index of the viseme shown at the playback position, i.e. the last one starting at or before it.
+    size_t VisemeAt(uint64_t audioOffset) const
+    {
+        return LastAtOrBefore(m_visemeAudioOffsets, audioOffset);
+    }
+
+    // Range [first, last) of the bookmarks reached from 'from' and before 'to', e.g. within the frame being rendered.
+    std::pair<size_t, size_t> BookmarksBetween(uint64_t from, uint64_t to) const
+    {
+        auto first = std::lower_bound(m_bookmarkAudioOffsets.begin(), m_bookmarkAudioOffsets.end(), from);
+        auto last = std::lower_bound(first, m_bookmarkAudioOffsets.end(), std::max(from, to));
+        return std::make_pair(static_cast<size_t>(first - m_bookmarkAudioOffsets.begin()), static_cast<size_t>(last - m_bookmarkAudioOffsets.begin()));
+    }
+
+    const std::vector<uint64_t>& WordAudioOffsets() const { return m_wordAudioOffsets; }
+    const std::vector<uint32_t>& WordTextOffsets() const { return m_wordTextOffsets; }
+    const std::vector<uint32_t>& WordLengths() const { return m_wordLengths; }
+    const std::vector<uint64_t>& VisemeAudioOffsets() const { return m_visemeAudioOffsets; }
+    const std::vector<uint16_t>& VisemeIds() const { return m_visemeIds; }
+    const std::vector<uint64_t>& BookmarkAudioOffsets() const { return m_bookmarkAudioOffsets; }
+    const std::vector<uint32_t>& BookmarkIds() const { return m_bookmarkIds; }
+    const std::vector<std::string>& BookmarkNames() const { return m_bookmarkNames; }
+
+    // Appends the timeline to 'output' in a compact binary format: a "SETL" tag and a version byte, then the counts and
+    // the columns one after the other. Offsets are stored as deltas from the previous event, all the numbers as LEB128
+    // variable-length integers, so most events take 2 to 4 bytes.
+    void Serialize(std::vector<uint8_t>& output) const
+    {
+        output.insert(output.end(), { 'S', 'E', 'T', 'L', FormatVersion });
+        WriteNumber(output, m_wordAudioOffsets.size());
+        WriteNumber(output, m_visemeAudioOffsets.size());
+        WriteNumber(output, m_bookmarkAudioOffsets.size());
+        WriteNumber(output, m_bookmarkNames.size());
+
+        WriteDeltas(output, m_wordAudioOffsets);
+        // Text offsets usually grow with audio offsets, but not always (e.g. with SSML), so their deltas are zigzag encoded.
+        uint32_t previous = 0;
+        for (auto textOffset : m_wordTextOffsets)
+        {
+            auto delta = static_cast<int64_t>(textOffset) - previous;
+            WriteNumber(output, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+            previous = textOffset;
+        }
+        WriteNumbers(output, m_wordLengths);
+
+        WriteDeltas(output, m_visemeAudioOffsets);
+        WriteNumbers(output, m_visemeIds);
+
+        WriteDeltas(output, m_bookmarkAudioOffsets);
+        WriteNumbers(output, m_bookmarkIds);
+        for (const auto& name : m_bookmarkNames)
+        {
+            WriteNumber(output, name.size());
+            output.insert(output.end(), name.begin(), name.end());
+        }
+    }
+
+    // Reads a timeline written by Serialize(). Throws std::runtime_error if the data is invalid or truncated.
+    static SynthesisEventTimeline Deserialize(const uint8_t* data, size_t size)
+    {
+        Reader reader{ data, data + size };
+        const uint8_t header[] = { 'S', 'E', 'T', 'L', FormatVersion };
+        if (size < sizeof(header) || !std::equal(header, header + sizeof(header), data))
+        {
+            throw std::runtime_error("Invalid timeline data, tag 'SETL' version 1 is expected.");
+        }
+        reader.Position += sizeof(header);
+
+        // Each value takes at least one byte, which bounds the counts before anything is allocated.
+        auto words = reader.ReadCount();
+        auto visemes = reader.ReadCount();
+        auto bookmarks = reader.ReadCount();
+        auto names = reader.ReadCount();
+
+        SynthesisEventTimeline timeline(words, visemes, bookmarks);
+        reader.ReadDeltas(timeline.m_wordAudioOffsets, words);
+        uint32_t previous = 0;
+        for (size_t i = 0; i < words; i++)
+        {
+            auto zigzag = reader.ReadNumber();
+            auto delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            previous = static_cast<uint32_t>(previous + delta);
+            timeline.m_wordTextOffsets.push_back(previous);
+        }
+        reader.ReadNumbers(timeline.m_wordLengths, words);
+
+        reader.ReadDeltas(timeline.m_visemeAudioOffsets, visemes);
+        reader.ReadNumbers(timeline.m_visemeIds, visemes);
+
+        reader.ReadDeltas(timeline.m_bookmarkAudioOffsets, bookmarks);
+        reader.ReadNumbers(timeline.m_bookmarkIds, bookmarks);
+        for (size_t i = 0; i < names; i++)
+        {
+            auto length = reader.ReadCount();
+            timeline.m_bookmarkNames.emplace_back(reinterpret_cast<const char*>(reader.Position), length);
+            timeline.m_bookmarkIndex.emplace(timeline.m_bookmarkNames.back(), static_cast<uint32_t>(i));
+            reader.Position += length;
+        }
+        for (auto id : timeline.m_bookmarkIds)
+        {
+            if (id >= names)
+            {
+                throw std::runtime_error("Invalid timeline data, unknown bookmark id.");
+            }
+        }
+        return timeline;
+    }
+
+private:
+    static const uint8_t FormatVersion = 1;
+
+    struct Reader
+    {
+        const uint8_t* Position;
+        const uint8_t* End;
+
+        uint64_t ReadNumber()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (Position == End)
+                {
+                    throw std::runtime_error("Invalid timeline data, unexpected end of data.");
+                }
+                auto byte = *Position++;
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+            throw std::runtime_error("Invalid timeline data, number too long.");
+        }
+
+        // A count of values or bytes that follow, so it cannot be more than the bytes left.
+        size_t ReadCount()
+        {
+            auto count = ReadNumber();
+            if (count > static_cast<uint64_t>(End - Position))
+            {
+                throw std::runtime_error("Invalid timeline data, unexpected end of data.");
+            }
+            return static_cast<size_t>(count);
+        }
+
+        template<class T>
+        void ReadNumbers(std::vector<T>& column, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                column.push_back(static_cast<T>(ReadNumber()));
+            }
+        }
+
+        void ReadDeltas(std::vector<uint64_t>& column, size_t count)
+        {
+            uint64_t offset = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                offset += ReadNumber();
+                column.push_back(offset);
+            }
+        }
+    };
+
+    // After the events at the same offset, so events at the same offset keep their arrival order.
+    static size_t InsertionPoint(const std::vector<uint64_t>& offsets, uint64_t offset)
+    {
+        // Events come in order, so this is the end but for the rare late event.
+        if (offsets.empty() || offsets.back() <= offset)
+        {
+            return offsets.size();
+        }
+        return static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), offset) - offsets.begin());
+    }
+
+    template<class T>
+    static void Insert(std::vector<T>& column, size_t index, T value)
+    {
+        if (index == column.size())
+        {
+            column.push_back(value);
+        }
+        else
+        {
+            column.insert(column.begin() + index, value);
+        }
+    }
+
+    static size_t LastAtOrBefore(const std::vector<uint64_t>& offsets, uint64_t offset)
+    {
+        auto next = std::upper_bound(offsets.begin(), offsets.end(), offset);
+        return next == offsets.begin() ? NotFound : static_cast<size_t>(next - offsets.begin()) - 1;
+    }
+
+    static void WriteNumber(std::vector<uint8_t>& output, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            output.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        output.push_back(static_cast<uint8_t>(value));
+    }
+
+    template<class T>
+    static void WriteNumbers(std::vector<uint8_t>& output, const std::vector<T>& column)
+    {
+        for (auto value : column)
+        {
+            WriteNumber(output, value);
+        }
+    }
+
+    static void WriteDeltas(std::vector<uint8_t>& output, const std::vector<uint64_t>& column)
+    {
+        uint64_t previous = 0;
+        for (auto offset : column)
+        {
+            WriteNumber(output, offset - previous);
+            previous = offset;
+        }
+    }
+
+    // Word boundaries, in audio offset order.
+    std::vector<uint64_t> m_wordAudioOffsets;
+    std::vector<uint32_t> m_wordTextOffsets;
+    std::vector<uint32_t> m_wordLengths;
+    // Visemes, in audio offset order.
+    std::vector<uint64_t> m_visemeAudioOffsets;
+    std::vector<uint16_t> m_visemeIds;
+    // Bookmarks, in audio offset order.
+    std::vector<uint64_t> m_bookmarkAudioOffsets;
+    std::vector<uint32_t> m_bookmarkIds;
+    std::vector<std::string> m_bookmarkNames;
+    std::map<std::string, uint32_t> m_bookmarkIndex;
+};
@@ -0,0 +1,32 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <cstdint>
+
+// Bytes per second of a raw synthesis output format without header, whose audio can be concatenated, cut into frames
+// and paced. 0 for any other format: with a header (Riff), or compressed (MP3, Opus, ...).
+inline uint32_t RawSynthesisBytesPerSecond(Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat format)
+{
+    using Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat;
+
+    switch (format)
+    {
+    case SpeechSynthesisOutputFormat::Raw8Khz8BitMonoMULaw:
+    case SpeechSynthesisOutputFormat::Raw8Khz8BitMonoALaw:
+        return 8000;
+    case SpeechSynthesisOutputFormat::Raw8Khz16BitMonoPcm:
+        return 16000;
+    case SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm:
+        return 32000;
+    case SpeechSynthesisOutputFormat::Raw24Khz16BitMonoPcm:
+        return 48000;
+    case SpeechSynthesisOutputFormat::Raw48Khz16BitMonoPcm:
+        return 96000;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,468 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "mapped_file.h"
+
+// Compact binary format for recognition results, read back from the mapped file without copying the records.
+// All values are little endian.
+//
+// File header (16 bytes):
+//   0  char[4]   Magic "SPTR"
+//   4  uint16    Version, readers reject versions newer than their own
+//   6  uint16    HeaderSize, the records start right after it
+//   8  uint32    Reserved
+//   12 uint32    Reserved
+//
+// Record (aligned to 8 bytes):
+//   0  uint32    Size of the record in bytes, including padding. Readers skip fields they do not know.
+//   4  uint16    NBestCount
+//   6  uint16    Reason (ResultReason of the result)
+//   8  uint64    Offset, in ticks (1 tick = 100 nanoseconds)
+//   16 uint64    Duration, in ticks
+//   24 float     Confidence of the first alternative, or 0 if not known
+//   28 uint32    TextLength
+//   32 char[]    Text, UTF-8, not null-terminated
+//   then, aligned to 4 bytes, NBestCount entries of
+//      float     Confidence
+//      uint32    TextOffset, from the start of the record
+//      uint32    TextLength
+//   then the texts of the alternatives.
+namespace TranscriptFormat
+{
+    constexpr char Magic[4] = { 'S', 'P', 'T', 'R' };
+    constexpr uint16_t Version = 1;
+    constexpr uint16_t FileHeaderSize = 16;
+    constexpr uint32_t RecordHeaderSize = 32;
+    constexpr uint32_t NBestEntrySize = 12;
+
+    inline uint32_t Align(uint32_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Integers are encoded byte by byte, so the files are little endian whatever the byte order of the host.
+    template<typename T>
+    inline T Read(const uint8_t* data)
+    {
+        static_assert(std::is_integral<T>::value, "Integers and float only");
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            value |= static_cast<uint64_t>(data[i]) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    template<typename T>
+    inline void Write(uint8_t* data, T value)
+    {
+        static_assert(std::is_integral<T>::value, "Integers and float only");
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            data[i] = static_cast<uint8_t>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff);
+        }
+    }
+
+    // A float is stored as the bits of an IEEE 754 single, in the byte order of an integer.
+    template<>
+    inline float Read<float>(const uint8_t* data)
+    {
+        auto bits = Read<uint32_t>(data);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    template<>
+    inline void Write<float>(uint8_t* data, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        Write<uint32_t>(data, bits);
+    }
+}
+
+// A piece of text inside a transcript buffer, valid as long as the buffer.
+struct TranscriptText
+{
+    const char* Data = nullptr;
+    size_t Size = 0;
+
+    std::string ToString() const { return std::string(Data, Size); }
+};
+
+// One alternative recognition of a result, from the NBest array of the detailed output format.
+struct TranscriptAlternative
+{
+    float Confidence = 0;
+    std::string Text;
+};
+
+// Builds the transcript records of a session into large blocks of memory, one record right after the other, so
+// appending a result costs no allocation per record and saving the session is a sequence of block writes.
+// Not thread safe, use one arena per session (the events of a recognizer are raised one at a time).
+class TranscriptArena final
+{
+public:
+    explicit TranscriptArena(size_t blockSize = 256 * 1024) : m_blockSize(blockSize)
+    {
+    }
+
+    TranscriptArena(const TranscriptArena&) = delete;
+    TranscriptArena& operator=(const TranscriptArena&) = delete;
+
+    // Appends a recognition result. The alternatives and their confidence are read from the detailed JSON result,
+    // if the config was set to OutputFormat::Detailed.
+    void Append(const Microsoft::CognitiveServices::Speech::RecognitionResult& result)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        std::vector<TranscriptAlternative> alternatives;
+        auto json = nlohmann::json::parse(result.Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult), nullptr, false);
+        if (!json.is_discarded() && json.contains("NBest") && json["NBest"].is_array())
+        {
+            for (const auto& item : json["NBest"])
+            {
+                TranscriptAlternative alternative;
+                alternative.Confidence = item.value("Confidence", 0.0f);
+                alternative.Text = item.value("Display", std::string());
+                alternatives.push_back(std::move(alternative));
+            }
+        }
+
+        Append(static_cast<uint16_t>(result.Reason), result.Offset(), result.Duration(), result.Text, alternatives);
+    }
+
+    void Append(uint16_t reason, uint64_t offset, uint64_t duration, const std::string& text, const std::vector<TranscriptAlternative>& alternatives)
+    {
+        using namespace TranscriptFormat;
+
+        if (alternatives.size() > UINT16_MAX)
+        {
+            throw std::invalid_argument("Too many alternatives");
+        }
+
+        // Lays out the record: header and text, the alternatives table, and their texts.
+        auto tableOffset = Align(RecordHeaderSize + static_cast<uint32_t>(text.size()), 4);
+        auto size = tableOffset + static_cast<uint32_t>(alternatives.size()) * NBestEntrySize;
+        for (const auto& alternative : alternatives)
+        {
+            size += static_cast<uint32_t>(alternative.Text.size());
+        }
+        size = Align(size, 8);
+
+        auto record = Allocate(size);
+        memset(record, 0, size);
+        Write<uint32_t>(record + 0, size);
+        Write<uint16_t>(record + 4, static_cast<uint16_t>(alternatives.size()));
+        Write<uint16_t>(record + 6, reason);
+        Write<uint64_t>(record + 8, offset);
+        Write<uint64_t>(record + 16, duration);
+        Write<float>(record + 24, alternatives.empty() ? 0.0f : alternatives[0].Confidence);
+        Write<uint32_t>(record + 28, static_cast<uint32_t>(text.size()));
+        memcpy(record + RecordHeaderSize, text.data(), text.size());
+
+        auto textOffset = tableOffset + static_cast<uint32_t>(alternatives.size()) * NBestEntrySize;
+        for (size_t i = 0; i < alternatives.size(); i++)
+        {
+            auto entry = record + tableOffset + i * NBestEntrySize;
+            auto textLength = static_cast<uint32_t>(alternatives[i].Text.size());
+            Write<float>(entry + 0, alternatives[i].Confidence);
+            Write<uint32_t>(entry + 4, textOffset);
+            Write<uint32_t>(entry + 8, textLength);
+            memcpy(record + textOffset, alternatives[i].Text.data(), textLength);
+            textOffset += textLength;
+        }
+
+        m_recordCount++;
+    }
+
+    size_t RecordCount() const
+    {
+        return m_recordCount;
+    }
+
+    // Gets the size of the records in bytes, without the file header.
+    uint64_t Size() const
+    {
+        uint64_t size = 0;
+        for (const auto& block : m_blocks)
+        {
+            size += block.Used;
+        }
+        return size;
+    }
+
+    // Writes the file header and all records.
+    void WriteTo(std::ostream& out) const
+    {
+        uint8_t header[TranscriptFormat::FileHeaderSize] = {};
+        memcpy(header, TranscriptFormat::Magic, sizeof(TranscriptFormat::Magic));
+        TranscriptFormat::Write<uint16_t>(header + 4, TranscriptFormat::Version);
+        TranscriptFormat::Write<uint16_t>(header + 6, TranscriptFormat::FileHeaderSize);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+        for (const auto& block : m_blocks)
+        {
+            out.write(reinterpret_cast<const char*>(block.Data.get()), block.Used);
+        }
+    }
+
+    void Save(const std::string& fileName) const
+    {
+        std::ofstream file(fileName, std::ios_base::binary | std::ios_base::trunc);
+        WriteTo(file);
+        if (!file.good())
+        {
+            throw std::runtime_error("Failed to write the transcript file.");
+        }
+    }
+
+    // Removes all records, and keeps the memory for the next session.
+    void Reset()
+    {
+        for (auto& block : m_blocks)
+        {
+            block.Used = 0;
+        }
+        m_current = 0;
+        m_recordCount = 0;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> Data;
+        size_t Capacity = 0;
+        size_t Used = 0;
+    };
+
+    // Records never span blocks, a record larger than a block gets a block of its own.
+    uint8_t* Allocate(size_t size)
+    {
+        while (m_current < m_blocks.size() && m_blocks[m_current].Capacity - m_blocks[m_current].Used < size)
+        {
+            if (m_blocks[m_current].Used == 0 && m_blocks[m_current].Capacity < size)
+            {
+                // A reused block too small for this record, replaced in place to keep the order of the records.
+                m_blocks[m_current].Data.reset(new uint8_t[size]);
+                m_blocks[m_current].Capacity = size;
+                break;
+            }
+            m_current++;
+        }
+        if (m_current == m_blocks.size())
+        {
+            Block block;
+            block.Capacity = size > m_blockSize ? size : m_blockSize;
+            block.Data.reset(new uint8_t[block.Capacity]);
+            m_blocks.push_back(std::move(block));
+        }
+
+        auto& block = m_blocks[m_current];
+        auto data = block.Data.get() + block.Used;
+        block.Used += size;
+        return data;
+    }
+
+    const size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    size_t m_current = 0;
+    size_t m_recordCount = 0;
+};
+
+// A record inside a transcript buffer. Texts point into the buffer, nothing is copied.
+class TranscriptRecordView final
+{
+public:
+    explicit TranscriptRecordView(const uint8_t* data) : m_data(data) {}
+
+    uint32_t Size() const { return TranscriptFormat::Read<uint32_t>(m_data); }
+    uint16_t Reason() const { return TranscriptFormat::Read<uint16_t>(m_data + 6); }
+    uint64_t Offset() const { return TranscriptFormat::Read<uint64_t>(m_data + 8); }
+    uint64_t Duration() const { return TranscriptFormat::Read<uint64_t>(m_data + 16); }
+    float Confidence() const { return TranscriptFormat::Read<float>(m_data + 24); }
+
+    TranscriptText Text() const
+    {
+        TranscriptText text;
+        text.Data = reinterpret_cast<const char*>(m_data + TranscriptFormat::RecordHeaderSize);
+        text.Size = TranscriptFormat::Read<uint32_t>(m_data + 28);
+        return text;
+    }
+
+    size_t NBestCount() const { return TranscriptFormat::Read<uint16_t>(m_data + 4); }
+
+    float NBestConfidence(size_t index) const
+    {
+        return TranscriptFormat::Read<float>(NBestEntry(index));
+    }
+
+    TranscriptText NBestText(size_t index) const
+    {
+        auto entry = NBestEntry(index);
+        TranscriptText text;
+        text.Data = reinterpret_cast<const char*>(m_data + TranscriptFormat::Read<uint32_t>(entry + 4));
+        text.Size = TranscriptFormat::Read<uint32_t>(entry + 8);
+        return text;
+    }
+
+private:
+    friend class TranscriptReader;
+
+    const uint8_t* NBestEntry(size_t index) const
+    {
+        auto tableOffset = TranscriptFormat::Align(TranscriptFormat::RecordHeaderSize + static_cast<uint32_t>(Text().Size), 4);
+        return m_data + tableOffset + index * TranscriptFormat::NBestEntrySize;
+    }
+
+    // Checks that everything the record points to is inside its 'size' bytes.
+    bool IsValid(uint64_t available) const
+    {
+        using namespace TranscriptFormat;
+        if (available < RecordHeaderSize || Size() < RecordHeaderSize || Size() > available || Size() % 8 != 0)
+        {
+            return false;
+        }
+        auto tableEnd = static_cast<uint64_t>(Align(RecordHeaderSize + static_cast<uint32_t>(Text().Size), 4)) + NBestCount() * NBestEntrySize;
+        if (RecordHeaderSize + static_cast<uint64_t>(Text().Size) > Size() || tableEnd > Size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < NBestCount(); i++)
+        {
+            auto entry = NBestEntry(i);
+            if (static_cast<uint64_t>(Read<uint32_t>(entry + 4)) + Read<uint32_t>(entry + 8) > Size())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* m_data;
+};
+
+// Reads the records of a transcript held in memory, e.g. a mapped file. All records are validated up front,
+// so reading them afterwards needs no checks.
+class TranscriptReader
+{
+public:
+    TranscriptReader(const uint8_t* data, size_t size)
+    {
+        Open(data, size);
+    }
+
+    size_t RecordCount() const
+    {
+        return m_recordCount;
+    }
+
+    void ForEach(const std::function<void(const TranscriptRecordView& record)>& func) const
+    {
+        for (size_t position = m_begin; position < m_size; position += TranscriptRecordView(m_data + position).Size())
+        {
+            func(TranscriptRecordView(m_data + position));
+        }
+    }
+
+    // Converts the records to JSON, one object per line.
+    void WriteJsonl(std::ostream& out) const
+    {
+        ForEach([&out](const TranscriptRecordView& record)
+        {
+            nlohmann::json line;
+            line["reason"] = record.Reason();
+            line["offset"] = record.Offset();
+            line["duration"] = record.Duration();
+            line["confidence"] = record.Confidence();
+            line["text"] = record.Text().ToString();
+
+            auto nbest = nlohmann::json::array();
+            for (size_t i = 0; i < record.NBestCount(); i++)
+            {
+                nlohmann::json alternative;
+                alternative["confidence"] = record.NBestConfidence(i);
+                alternative["text"] = record.NBestText(i).ToString();
+                nbest.push_back(alternative);
+            }
+            line["nbest"] = nbest;
+
+            out << line.dump() << '\n';
+        });
+        out.flush();
+    }
+
+protected:
+    TranscriptReader() = default;
+
+    void Open(const uint8_t* data, size_t size)
+    {
+        using namespace TranscriptFormat;
+
+        if (size < FileHeaderSize || memcmp(data, Magic, sizeof(Magic)) != 0)
+        {
+            throw std::runtime_error("Not a transcript file.");
+        }
+        if (Read<uint16_t>(data + 4) > Version)
+        {
+            throw std::runtime_error("Unsupported transcript file version.");
+        }
+        auto headerSize = Read<uint16_t>(data + 6);
+        if (headerSize < FileHeaderSize || headerSize > size)
+        {
+            throw std::runtime_error("Invalid transcript file header.");
+        }
+
+        m_data = data;
+        m_size = size;
+        m_begin = headerSize;
+        m_recordCount = 0;
+        for (size_t position = m_begin; position < m_size; position += TranscriptRecordView(m_data + position).Size())
+        {
+            if (!TranscriptRecordView(m_data + position).IsValid(m_size - position))
+            {
+                throw std::runtime_error("Invalid transcript record at byte " + std::to_string(position) + ".");
+            }
+            m_recordCount++;
+        }
+    }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_begin = 0;
+    size_t m_recordCount = 0;
+};
+
+// Maps a transcript file into memory and reads its records in place.
+class TranscriptFileReader final : public TranscriptReader
+{
+public:
+    explicit TranscriptFileReader(const std::string& fileName)
+        : m_file(fileName)
+    {
+        Open(m_file.Data(), m_file.Size());
+    }
+
+    TranscriptFileReader(const TranscriptFileReader&) = delete;
+    TranscriptFileReader& operator=(const TranscriptFileReader&) = delete;
+
+private:
+    MappedFile m_file;
+};
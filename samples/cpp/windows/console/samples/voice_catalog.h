@@ -0,0 +1,500 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mapped_file.h"
+
+// A voice of the catalogue, the fields of VoiceInfo that are worth caching.
+struct CatalogVoice
+{
+    std::string Name;
+    std::string ShortName;
+    std::string LocalName;
+    std::string Locale;
+    Microsoft::CognitiveServices::Speech::SynthesisVoiceGender Gender = Microsoft::CognitiveServices::Speech::SynthesisVoiceGender::Unknown;
+    Microsoft::CognitiveServices::Speech::SynthesisVoiceType VoiceType = Microsoft::CognitiveServices::Speech::SynthesisVoiceType::OnlineNeural;
+    std::vector<std::string> StyleList;
+};
+
+// Criteria of a voice lookup, the empty ones (and Unknown gender) match any voice.
+struct VoiceQuery
+{
+    std::string Locale;
+    Microsoft::CognitiveServices::Speech::SynthesisVoiceGender Gender = Microsoft::CognitiveServices::Speech::SynthesisVoiceGender::Unknown;
+    std::string Style;
+};
+
+// An immutable version of the catalogue, indexed by name, locale, gender and style. Locales, styles and names are matched
+// case-insensitively.
+class VoiceCatalogSnapshot final
+{
+public:
+    explicit VoiceCatalogSnapshot(std::vector<CatalogVoice> voices) : m_voices(std::move(voices))
+    {
+        for (size_t index = 0; index < m_voices.size(); index++)
+        {
+            const auto& voice = m_voices[index];
+            m_byName.emplace(Lower(voice.Name), index);
+            m_byName.emplace(Lower(voice.ShortName), index);
+            m_byLocale[Lower(voice.Locale)].push_back(index);
+            auto gender = static_cast<size_t>(voice.Gender);
+            if (gender < m_byGender.size())
+            {
+                m_byGender[gender].push_back(index);
+            }
+            for (const auto& style : voice.StyleList)
+            {
+                m_byStyle[Lower(style)].push_back(index);
+            }
+        }
+    }
+
+    VoiceCatalogSnapshot(const VoiceCatalogSnapshot&) = delete;
+    VoiceCatalogSnapshot& operator=(const VoiceCatalogSnapshot&) = delete;
+
+    const std::vector<CatalogVoice>& Voices() const
+    {
+        return m_voices;
+    }
+
+    // Finds a voice by its name or short name, returns null if there is none.
+    const CatalogVoice* FindByName(const std::string& name) const
+    {
+        auto voice = m_byName.find(Lower(name));
+        return voice == m_byName.end() ? nullptr : &m_voices[voice->second];
+    }
+
+    // Finds the voices matching all the criteria of the query, in catalogue order.
+    // Scans the shortest of the index lists of the criteria, and checks the other criteria on its voices.
+    std::vector<const CatalogVoice*> Find(const VoiceQuery& query) const
+    {
+        const std::vector<size_t>* candidates = nullptr;
+        auto narrow = [&candidates](const std::vector<size_t>* list)
+        {
+            if (candidates == nullptr || list->size() < candidates->size())
+            {
+                candidates = list;
+            }
+        };
+
+        auto locale = Lower(query.Locale);
+        auto style = Lower(query.Style);
+        if (!locale.empty())
+        {
+            auto list = m_byLocale.find(locale);
+            narrow(list == m_byLocale.end() ? &m_none : &list->second);
+        }
+        if (query.Gender != Microsoft::CognitiveServices::Speech::SynthesisVoiceGender::Unknown)
+        {
+            auto gender = static_cast<size_t>(query.Gender);
+            narrow(gender < m_byGender.size() ? &m_byGender[gender] : &m_none);
+        }
+        if (!style.empty())
+        {
+            auto list = m_byStyle.find(style);
+            narrow(list == m_byStyle.end() ? &m_none : &list->second);
+        }
+
+        std::vector<const CatalogVoice*> voices;
+        auto matches = [&](const CatalogVoice& voice)
+        {
+            return (locale.empty() || Lower(voice.Locale) == locale) &&
+                   (query.Gender == Microsoft::CognitiveServices::Speech::SynthesisVoiceGender::Unknown || voice.Gender == query.Gender) &&
+                   (style.empty() || std::any_of(voice.StyleList.begin(), voice.StyleList.end(), [&style](const std::string& s) { return Lower(s) == style; }));
+        };
+        if (candidates == nullptr)
+        {
+            for (const auto& voice : m_voices)
+            {
+                voices.push_back(&voice);
+            }
+            return voices;
+        }
+        for (auto index : *candidates)
+        {
+            if (matches(m_voices[index]))
+            {
+                voices.push_back(&m_voices[index]);
+            }
+        }
+        return voices;
+    }
+
+    static std::string Lower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+private:
+    const std::vector<CatalogVoice> m_voices;
+    std::map<std::string, size_t> m_byName;
+    std::map<std::string, std::vector<size_t>> m_byLocale;
+    std::array<std::vector<size_t>, 3> m_byGender;     // by SynthesisVoiceGender: Unknown, Female, Male.
+    std::map<std::string, std::vector<size_t>> m_byStyle;
+    const std::vector<size_t> m_none;
+};
+
+// A cache of the voice list of the service, persisted to a file, so that processes start with the voices of the last
+// run instead of waiting on GetVoicesAsync().
+// The file is memory-mapped and indexed when the catalogue is created. A background thread refreshes the catalogue when it
+// is older than Ttl (right away if there is no cached file), and retries failed refreshes every RetryInterval. A refresh
+// that returns the same voices only renews the timestamp, the snapshot in use is kept.
+class VoiceCatalog final
+{
+public:
+    struct Options
+    {
+        // The file the catalogue is persisted to, not persisted if empty.
+        std::string CacheFile = "voices.cache";
+        std::chrono::seconds Ttl{ 24 * 60 * 60 };
+        std::chrono::seconds RetryInterval{ 5 * 60 };
+    };
+
+    struct Stats
+    {
+        bool LoadedFromFile = false;
+        uint64_t Refreshes = 0;     // refreshes with changed voices.
+        uint64_t Unchanged = 0;     // refreshes with the same voices.
+        uint64_t Failures = 0;
+        std::string LastError;
+    };
+
+    VoiceCatalog(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, Options options)
+        : m_config(std::move(config)), m_options(options)
+    {
+        if (!m_config)
+        {
+            throw std::invalid_argument("Speech config is null");
+        }
+        m_snapshot = Load(m_fetched);
+        m_stats.LoadedFromFile = m_snapshot != nullptr;
+        m_refresher = std::thread(&VoiceCatalog::RefreshLoop, this);
+    }
+
+    VoiceCatalog(const VoiceCatalog&) = delete;
+    VoiceCatalog& operator=(const VoiceCatalog&) = delete;
+
+    ~VoiceCatalog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        m_refresher.join();
+    }
+
+    // The current snapshot, null until the first refresh if there was no cached file. Lookups on a snapshot do not lock,
+    // and it stays valid while held, even if the catalogue is refreshed meanwhile.
+    std::shared_ptr<const VoiceCatalogSnapshot> Current()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_snapshot;
+    }
+
+    // Waits for a snapshot, i.e. for the first refresh if there was no cached file. Returns null on timeout.
+    std::shared_ptr<const VoiceCatalogSnapshot> WaitForCurrent(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait_for(lock, timeout, [this] { return m_snapshot != nullptr; });
+        return m_snapshot;
+    }
+
+    // Requests a refresh in the background, e.g. on a configuration reload. Unless 'force' is set, only refreshes if the
+    // catalogue is older than Ttl.
+    void Refresh(bool force = false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_forceRefresh = m_forceRefresh || force;
+        }
+        m_changed.notify_all();
+    }
+
+    // When the voices of the current snapshot were last fetched from the service.
+    std::chrono::system_clock::time_point Fetched()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_fetched;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    static const char* FileMagic()
+    {
+        return "SPVC";
+    }
+    static constexpr size_t FileMagicSize = 4;
+
+    void RefreshLoop()
+    {
+        using Clock = std::chrono::system_clock;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto retryAt = Clock::time_point::min();
+        bool failed = false;
+        while (!m_stopping)
+        {
+            // After a failure, retries after RetryInterval whether the catalogue is expired or not, e.g. after a forced refresh.
+            auto dueAt = failed ? retryAt : m_snapshot ? m_fetched + m_options.Ttl : Clock::time_point::min();
+            if (!m_forceRefresh && Clock::now() < dueAt)
+            {
+                // Wakes up on Refresh(), or in a minute at most, which also covers changes of the system clock.
+                auto wait = std::min<Clock::duration>(dueAt - Clock::now(), std::chrono::minutes(1));
+                m_changed.wait_for(lock, wait);
+                continue;
+            }
+            m_forceRefresh = false;
+
+            lock.unlock();
+            std::string error;
+            std::vector<CatalogVoice> voices;
+            bool fetched = Fetch(voices, error);
+            lock.lock();
+
+            if (!fetched)
+            {
+                m_stats.Failures++;
+                m_stats.LastError = error;
+                failed = true;
+                retryAt = Clock::now() + m_options.RetryInterval;
+                continue;
+            }
+            failed = false;
+
+            if (m_snapshot && Serialize(m_snapshot->Voices(), Clock::time_point()) == Serialize(voices, Clock::time_point()))
+            {
+                m_stats.Unchanged++;
+            }
+            else
+            {
+                m_snapshot = std::make_shared<const VoiceCatalogSnapshot>(std::move(voices));
+                m_stats.Refreshes++;
+                m_changed.notify_all();
+            }
+            m_fetched = Clock::now();
+            auto snapshot = m_snapshot;
+            auto fetchedAt = m_fetched;
+
+            lock.unlock();
+            Save(*snapshot, fetchedAt);
+            lock.lock();
+        }
+    }
+
+    bool Fetch(std::vector<CatalogVoice>& voices, std::string& error)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        try
+        {
+            auto synthesizer = SpeechSynthesizer::FromConfig(m_config, nullptr);
+            auto result = synthesizer->GetVoicesAsync("").get();
+            if (result->Reason != ResultReason::VoicesListRetrieved)
+            {
+                error = result->ErrorDetails;
+                return false;
+            }
+            for (const auto& info : result->Voices)
+            {
+                CatalogVoice voice;
+                voice.Name = info->Name;
+                voice.ShortName = info->ShortName;
+                voice.LocalName = info->LocalName;
+                voice.Locale = info->Locale;
+                voice.Gender = info->Gender;
+                voice.VoiceType = info->VoiceType;
+                voice.StyleList = info->StyleList;
+                voices.push_back(std::move(voice));
+            }
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+            return false;
+        }
+    }
+
+    // The file holds a "SPVC" tag, the fetch time in seconds since the epoch, the number of voices, then the fields of each
+    // voice. Numbers are 32 bits and the time 64 bits, little-endian, and strings are prefixed with their size.
+    static std::string Serialize(const std::vector<CatalogVoice>& voices, std::chrono::system_clock::time_point fetched)
+    {
+        std::string data(FileMagic(), FileMagicSize);
+        auto writeNumber = [&data](uint64_t value, size_t size)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+            }
+        };
+        auto writeString = [&](const std::string& text)
+        {
+            writeNumber(text.size(), 4);
+            data += text;
+        };
+
+        writeNumber(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(fetched.time_since_epoch()).count()), 8);
+        writeNumber(voices.size(), 4);
+        for (const auto& voice : voices)
+        {
+            writeString(voice.Name);
+            writeString(voice.ShortName);
+            writeString(voice.LocalName);
+            writeString(voice.Locale);
+            writeNumber(static_cast<uint64_t>(voice.Gender), 4);
+            writeNumber(static_cast<uint64_t>(voice.VoiceType), 4);
+            writeNumber(voice.StyleList.size(), 4);
+            for (const auto& style : voice.StyleList)
+            {
+                writeString(style);
+            }
+        }
+        return data;
+    }
+
+    // Returns null if there is no cached file, or if it is invalid.
+    std::shared_ptr<const VoiceCatalogSnapshot> Load(std::chrono::system_clock::time_point& fetched) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (m_options.CacheFile.empty())
+        {
+            return nullptr;
+        }
+        try
+        {
+            MappedFile file(m_options.CacheFile);
+            auto position = file.Data();
+            auto end = file.Data() + file.Size();
+            auto readNumber = [&](size_t size)
+            {
+                if (static_cast<size_t>(end - position) < size)
+                {
+                    throw std::runtime_error("Truncated voice catalogue.");
+                }
+                uint64_t value = 0;
+                for (size_t i = 0; i < size; i++)
+                {
+                    value |= static_cast<uint64_t>(*position++) << (8 * i);
+                }
+                return value;
+            };
+            auto readString = [&]()
+            {
+                auto size = static_cast<size_t>(readNumber(4));
+                if (static_cast<size_t>(end - position) < size)
+                {
+                    throw std::runtime_error("Truncated voice catalogue.");
+                }
+                std::string text(reinterpret_cast<const char*>(position), size);
+                position += size;
+                return text;
+            };
+
+            if (file.Size() < FileMagicSize || memcmp(position, FileMagic(), FileMagicSize) != 0)
+            {
+                return nullptr;
+            }
+            position += FileMagicSize;
+            auto fetchedAt = std::chrono::system_clock::time_point(std::chrono::seconds(static_cast<int64_t>(readNumber(8))));
+            auto count = static_cast<size_t>(readNumber(4));
+
+            std::vector<CatalogVoice> voices;
+            // Each voice takes at least 28 bytes, which bounds the count before anything is allocated.
+            voices.reserve(std::min<size_t>(count, static_cast<size_t>(end - position) / 28));
+            for (size_t index = 0; index < count; index++)
+            {
+                CatalogVoice voice;
+                voice.Name = readString();
+                voice.ShortName = readString();
+                voice.LocalName = readString();
+                voice.Locale = readString();
+                voice.Gender = static_cast<SynthesisVoiceGender>(readNumber(4));
+                voice.VoiceType = static_cast<SynthesisVoiceType>(readNumber(4));
+                auto styles = static_cast<size_t>(readNumber(4));
+                for (size_t style = 0; style < styles; style++)
+                {
+                    voice.StyleList.push_back(readString());
+                }
+                voices.push_back(std::move(voice));
+            }
+            fetched = fetchedAt;
+            return std::make_shared<const VoiceCatalogSnapshot>(std::move(voices));
+        }
+        catch (const std::exception&)
+        {
+            // Missing or invalid, the catalogue is fetched from the service.
+            return nullptr;
+        }
+    }
+
+    void Save(const VoiceCatalogSnapshot& snapshot, std::chrono::system_clock::time_point fetched) const
+    {
+        if (m_options.CacheFile.empty())
+        {
+            return;
+        }
+
+        // Written to a temporary file first, so a starting process never maps a partial catalogue.
+        auto temporaryName = m_options.CacheFile + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        {
+            auto data = Serialize(snapshot.Voices(), fetched);
+            std::ofstream file(temporaryName, std::ios_base::binary);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file.good())
+            {
+                file.close();
+                std::remove(temporaryName.c_str());
+                return;
+            }
+        }
+#ifdef _WIN32
+        auto replaced = MoveFileExA(temporaryName.c_str(), m_options.CacheFile.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        auto replaced = std::rename(temporaryName.c_str(), m_options.CacheFile.c_str()) == 0;
+#endif
+        if (!replaced)
+        {
+            // E.g. mapped by another process starting up, the next refresh writes it again.
+            std::remove(temporaryName.c_str());
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Options m_options;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::shared_ptr<const VoiceCatalogSnapshot> m_snapshot;
+    std::chrono::system_clock::time_point m_fetched;
+    bool m_forceRefresh = false;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    std::thread m_refresher;
+};
@@ -50,6 +50,22 @@ public:
         m_fs.close();
     }
 
+    // Gets the audio format read from the file header.
+    uint16_t GetChannels() const { return m_formatHeader.Channels; }
+    uint32_t GetSamplesPerSecond() const { return m_formatHeader.SamplesPerSec; }
+    uint16_t GetBitsPerSample() const { return m_formatHeader.BitsPerSample; }
+    uint16_t GetBlockAlign() const { return m_formatHeader.BlockAlign; }
+
+    // Gets the size of the audio data in bytes.
+    uint64_t GetDataSize() const { return m_dataSize; }
+
+    // Gets the audio duration in seconds, derived from the header without reading the audio data.
+    double GetDurationSeconds() const
+    {
+        uint64_t bytesPerSecond = (uint64_t)m_formatHeader.SamplesPerSec * m_formatHeader.BlockAlign;
+        return bytesPerSecond == 0 ? 0.0 : (double)m_dataSize / bytesPerSecond;
+    }
+
 private:
     // Defines common constants for WAV format.
     static constexpr uint16_t tagBufferSize = 4;
@@ -104,6 +120,7 @@ private:
                 else if (memcmp(chunkType, "data", chunkTypeBufferSize) == 0)
                 {
                     foundDataChunk = true;
+                    m_dataSize = GetDataChunkSize(chunkSize);
                     break;
                 }
                 else
@@ -129,6 +146,22 @@ private:
         m_fs.exceptions(std::ifstream::goodbit);
     }
 
+    // Gets the size of the data chunk. Files written by streaming recorders may leave it at 0 or 0xFFFFFFFF,
+    // in that case the data is assumed to extend to the end of the file.
+    uint64_t GetDataChunkSize(uint32_t chunkSize)
+    {
+        auto dataStart = m_fs.tellg();
+        m_fs.seekg(0, std::ios_base::end);
+        uint64_t remaining = (uint64_t)(m_fs.tellg() - dataStart);
+        m_fs.seekg(dataStart);
+
+        if (chunkSize == 0 || chunkSize == UINT32_MAX || chunkSize > remaining)
+        {
+            return remaining;
+        }
+        return chunkSize;
+    }
+
     void ReadChunkTypeAndSize(char* chunkType, uint32_t* chunkSize)
     {
         // Read the chunk type
@@ -154,9 +187,10 @@ private:
         uint32_t AvgBytesPerSec;   // for buffer estimation.
         uint16_t BlockAlign;       // block size of data.
         uint16_t BitsPerSample;    // Number of bits per sample of mono data.
-    } m_formatHeader;
+    } m_formatHeader = {};
     static_assert(sizeof(m_formatHeader) == 16, "unexpected size of m_formatHeader");
 
 private:
     std::fstream m_fs;
+    uint64_t m_dataSize = 0;
 };
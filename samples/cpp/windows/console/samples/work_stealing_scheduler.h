@@ -0,0 +1,195 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// A unit of work with an estimated cost, e.g. an audio file and its duration in seconds.
+template<typename T>
+struct ScheduledJob
+{
+    T Payload;
+    double Cost = 0;
+};
+
+// Schedules jobs of very different lengths over a fixed number of workers, so that the last jobs finish close together.
+// Assign() sorts the jobs longest first and gives each one to the worker with the least assigned cost, so every
+// worker starts with a balanced queue ordered longest first. A worker takes its jobs from the front of its own queue.
+// When its queue is empty, it steals the next job from the front of the queue with the most remaining cost. Stealing
+// the longest pending job, rather than the shortest as is usual for work stealing, keeps the global longest-first
+// order, which is what bounds the makespan when the cost estimates turn out to be wrong.
+template<typename T>
+class WorkStealingScheduler final
+{
+public:
+    using Job = ScheduledJob<T>;
+    using Process = std::function<void(size_t worker, const Job& job)>;
+
+    explicit WorkStealingScheduler(size_t workerCount)
+    {
+        if (workerCount == 0)
+        {
+            throw std::invalid_argument("workerCount must be at least 1");
+        }
+        for (size_t i = 0; i < workerCount; i++)
+        {
+            m_queues.emplace_back(new WorkerQueue());
+        }
+    }
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    size_t WorkerCount() const
+    {
+        return m_queues.size();
+    }
+
+    // Distributes the jobs over the workers, longest first. Jobs can be assigned while workers are running.
+    void Assign(std::vector<Job> jobs)
+    {
+        std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.Cost > b.Cost; });
+
+        // Plans with the current loads, then appends each worker's share at once.
+        std::vector<double> loads;
+        for (auto& queue : m_queues)
+        {
+            loads.push_back(queue->Cost.load(std::memory_order_relaxed));
+        }
+        std::vector<std::vector<Job>> shares(m_queues.size());
+        for (auto& job : jobs)
+        {
+            auto worker = static_cast<size_t>(std::min_element(loads.begin(), loads.end()) - loads.begin());
+            loads[worker] += job.Cost;
+            shares[worker].push_back(std::move(job));
+        }
+
+        for (size_t worker = 0; worker < m_queues.size(); worker++)
+        {
+            auto& queue = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(queue.Mutex);
+            for (auto& job : shares[worker])
+            {
+                Insert(queue, std::move(job));
+            }
+        }
+    }
+
+    // Takes the next job for 'worker', from its own queue or stolen from another one.
+    // Returns false when there are no jobs left.
+    bool TryTake(size_t worker, Job& job)
+    {
+        if (TakeFront(*m_queues[worker], job))
+        {
+            return true;
+        }
+
+        // Tries the victims from the most to the least loaded, loads may change while stealing.
+        std::vector<size_t> victims;
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            if (i != worker && m_queues[i]->Cost.load(std::memory_order_relaxed) > 0)
+            {
+                victims.push_back(i);
+            }
+        }
+        std::sort(victims.begin(), victims.end(), [this](size_t a, size_t b)
+        {
+            return m_queues[a]->Cost.load(std::memory_order_relaxed) > m_queues[b]->Cost.load(std::memory_order_relaxed);
+        });
+        for (auto victim : victims)
+        {
+            if (TakeFront(*m_queues[victim], job))
+            {
+                m_steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // Jobs with no cost do not show in the loads.
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            if (i != worker && TakeFront(*m_queues[i], job))
+            {
+                m_steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Runs all assigned jobs, one thread per worker, and returns when they are all processed.
+    // 'process' is called concurrently from all workers.
+    void Run(const Process& process)
+    {
+        std::vector<std::thread> threads;
+        for (size_t worker = 0; worker < m_queues.size(); worker++)
+        {
+            threads.emplace_back([this, worker, &process]()
+            {
+                Job job;
+                while (TryTake(worker, job))
+                {
+                    process(worker, job);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    // Gets the estimated cost of the jobs still queued for 'worker'.
+    double RemainingCost(size_t worker) const
+    {
+        return m_queues[worker]->Cost.load(std::memory_order_relaxed);
+    }
+
+    uint64_t StealCount() const
+    {
+        return m_steals.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex Mutex;
+        std::deque<Job> Jobs;
+        std::atomic<double> Cost{ 0 };
+    };
+
+    // Keeps the queue ordered longest first. Called with the queue locked.
+    static void Insert(WorkerQueue& queue, Job job)
+    {
+        auto position = std::upper_bound(queue.Jobs.begin(), queue.Jobs.end(), job, [](const Job& a, const Job& b) { return a.Cost > b.Cost; });
+        queue.Cost.store(queue.Cost.load(std::memory_order_relaxed) + job.Cost, std::memory_order_relaxed);
+        queue.Jobs.insert(position, std::move(job));
+    }
+
+    static bool TakeFront(WorkerQueue& queue, Job& job)
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (queue.Jobs.empty())
+        {
+            return false;
+        }
+        job = std::move(queue.Jobs.front());
+        queue.Jobs.pop_front();
+        queue.Cost.store(queue.Jobs.empty() ? 0 : queue.Cost.load(std::memory_order_relaxed) - job.Cost, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::atomic<uint64_t> m_steals{ 0 };
+};
@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a batch of items on a bounded number of threads, the calling thread included. Each thread takes the next item
+// not taken yet, so a slow item (a long file, a throttled request) does not hold up the items behind it.
+// If an item throws, the other threads take no new item, and the first exception is rethrown by ForEach() once all
+// the threads have stopped. The threads are always joined, so an exception never reaches std::terminate.
+class WorkerPool final
+{
+public:
+    // Processes the item at 'index'.
+    using Worker = std::function<void(size_t index)>;
+    // Called once on each thread, the worker it returns may keep state across the items of the thread, e.g. a client.
+    using WorkerFactory = std::function<Worker()>;
+
+    // Processes the items 0 to count - 1 on up to 'concurrency' threads, and returns when all are done.
+    static void ForEach(size_t count, size_t concurrency, const WorkerFactory& makeWorker)
+    {
+        WorkerPool pool(count);
+        for (size_t i = 1; i < std::min(concurrency, count); i++)
+        {
+            pool.m_threads.emplace_back(&WorkerPool::Work, &pool, std::cref(makeWorker));
+        }
+        pool.Work(makeWorker);
+        pool.Join();
+        if (pool.m_error)
+        {
+            std::rethrow_exception(pool.m_error);
+        }
+    }
+
+private:
+    explicit WorkerPool(size_t count) : m_count(count)
+    {
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Joins the threads started so far, also when starting one of them failed.
+    ~WorkerPool()
+    {
+        Join();
+    }
+
+    void Work(const WorkerFactory& makeWorker)
+    {
+        try
+        {
+            auto worker = makeWorker();
+            for (auto index = m_next++; index < m_count; index = m_next++)
+            {
+                worker(index);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+            m_next = m_count;
+        }
+    }
+
+    void Join()
+    {
+        for (auto& thread : m_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+    }
+
+    const size_t m_count;
+    std::atomic<size_t> m_next{ 0 };
+    std::mutex m_mutex;
+    std::exception_ptr m_error;
+    std::vector<std::thread> m_threads;
+};